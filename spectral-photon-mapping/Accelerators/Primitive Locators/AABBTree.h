@@ -1,16 +1,30 @@
 #pragma once
 #include "Base.h"
+#include "Cache.h"
+#include "../../AlignedAllocator.h"
+#include "../../Stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <functional>
+#include <string>
 
 namespace PrimitiveLocators {
 	template<class Primitive, class TreeBuilder>
 	class AABBTree;
+	template<class Primitive, class TreeBuilder>
+	class QuantizedAABBTree;
 
 	/// Separate axis on two equal width halfs
 	template<class Primitive, int minPrims = 1, bool useMaxDir = false>
 	class MiddleTreeBuilder {
 		using Tree = AABBTree<Primitive, MiddleTreeBuilder<Primitive, minPrims, useMaxDir>>;
 		friend class Tree;
+		// names builder and its parameters in cache key
+		static std::string cacheTag() {
+			return "Middle " + std::to_string(minPrims) + " " + std::to_string(useMaxDir);
+		}
+		static const bool Cacheable = true;
 	protected:
 		static void build(int begin, int end, int depth, const AABB& bounds, int nodeId, std::vector<int>& tempIndices, Tree& tree) {
 			int numPrims = end - begin;
@@ -58,6 +72,11 @@ namespace PrimitiveLocators {
 	class EqualCountsTreeBuilder {
 		using Tree = AABBTree<Primitive, EqualCountsTreeBuilder<Primitive, minPrims>>;
 		friend class Tree;
+		// names builder and its parameters in cache key
+		static std::string cacheTag() {
+			return "EqualCounts " + std::to_string(minPrims);
+		}
+		static const bool Cacheable = true;
 	protected:
 		static void build(int begin, int end, int depth, const AABB& bounds, int nodeId, std::vector<int>& tempIndices, Tree& tree) {
 			int numPrims = end - begin;
@@ -100,8 +119,13 @@ namespace PrimitiveLocators {
 	class BucketSAHTreeBuilder {
 		using Tree = AABBTree<Primitive, BucketSAHTreeBuilder<Primitive, minPrims, useMaxDir, bucketSize>>;
 		friend class Tree;
+		// names builder and its parameters in cache key
+		static std::string cacheTag() {
+			return "BucketSAH " + std::to_string(minPrims) + " " + std::to_string(useMaxDir) + " " + std::to_string(bucketSize);
+		}
+		static const bool Cacheable = true;
 	protected:
-		static void build(int begin, int end, int depth, const AABB& bounds, int nodeId, std::vector<int>& tempIndices, Tree& tree, int minPrims) {
+		static void build(int begin, int end, int depth, const AABB& bounds, int nodeId, std::vector<int>& tempIndices, Tree& tree) {
 			int numPrims = end - begin;
 			if (numPrims <= minPrims || depth == 0) {
 				tree.addLeaf(begin, end, depth, bounds, tempIndices);
@@ -109,7 +133,7 @@ namespace PrimitiveLocators {
 			}
 			AABB centroidBBox;
 			for (int i = begin; i < end; ++i)
-				centroidBBox.append(tree.boundsArray[tempIndices[i]]);
+				centroidBBox.append(tree.boundsArray[tempIndices[i]].center());
 
 			struct Bucket {
 				AABB bbox;
@@ -117,11 +141,17 @@ namespace PrimitiveLocators {
 			};
 
 			float bboxArea = bounds.area();
+			const float TTraverse = 0.125f;
+			const float TInters = 1.0f;
 
 			float minCost = std::numeric_limits<float>::max();
 			int minCostPlane = -1;
 			int minDim = -1;
-			for (int dim = 0; dim < 3; ++dim) {
+			int firstDim = 0;
+			int lastDim = 2;
+			if (useMaxDir)
+				firstDim = lastDim = centroidBBox.maxExtentDirection();
+			for (int dim = firstDim; dim <= lastDim; ++dim) {
 				if (centroidBBox.max()[dim] == centroidBBox.min()[dim])
 					continue;
 				float bucketWidth = centroidBBox.size()[dim] / float(bucketSize);
@@ -129,7 +159,7 @@ namespace PrimitiveLocators {
 				for (int i = begin; i != end; ++i) {
 					int primitiveId = tempIndices[i];
 					float centroid = tree.boundsArray[primitiveId].center()[dim] - centroidBBox.min()[dim];
-					int bucketId = std::min(bucketSize - 1, centroid / bucketWidth);
+					int bucketId = std::min(bucketSize - 1, int(centroid / bucketWidth));
 					buckets[bucketId].count++;
 					buckets[bucketId].bbox.append(tree.boundsArray[primitiveId]);
 				}
@@ -146,10 +176,9 @@ namespace PrimitiveLocators {
 						rightItems += buckets[id].count;
 						rightBBox.append(buckets[id].bbox);
 					}
-
-					const float TTraverse = 0.125f;
-					const float TInters = 1.0f;
-					float cost = TTraverse + (leftItems * TInters * leftBBox.area() + rightItems * TTraverse * rightBBox.area()) / bboxArea;
+					if (leftItems == 0 || rightItems == 0)
+						continue;
+					float cost = TTraverse + TInters * (leftItems * leftBBox.area() + rightItems * rightBBox.area()) / bboxArea;
 					if (cost <= minCost) {
 						minCost = cost;
 						minCostPlane = planeId;
@@ -157,26 +186,25 @@ namespace PrimitiveLocators {
 					}
 				}
 			}
-			if (minCostPlane == -1 || minCost > numPrims) {
+			if (minCostPlane == -1 || minCost > numPrims * TInters) {
 				tree.addLeaf(begin, end, depth, bounds, tempIndices);
 				return;
 			}
 			float bucketWidth = centroidBBox.size()[minDim] / float(bucketSize);
-			int* midPtr = std::partition(&tempIndices[begin],
-				&tempIndices[end - 1] + 1,
-				[minDim, bucketWidth, minCostPlane, &tempIndices](int id) {
-				int primitiveId = tempIndices[id];
-				float centroid = tree.boundsArray[primitiveId].center()[minDim] - centroidBBox.min()[minDim];
-				int bucketId = std::min(bucketSize - 1, centroid / bucketWidth);
-				return bucketId <= minCostPlane;
+			float minCentroid = centroidBBox.min()[minDim];
+			int* midPtr = std::partition(&tempIndices[begin], &tempIndices[end - 1] + 1,
+				[minDim, bucketWidth, minCostPlane, minCentroid, &bounds = tree.boundsArray](int primitiveId) {
+				float centroid = bounds[primitiveId].center()[minDim] - minCentroid;
+				int bucketId = std::min(bucketSize - 1, int(centroid / bucketWidth));
+				return bucketId < minCostPlane;
 			});
-			int middle = midPtr - &tempIndices.begin();
-			//NOT_IMPLEMENTED();
+			int middle = midPtr - &tempIndices[0];
 			AABB left;
 			tree.nodes.emplace_back(Tree::Node::Type::Inter, 0, 0, bounds);
 			for (int i = begin; i < middle; ++i) {
 				left.append(tree.boundsArray[tempIndices[i]]);
 			}
+			tree.nodes[nodeId].firstChild = nodeId + 1;
 			build(begin, middle, depth - 1, left, nodeId + 1, tempIndices, tree);
 			AABB right;
 			for (int i = middle; i < end; ++i) {
@@ -184,9 +212,288 @@ namespace PrimitiveLocators {
 			}
 			tree.nodes[nodeId].secondChild = tree.nodes.size();
 			build(middle, end, depth - 1, right, tree.nodes.size(), tempIndices, tree);
-
 		}
+	};
 
+	/// Spatial split BVH, Stich et al. "Spatial Splits in Bounding Volume Hierarchies"
+	/// Besides binned object splits tries planes cutting primitives: references straddling plane are clipped
+	/// and go to both children. Primitive appears in several leaves, total number of references
+	/// is limited by maxGrowthPercent of primitive count.
+	template<class Primitive, int minPrims = 1, int maxGrowthPercent = 30, int bucketSize = 12, int spatialBins = 32>
+	class SpatialSplitTreeBuilder {
+		using Tree = AABBTree<Primitive, SpatialSplitTreeBuilder<Primitive, minPrims, maxGrowthPercent, bucketSize, spatialBins>>;
+		friend class Tree;
+		// names builder and its parameters in cache key
+		static std::string cacheTag() {
+			return "SpatialSplit " + std::to_string(minPrims) + " " + std::to_string(maxGrowthPercent) + " " + std::to_string(bucketSize) + " " + std::to_string(spatialBins);
+		}
+		// clipped references depend on primitive geometry, not only on bounds in cache key, so trees are not cached
+		static const bool Cacheable = false;
+		// part of primitive inside node
+		struct Reference {
+			int primitiveId;
+			AABB bounds;
+		};
+		struct State {
+			int references;
+			int maxReferences;
+			// spatial splits are tried only if children of object split overlap more than this
+			float minOverlap;
+		};
+		struct Split {
+			float cost = std::numeric_limits<float>::max();
+			int dim = -1;
+			// bucket id for object split, bin id for spatial
+			int plane = -1;
+			AABB left;
+			AABB right;
+			int leftCount = 0;
+			int rightCount = 0;
+		};
+		static constexpr float TTraverse = 0.125f;
+		static constexpr float TInters = 1.0f;
+		// overlap of object split children relative to root area, value from paper
+		static constexpr float Alpha = 0.00001f;
+		static int bucket(float value, float min, float width, int count) {
+			return glm::clamp(int((value - min) / width), 0, count - 1);
+		}
+		static AABB slab(const AABB& bounds, int dim, float min, float max) {
+			vec3 boxMin = bounds.min();
+			vec3 boxMax = bounds.max();
+			boxMin[dim] = min;
+			boxMax[dim] = max;
+			return AABB(boxMin, boxMax);
+		}
+		static Split findObjectSplit(const std::vector<Reference>& refs, const AABB& centroidBBox, float area) {
+			struct Bucket {
+				AABB bbox;
+				int count = 0;
+			};
+			Split best;
+			for (int dim = 0; dim < 3; ++dim) {
+				if (centroidBBox.max()[dim] == centroidBBox.min()[dim])
+					continue;
+				float width = centroidBBox.size()[dim] / float(bucketSize);
+				Bucket buckets[bucketSize];
+				for (const auto& ref : refs) {
+					int id = bucket(ref.bounds.center()[dim], centroidBBox.min()[dim], width, bucketSize);
+					buckets[id].count++;
+					buckets[id].bbox.append(ref.bounds);
+				}
+				// right sides are accumulated from the end, left ones during the sweep
+				AABB rightBBoxes[bucketSize];
+				int rightCounts[bucketSize];
+				AABB right;
+				int rightCount = 0;
+				for (int id = bucketSize - 1; id > 0; --id) {
+					right.append(buckets[id].bbox);
+					rightCount += buckets[id].count;
+					rightBBoxes[id] = right;
+					rightCounts[id] = rightCount;
+				}
+				AABB left;
+				int leftCount = 0;
+				for (int planeId = 1; planeId < bucketSize; ++planeId) {
+					left.append(buckets[planeId - 1].bbox);
+					leftCount += buckets[planeId - 1].count;
+					if (leftCount == 0 || rightCounts[planeId] == 0)
+						continue;
+					float cost = TTraverse + TInters * (leftCount * left.area() + rightCounts[planeId] * rightBBoxes[planeId].area()) / area;
+					if (cost < best.cost) {
+						best.cost = cost;
+						best.dim = dim;
+						best.plane = planeId;
+						best.left = left;
+						best.right = rightBBoxes[planeId];
+						best.leftCount = leftCount;
+						best.rightCount = rightCounts[planeId];
+					}
+				}
+			}
+			return best;
+		}
+		static Split findSpatialSplit(const std::vector<Reference>& refs, const AABB& bounds, const Tree& tree) {
+			struct Bin {
+				AABB bbox;
+				int entries = 0;
+				int exits = 0;
+			};
+			Split best;
+			float area = bounds.area();
+			for (int dim = 0; dim < 3; ++dim) {
+				float min = bounds.min()[dim];
+				float width = bounds.size()[dim] / float(spatialBins);
+				if (width <= 0.0f)
+					continue;
+				Bin bins[spatialBins];
+				for (const auto& ref : refs) {
+					int first = bucket(ref.bounds.min()[dim], min, width, spatialBins);
+					int last = bucket(ref.bounds.max()[dim], min, width, spatialBins);
+					for (int id = first; id <= last; ++id) {
+						AABB box = intersectionOp(ref.bounds, slab(ref.bounds, dim, min + id * width, min + (id + 1) * width));
+						bins[id].bbox.append(intersectionOp(ref.bounds, tree.primitives[ref.primitiveId]->clippedBBox(box)));
+					}
+					bins[first].entries++;
+					bins[last].exits++;
+				}
+				AABB rightBBoxes[spatialBins];
+				int rightCounts[spatialBins];
+				AABB right;
+				int rightCount = 0;
+				for (int id = spatialBins - 1; id > 0; --id) {
+					right.append(bins[id].bbox);
+					rightCount += bins[id].exits;
+					rightBBoxes[id] = right;
+					rightCounts[id] = rightCount;
+				}
+				AABB left;
+				int leftCount = 0;
+				for (int planeId = 1; planeId < spatialBins; ++planeId) {
+					left.append(bins[planeId - 1].bbox);
+					leftCount += bins[planeId - 1].entries;
+					if (leftCount == 0 || rightCounts[planeId] == 0)
+						continue;
+					float cost = TTraverse + TInters * (leftCount * left.area() + rightCounts[planeId] * rightBBoxes[planeId].area()) / area;
+					if (cost < best.cost) {
+						best.cost = cost;
+						best.dim = dim;
+						best.plane = planeId;
+						best.left = left;
+						best.right = rightBBoxes[planeId];
+						best.leftCount = leftCount;
+						best.rightCount = rightCounts[planeId];
+					}
+				}
+			}
+			return best;
+		}
+		static void splitSpatially(std::vector<Reference>& refs, const AABB& bounds, const Split& split, Tree& tree, State& state,
+			std::vector<Reference>& left, std::vector<Reference>& right) {
+			int dim = split.dim;
+			float plane = bounds.min()[dim] + bounds.size()[dim] * split.plane / float(spatialBins);
+			float leftArea = split.left.area();
+			float rightArea = split.right.area();
+			for (const auto& ref : refs) {
+				if (ref.bounds.max()[dim] <= plane) {
+					left.push_back(ref);
+					continue;
+				}
+				if (ref.bounds.min()[dim] >= plane) {
+					right.push_back(ref);
+					continue;
+				}
+				// reference unsplitting: put whole reference to one side if it is cheaper than duplication
+				float splitCost = leftArea * split.leftCount + rightArea * split.rightCount;
+				float leftCost = unionOp(split.left, ref.bounds).area() * split.leftCount + rightArea * (split.rightCount - 1);
+				float rightCost = leftArea * (split.leftCount - 1) + unionOp(split.right, ref.bounds).area() * split.rightCount;
+				bool canDuplicate = state.references < state.maxReferences;
+				if (!canDuplicate || leftCost < splitCost || rightCost < splitCost) {
+					if (leftCost <= rightCost)
+						left.push_back(ref);
+					else
+						right.push_back(ref);
+					continue;
+				}
+				const Primitive* primitive = tree.primitives[ref.primitiveId];
+				float lowest = std::numeric_limits<float>::lowest();
+				float highest = std::numeric_limits<float>::max();
+				Reference leftRef = { ref.primitiveId, intersectionOp(ref.bounds, primitive->clippedBBox(slab(ref.bounds, dim, lowest, plane))) };
+				Reference rightRef = { ref.primitiveId, intersectionOp(ref.bounds, primitive->clippedBBox(slab(ref.bounds, dim, plane, highest))) };
+				// exact clipping may show that primitive does not cross plane at all
+				bool hasLeft = !leftRef.bounds.isEmpty();
+				bool hasRight = !rightRef.bounds.isEmpty();
+				if (hasLeft)
+					left.push_back(leftRef);
+				if (hasRight)
+					right.push_back(rightRef);
+				if (hasLeft && hasRight)
+					state.references++;
+				else if (!hasLeft && !hasRight)
+					left.push_back(ref);
+			}
+		}
+		static void splitObjects(std::vector<Reference>& refs, const AABB& centroidBBox, const Split& split,
+			std::vector<Reference>& left, std::vector<Reference>& right) {
+			float width = centroidBBox.size()[split.dim] / float(bucketSize);
+			for (const auto& ref : refs) {
+				if (bucket(ref.bounds.center()[split.dim], centroidBBox.min()[split.dim], width, bucketSize) < split.plane)
+					left.push_back(ref);
+				else
+					right.push_back(ref);
+			}
+		}
+		static void addLeaf(const std::vector<Reference>& refs, int depth, const AABB& bounds, Tree& tree) {
+			std::vector<int> leafIndices(refs.size());
+			for (int i = 0; i < refs.size(); ++i)
+				leafIndices[i] = refs[i].primitiveId;
+			tree.addLeaf(0, leafIndices.size(), depth, bounds, leafIndices);
+		}
+		static void buildNode(std::vector<Reference>& refs, int depth, const AABB& bounds, Tree& tree, State& state) {
+			int nodeId = tree.nodes.size();
+			int numRefs = refs.size();
+			if (numRefs <= minPrims || depth == 0) {
+				addLeaf(refs, depth, bounds, tree);
+				return;
+			}
+			AABB centroidBBox;
+			for (const auto& ref : refs)
+				centroidBBox.append(ref.bounds.center());
+			float area = bounds.area();
+			Split objectSplit = findObjectSplit(refs, centroidBBox, area);
+			Split spatialSplit;
+			AABB overlap = intersectionOp(objectSplit.left, objectSplit.right);
+			bool trySpatial = objectSplit.dim == -1 || (!overlap.isEmpty() && overlap.area() > state.minOverlap);
+			if (trySpatial && state.references < state.maxReferences)
+				spatialSplit = findSpatialSplit(refs, bounds, tree);
+			float leafCost = numRefs * TInters;
+			bool useSpatial = spatialSplit.cost < objectSplit.cost;
+			if (std::min(objectSplit.cost, spatialSplit.cost) > leafCost) {
+				addLeaf(refs, depth, bounds, tree);
+				return;
+			}
+			std::vector<Reference> left;
+			std::vector<Reference> right;
+			if (useSpatial) {
+				splitSpatially(refs, bounds, spatialSplit, tree, state, left, right);
+				// unsplitting can move every reference to one side
+				if (left.empty() || right.empty()) {
+					left.clear();
+					right.clear();
+					if (objectSplit.dim == -1) {
+						addLeaf(refs, depth, bounds, tree);
+						return;
+					}
+					splitObjects(refs, centroidBBox, objectSplit, left, right);
+				}
+			}
+			else
+				splitObjects(refs, centroidBBox, objectSplit, left, right);
+			// children own references now, release memory before going deeper
+			std::vector<Reference>().swap(refs);
+			AABB leftBounds;
+			for (const auto& ref : left)
+				leftBounds.append(ref.bounds);
+			AABB rightBounds;
+			for (const auto& ref : right)
+				rightBounds.append(ref.bounds);
+			tree.nodes.emplace_back(Tree::Node::Type::Inter, 0, 0, bounds);
+			tree.nodes[nodeId].firstChild = nodeId + 1;
+			buildNode(left, depth - 1, leftBounds, tree, state);
+			tree.nodes[nodeId].secondChild = tree.nodes.size();
+			buildNode(right, depth - 1, rightBounds, tree, state);
+		}
+	protected:
+		static void build(int begin, int end, int depth, const AABB& bounds, int nodeId, std::vector<int>& tempIndices, Tree& tree) {
+			std::vector<Reference> refs;
+			refs.reserve(end - begin);
+			for (int i = begin; i < end; ++i)
+				refs.push_back({ tempIndices[i], tree.boundsArray[tempIndices[i]] });
+			State state;
+			state.references = end - begin;
+			state.maxReferences = state.references + state.references * maxGrowthPercent / 100;
+			state.minOverlap = Alpha * bounds.area();
+			buildNode(refs, depth, bounds, tree, state);
+		}
 	};
 
 	// FULL SAH with overlapping boxes, slow as fuck
@@ -194,6 +501,11 @@ namespace PrimitiveLocators {
 	class FullSAHTreeBuilder {
 		using Tree = AABBTree<Primitive, FullSAHTreeBuilder<Primitive, minPrims, useMaxDir>>;
 		friend class Tree;
+		// names builder and its parameters in cache key
+		static std::string cacheTag() {
+			return "FullSAH " + std::to_string(minPrims) + " " + std::to_string(useMaxDir);
+		}
+		static const bool Cacheable = true;
 	protected:
 		static void build(int begin, int end, int depth, const AABB& bounds, int nodeId, std::vector<int>& tempIndices, Tree& tree) {
 			int numPrims = end - begin;
@@ -313,6 +625,15 @@ namespace PrimitiveLocators {
 		}
 	};
 
+	/// Order of nodes in memory, applied by AABBTree::optimizeLayout after any builder
+	enum class NodeLayout {
+		/// preorder with child of larger surface area placed right after its parent
+		DepthFirst,
+		/// Yoon, Manocha "Cache-Efficient Layouts of Bounding Volume Hierarchies":
+		/// treelets of most probably visited nodes, each treelet starts at cache line
+		Treelets
+	};
+
 	/// AABB tree for primitives with "AABB bbox()" method
 	template<class Primitive, class TreeBuilder>
 	class AABBTree : public Base<Primitive> {
@@ -324,6 +645,10 @@ namespace PrimitiveLocators {
 		friend class BucketSAHTreeBuilder;
 		template<class U, int minPrims, bool useMaxDir>
 		friend class FullSAHTreeBuilder;
+		template<class U, int minPrims, int maxGrowthPercent, int bucketSize, int spatialBins>
+		friend class SpatialSplitTreeBuilder;
+		template<class U, class Builder>
+		friend class QuantizedAABBTree;
 	private:
 		struct Node {
 			enum Type : unsigned int {
@@ -337,12 +662,40 @@ namespace PrimitiveLocators {
 				:type(type), firstChild(firstChild), secondChild(secondChild), bbox(bbox)
 			{}
 		};
+		// version 2: header padded to cache line
+		// version 3: primitive bounds are not stored
+		static const uint32_t CacheVersion = 3;
+		static const int CacheLineSize = 64;
+		// traversal without memory access tracking
+		struct NoVisitor {
+			void operator()(const void* address, size_t size) const {}
+		};
 		std::vector<int> indices;
 		std::vector<AABB> boundsArray;
 		std::vector<Primitive*> primitives;
-		std::vector<Node> nodes;
+		std::vector<Node, AlignedAllocator<Node, CacheLineSize>> nodes;
 		AABB rootBounds;
 		int maxPrimitiveInNode;
+		// traversal data, points into vectors above after build or into mapped cache file
+		// boundsArray is released after build
+		const Node* nodeData = nullptr;
+		const int* indexData = nullptr;
+		int nodeCount = 0;
+		int indexCount = 0;
+		std::shared_ptr<MappedFile> cacheFile;
+		uint64_t cacheKey = 0;
+		void buildNodes(std::vector<int>& tempIndices, int maxDepth);
+		void buildTree(std::vector<int>& tempIndices, int maxDepth);
+		void buildTree(std::vector<int>& tempIndices, int maxDepth, const std::string& cacheFilename);
+		uint64_t computeCacheKey(int maxDepth) const;
+		bool loadCache(const std::string& filename);
+		// primitive bounds are only needed by builders and cache key
+		void releaseBounds();
+		// copies mapped cache into own arrays
+		void detachCache();
+		void applyLayout(const std::vector<int>& order);
+		std::vector<int> depthFirstOrder() const;
+		std::vector<int> treeletOrder(int treeletSize) const;
 		void addLeaf(int begin, int end, int depth, const AABB& bounds, std::vector<int>& tempIndices) {
 			int start = indices.size();
 			for (int i = begin; i < end; ++i)
@@ -357,11 +710,32 @@ namespace PrimitiveLocators {
 		AABBTree(Iterator begin, Iterator end, Primitive*(*get)(Iterator&), int maxDepth = -1);
 		template <class Iterator>
 		AABBTree(Iterator begin, Iterator end, int maxDepth = -1);
+		// loads tree from cache file if it was built for same primitive bounds, otherwise builds and saves it,
+		// trees of builders that are not Cacheable are always built
+		template <class Iterator>
+		AABBTree(Iterator begin, Iterator end, std::function<Primitive*(Iterator&)> get, const std::string& cacheFilename, int maxDepth = -1);
+		template <class Iterator>
+		AABBTree(Iterator begin, Iterator end, const std::string& cacheFilename, int maxDepth = -1);
+		bool saveCache(const std::string& filename) const;
+		// true if tree is mapped from cache file
+		bool isCached() const;
 		template<class Object>
 		std::vector<int> intersectedIndicies(const Object& object) const;
 		virtual bool intersect(const Ray& ray) const override;
 		virtual bool intersect(Ray& ray, HitInfo& hitInfo) const override;
+		// closest hit traversal calling visitor(address, size) for each read of tree data
+		template<class Visitor>
+		bool intersect(Ray& ray, HitInfo& hitInfo, Visitor& visitor) const;
 		virtual AABB bbox() const override;
+		// reorders nodes and leaf indices for traversal locality, tree topology stays the same
+		// treeletSize is number of nodes per treelet, 0 fits treelet in 4 cache lines
+		void optimizeLayout(NodeLayout layout, int treeletSize = 0);
+		// number of primitive references in leaves, exceeds primitive count for spatial split builders
+		int referenceCount() const;
+		// SAH cost of tree: expected number of node visits and primitive tests for random ray hitting root box
+		float sahCost(float traverseCost = 0.125f, float intersectCost = 1.0f) const;
+		// memory used by nodes, leaf indices and primitive pointers in bytes
+		size_t memoryUsage() const;
 		void print() const;
 		bool test() const;
 	};
@@ -526,11 +900,7 @@ namespace PrimitiveLocators {
 			rootBounds.append(boundsArray.back());
 			tempIndices.push_back(tempIndices.size());
 		}
-		// heuristic from pbrt book
-		if (maxDepth <= 0)
-			maxDepth = std::round(8 + 1.3f * glm::log2(primitives.size()));
-		TreeBuilder::build(0, primitivesCount, maxDepth - 1, rootBounds, 0, tempIndices, *this);
-		//build(0, primitivesCount, maxDepth - 1, rootBounds, std::numeric_limits<float>::max(), 0, tempIndices);
+		buildTree(tempIndices, maxDepth);
 	}
 
 	template<class Primitive, class TreeBuilder>
@@ -542,16 +912,12 @@ namespace PrimitiveLocators {
 		std::vector<int> tempIndices;
 		tempIndices.reserve(primitivesCount);
 		for (auto it = begin; it != end; ++it) {
-			primitives.push(get(it));
+			primitives.push_back(get(it));
 			boundsArray.push_back(primitives.back()->bbox());
 			rootBounds.append(boundsArray.back());
 			tempIndices.push_back(tempIndices.size());
 		}
-		// from pbrt book
-		if (maxDepth <= 0)
-			maxDepth = std::round(8 + 1.3f * glm::log2(primitives.size()));
-		//build(0, primitivesCount, maxDepth - 1, rootBounds, std::numeric_limits<float>::max(), 0, tempIndices);
-		TreeBuilder::build(0, primitivesCount, maxDepth - 1, rootBounds, 0, tempIndices, *this);
+		buildTree(tempIndices, maxDepth);
 	}
 
 	template<class Primitive, class TreeBuilder>
@@ -568,10 +934,135 @@ namespace PrimitiveLocators {
 			rootBounds.append(boundsArray.back());
 			tempIndices.push_back(tempIndices.size());
 		}
+		buildTree(tempIndices, maxDepth);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	template <class Iterator>
+	AABBTree<Primitive, TreeBuilder>::AABBTree(Iterator begin, Iterator end, std::function<Primitive*(Iterator&)> get, const std::string& cacheFilename, int maxDepth) {
+		int primitivesCount = std::distance(begin, end);
+		std::vector<int> tempIndices;
+		tempIndices.reserve(primitivesCount);
+		primitives.reserve(primitivesCount);
+		boundsArray.reserve(primitivesCount);
+		for (auto it = begin; it != end; ++it) {
+			primitives.push_back(get(it));
+			boundsArray.push_back(primitives.back()->bbox());
+			rootBounds.append(boundsArray.back());
+			tempIndices.push_back(tempIndices.size());
+		}
+		buildTree(tempIndices, maxDepth, cacheFilename);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	template <class Iterator>
+	AABBTree<Primitive, TreeBuilder>::AABBTree(Iterator begin, Iterator end, const std::string& cacheFilename, int maxDepth) {
+		int primitivesCount = std::distance(begin, end);
+		std::vector<int> tempIndices;
+		tempIndices.reserve(primitivesCount);
+		primitives.reserve(primitivesCount);
+		boundsArray.reserve(primitivesCount);
+		for (auto it = begin; it != end; ++it) {
+			primitives.push_back(&(*it));
+			boundsArray.push_back(it->bbox());
+			rootBounds.append(boundsArray.back());
+			tempIndices.push_back(tempIndices.size());
+		}
+		buildTree(tempIndices, maxDepth, cacheFilename);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void AABBTree<Primitive, TreeBuilder>::buildNodes(std::vector<int>& tempIndices, int maxDepth) {
+		// heuristic from pbrt book
 		if (maxDepth <= 0)
 			maxDepth = std::round(8 + 1.3f * glm::log2(primitives.size()));
-		//build(0, primitivesCount, maxDepth - 1, rootBounds, std::numeric_limits<float>::max(), 0, tempIndices);
-		TreeBuilder::build(0, primitivesCount, maxDepth - 1, rootBounds, 0, tempIndices, *this);
+		if (!primitives.empty())
+			TreeBuilder::build(0, primitives.size(), maxDepth - 1, rootBounds, 0, tempIndices, *this);
+		nodeData = nodes.data();
+		indexData = indices.data();
+		nodeCount = nodes.size();
+		indexCount = indices.size();
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void AABBTree<Primitive, TreeBuilder>::buildTree(std::vector<int>& tempIndices, int maxDepth) {
+		cacheKey = computeCacheKey(maxDepth);
+		buildNodes(tempIndices, maxDepth);
+		releaseBounds();
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void AABBTree<Primitive, TreeBuilder>::buildTree(std::vector<int>& tempIndices, int maxDepth, const std::string& cacheFilename) {
+		cacheKey = computeCacheKey(maxDepth);
+		if (!TreeBuilder::Cacheable)
+			buildNodes(tempIndices, maxDepth);
+		else if (!loadCache(cacheFilename)) {
+			buildNodes(tempIndices, maxDepth);
+			if (!saveCache(cacheFilename))
+				printf("Cannot save accelerator cache %s\n", cacheFilename.c_str());
+		}
+		releaseBounds();
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void AABBTree<Primitive, TreeBuilder>::releaseBounds() {
+		std::vector<AABB>().swap(boundsArray);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	uint64_t AABBTree<Primitive, TreeBuilder>::computeCacheKey(int maxDepth) const {
+		// tree of cacheable builder depends only on builder, depth limit and primitive bounds in input order
+		std::string builderTag = TreeBuilder::cacheTag();
+		uint64_t key = Cache::hash(builderTag.data(), builderTag.size());
+		key = Cache::hash(&maxDepth, sizeof(maxDepth), key);
+		return Cache::hash(boundsArray.data(), boundsArray.size() * sizeof(AABB), key);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	bool AABBTree<Primitive, TreeBuilder>::loadCache(const std::string& filename) {
+		Cache::Header header;
+		std::shared_ptr<MappedFile> file = Cache::open(filename, CacheVersion, cacheKey, sizeof(Node), header);
+		if (!file)
+			return false;
+		size_t nodesSize = header.nodeCount * sizeof(Node);
+		size_t indicesSize = header.indexCount * sizeof(int);
+		if (header.primitiveCount != primitives.size() || file->size() != sizeof(Cache::Header) + nodesSize + indicesSize)
+			return false;
+		const char* data = file->data() + sizeof(Cache::Header);
+		nodeData = reinterpret_cast<const Node*>(data);
+		indexData = reinterpret_cast<const int*>(data + nodesSize);
+		nodeCount = header.nodeCount;
+		indexCount = header.indexCount;
+		rootBounds = AABB(vec3(header.rootBounds[0], header.rootBounds[1], header.rootBounds[2]),
+			vec3(header.rootBounds[3], header.rootBounds[4], header.rootBounds[5]));
+		cacheFile = file;
+		return true;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	bool AABBTree<Primitive, TreeBuilder>::saveCache(const std::string& filename) const {
+		if (!TreeBuilder::Cacheable)
+			return false;
+		Cache::Header header = {};
+		header.version = CacheVersion;
+		header.key = cacheKey;
+		header.nodeSize = sizeof(Node);
+		header.nodeCount = nodeCount;
+		header.indexCount = indexCount;
+		header.primitiveCount = primitives.size();
+		for (int dim = 0; dim < 3; ++dim) {
+			header.rootBounds[dim] = rootBounds.min()[dim];
+			header.rootBounds[3 + dim] = rootBounds.max()[dim];
+		}
+		return Cache::write(filename, header, {
+			{ nodeData, nodeCount * sizeof(Node) },
+			{ indexData, indexCount * sizeof(int) }
+			});
+	}
+
+	template<class Primitive, class TreeBuilder>
+	bool AABBTree<Primitive, TreeBuilder>::isCached() const {
+		return cacheFile != nullptr;
 	}
 
 	template<class Primitive, class TreeBuilder>
@@ -583,12 +1074,12 @@ namespace PrimitiveLocators {
 	template<class Object>
 	std::vector<int> AABBTree<Primitive, TreeBuilder>::intersectedIndicies(const Object& object) const {
 		std::vector<int> result;
-		if (nodes.empty())
+		if (nodeCount == 0)
 			return result;
 		std::stack<int> nodeStack;
 		nodeStack.push(0);
 		while (!nodeStack.empty()) {
-			const Node& current = nodes[nodeStack.top()];
+			const Node& current = nodeData[nodeStack.top()];
 			nodeStack.pop();
 			if (!current.bbox.intersect(object))
 				continue;
@@ -598,22 +1089,31 @@ namespace PrimitiveLocators {
 				continue;
 			}
 			for (int i = current.firstChild; i < current.secondChild; ++i) {
-				if (primitives[indices[i]]->intersect(object))
-					result.push_back(indices[i]);
+				if (primitives[indexData[i]]->intersect(object))
+					result.push_back(indexData[i]);
 			}
 		}
+		// primitive may be referenced from several leaves
+		if (indexCount > primitives.size()) {
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+		}
 		return result;
 	}
 
 	template<class Primitive, class TreeBuilder>
 	bool AABBTree<Primitive, TreeBuilder>::intersect(const Ray& ray) const {
-		if (nodes.empty())
+		if (nodeCount == 0)
 			return false;
+		// counted locally, so traversal touches thread counters once
+		uint64_t visited = 0;
+		uint64_t tests = 0;
 		std::stack<int> nodeStack;
 		nodeStack.push(0);
 		while (!nodeStack.empty()) {
-			const Node& current = nodes[nodeStack.top()];
+			const Node& current = nodeData[nodeStack.top()];
 			nodeStack.pop();
+			visited++;
 			if (!current.bbox.intersect(ray))
 				continue;
 			if (current.type != Node::Leaf) {
@@ -622,22 +1122,39 @@ namespace PrimitiveLocators {
 				continue;
 			}
 			for (int i = current.firstChild; i < current.secondChild; ++i) {
-				if (primitives[indices[i]]->intersect(ray))
+				tests++;
+				if (primitives[indexData[i]]->intersect(ray)) {
+					STATS_ADD(NodesVisited, visited);
+					STATS_ADD(PrimitiveTests, tests);
 					return true;
+				}
 			}
 		}
+		STATS_ADD(NodesVisited, visited);
+		STATS_ADD(PrimitiveTests, tests);
 		return false;
 	}
 	template<class Primitive, class TreeBuilder>
 	bool AABBTree<Primitive, TreeBuilder>::intersect(Ray& ray, HitInfo& hitInfo) const {
-		if (nodes.empty())
+		NoVisitor visitor;
+		return intersect(ray, hitInfo, visitor);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	template<class Visitor>
+	bool AABBTree<Primitive, TreeBuilder>::intersect(Ray& ray, HitInfo& hitInfo, Visitor& visitor) const {
+		if (nodeCount == 0)
 			return false;
 		bool result = false;
+		uint64_t visited = 0;
+		uint64_t tests = 0;
 		std::stack<int> nodeStack;
 		nodeStack.push(0);
 		while (!nodeStack.empty()) {
-			const Node& current = nodes[nodeStack.top()];
+			const Node& current = nodeData[nodeStack.top()];
 			nodeStack.pop();
+			visitor(&current, sizeof(Node));
+			visited++;
 			if (!current.bbox.intersect(ray))
 				continue;
 			if (current.type != Node::Leaf) {
@@ -645,11 +1162,177 @@ namespace PrimitiveLocators {
 				nodeStack.push(current.firstChild);
 				continue;
 			}
-			for (int i = current.firstChild; i < current.secondChild; ++i)
-				result = primitives[indices[i]]->intersect(ray, hitInfo) || result;
+			visitor(indexData + current.firstChild, (current.secondChild - current.firstChild) * sizeof(int));
+			tests += current.secondChild - current.firstChild;
+			for (int i = current.firstChild; i < current.secondChild; ++i) {
+				// shapes take ray by const reference, so shrink ray here to keep closest hit
+				if (primitives[indexData[i]]->intersect(ray, hitInfo)) {
+					ray.tMax = hitInfo.t;
+					result = true;
+				}
+			}
 		}
+		STATS_ADD(NodesVisited, visited);
+		STATS_ADD(PrimitiveTests, tests);
 		return result;
 	}
+	template<class Primitive, class TreeBuilder>
+	void AABBTree<Primitive, TreeBuilder>::detachCache() {
+		if (!cacheFile)
+			return;
+		nodes.assign(nodeData, nodeData + nodeCount);
+		indices.assign(indexData, indexData + indexCount);
+		nodeData = nodes.data();
+		indexData = indices.data();
+		cacheFile.reset();
+	}
+
+	template<class Primitive, class TreeBuilder>
+	std::vector<int> AABBTree<Primitive, TreeBuilder>::depthFirstOrder() const {
+		std::vector<int> order;
+		order.reserve(nodeCount);
+		std::stack<int> nodeStack;
+		nodeStack.push(0);
+		while (!nodeStack.empty()) {
+			int nodeId = nodeStack.top();
+			nodeStack.pop();
+			order.push_back(nodeId);
+			const Node& node = nodes[nodeId];
+			if (node.type == Node::Leaf)
+				continue;
+			int first = node.firstChild;
+			int second = node.secondChild;
+			if (nodes[first].bbox.area() < nodes[second].bbox.area())
+				std::swap(first, second);
+			nodeStack.push(second);
+			nodeStack.push(first);
+		}
+		return order;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	std::vector<int> AABBTree<Primitive, TreeBuilder>::treeletOrder(int treeletSize) const {
+		const int NodesPerLine = std::max(1, CacheLineSize / int(sizeof(Node)));
+		std::vector<int> order;
+		order.reserve(nodeCount);
+		auto byArea = [this](int a, int b) {
+			return nodes[a].bbox.area() < nodes[b].bbox.area();
+		};
+		std::stack<int> treeletRoots;
+		treeletRoots.push(0);
+		std::vector<int> candidates;
+		while (!treeletRoots.empty()) {
+			int root = treeletRoots.top();
+			treeletRoots.pop();
+			// padding nodes are never referenced
+			while (order.size() % NodesPerLine != 0)
+				order.push_back(-1);
+			// grow treelet by node with highest probability to be visited, i.e. largest area
+			candidates.clear();
+			candidates.push_back(root);
+			for (int size = 0; size < treeletSize && !candidates.empty(); ++size) {
+				std::pop_heap(candidates.begin(), candidates.end(), byArea);
+				int nodeId = candidates.back();
+				candidates.pop_back();
+				order.push_back(nodeId);
+				const Node& node = nodes[nodeId];
+				if (node.type == Node::Leaf)
+					continue;
+				candidates.push_back(node.firstChild);
+				std::push_heap(candidates.begin(), candidates.end(), byArea);
+				candidates.push_back(node.secondChild);
+				std::push_heap(candidates.begin(), candidates.end(), byArea);
+			}
+			// larger subtrees are laid out first
+			std::sort(candidates.begin(), candidates.end(), byArea);
+			for (int nodeId : candidates)
+				treeletRoots.push(nodeId);
+		}
+		return order;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void AABBTree<Primitive, TreeBuilder>::applyLayout(const std::vector<int>& order) {
+		std::vector<int> newIds(nodes.size(), -1);
+		for (int i = 0; i < order.size(); ++i) {
+			if (order[i] != -1)
+				newIds[order[i]] = i;
+		}
+		std::vector<Node, AlignedAllocator<Node, CacheLineSize>> newNodes;
+		newNodes.reserve(order.size());
+		std::vector<int> newIndices;
+		newIndices.reserve(indices.size());
+		for (int nodeId : order) {
+			if (nodeId == -1) {
+				// empty leaf with degenerate box, does not contribute to sah cost
+				newNodes.emplace_back(Node::Type::Leaf, 0, 0, AABB(vec3(0.0f), vec3(0.0f)));
+				continue;
+			}
+			const Node& node = nodes[nodeId];
+			if (node.type != Node::Leaf) {
+				newNodes.emplace_back(Node::Type::Inter, newIds[node.firstChild], newIds[node.secondChild], node.bbox);
+				continue;
+			}
+			// leaf primitives follow order of leaves
+			int start = newIndices.size();
+			newIndices.insert(newIndices.end(), indices.begin() + node.firstChild, indices.begin() + node.secondChild);
+			newNodes.emplace_back(Node::Type::Leaf, start, newIndices.size(), node.bbox);
+		}
+		nodes.swap(newNodes);
+		indices.swap(newIndices);
+		nodeData = nodes.data();
+		indexData = indices.data();
+		nodeCount = nodes.size();
+		indexCount = indices.size();
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void AABBTree<Primitive, TreeBuilder>::optimizeLayout(NodeLayout layout, int treeletSize) {
+		if (nodeCount == 0)
+			return;
+		detachCache();
+		if (treeletSize <= 0)
+			treeletSize = 4 * CacheLineSize / int(sizeof(Node));
+		switch (layout) {
+		case NodeLayout::DepthFirst:
+			applyLayout(depthFirstOrder());
+			break;
+		case NodeLayout::Treelets:
+			applyLayout(treeletOrder(treeletSize));
+			break;
+		}
+	}
+
+	template<class Primitive, class TreeBuilder>
+	int AABBTree<Primitive, TreeBuilder>::referenceCount() const {
+		return indexCount;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	size_t AABBTree<Primitive, TreeBuilder>::memoryUsage() const {
+		return nodeCount * sizeof(Node) + indexCount * sizeof(int) + primitives.capacity() * sizeof(Primitive*) +
+			boundsArray.capacity() * sizeof(AABB);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	float AABBTree<Primitive, TreeBuilder>::sahCost(float traverseCost, float intersectCost) const {
+		if (nodeCount == 0)
+			return 0.0f;
+		float rootArea = nodeData[0].bbox.area();
+		if (rootArea <= 0.0f)
+			return 0.0f;
+		float cost = 0.0f;
+		for (int i = 0; i < nodeCount; ++i) {
+			const Node& node = nodeData[i];
+			float probability = node.bbox.area() / rootArea;
+			if (node.type == Node::Leaf)
+				cost += probability * intersectCost * (node.secondChild - node.firstChild);
+			else
+				cost += probability * traverseCost;
+		}
+		return cost;
+	}
+
 	template<class Primitive, class TreeBuilder>
 	void AABBTree<Primitive, TreeBuilder>::print() const {
 		int index = 0;
@@ -662,7 +1345,7 @@ namespace PrimitiveLocators {
 		nodeStack.push(0);
 		while (!nodeStack.empty()) {
 			int nodeId = nodeStack.top();
-			const Node& current = nodes[nodeStack.top()];
+			const Node& current = nodeData[nodeStack.top()];
 			nodeStack.pop();
 			const AABB& aabb = current.bbox;
 			if (current.type != Node::Leaf) {
@@ -678,23 +1361,26 @@ namespace PrimitiveLocators {
 	}
 	template<class Primitive, class TreeBuilder>
 	bool AABBTree<Primitive, TreeBuilder>::test() const {
-		if (nodes.empty())
+		if (nodeCount == 0)
 			return true;
 		bool result = true;
 		std::stack<int> nodeStack;
 		nodeStack.push(0);
 		while (!nodeStack.empty()) {
-			const Node& current = nodes[nodeStack.top()];
+			const Node& current = nodeData[nodeStack.top()];
 			nodeStack.pop();
 			if (current.type != Node::Leaf) {
 				nodeStack.push(current.secondChild);
 				nodeStack.push(current.firstChild);
-				if (!current.bbox.contains(nodes[current.secondChild].bbox) || !current.bbox.contains(nodes[current.firstChild].bbox))
+				if (!current.bbox.contains(nodeData[current.secondChild].bbox) || !current.bbox.contains(nodeData[current.firstChild].bbox))
 					return false;
 				continue;
 			}
+			// clipped references only overlap leaf box
+			bool hasClippedReferences = indexCount > primitives.size();
 			for (int i = current.firstChild; i < current.secondChild; ++i) {
-				if (!current.bbox.contains(primitives[indices[i]]->bbox()))
+				const AABB primitiveBBox = primitives[indexData[i]]->bbox();
+				if (hasClippedReferences ? intersectionOp(current.bbox, primitiveBBox).isEmpty() : !current.bbox.contains(primitiveBBox))
 					return false;
 			}
 		}
@@ -1,5 +1,6 @@
 #pragma once
 #include "Base.h"
+#include "../../Stats.h"
 #include <functional>
 
 namespace PrimitiveLocators {
@@ -71,21 +72,33 @@ namespace PrimitiveLocators {
 	}
 	template<class Primitive>
 	bool BruteForce<Primitive>::intersect(const Ray& ray) const {
+		STATS_INC(NodesVisited);
 		if (!bounds.intersect(ray))
 			return false;
+		uint64_t tests = 0;
 		for (const auto& primitive : primitives) {
-			if (primitive->intersect(ray))
+			tests++;
+			if (primitive->intersect(ray)) {
+				STATS_ADD(PrimitiveTests, tests);
 				return true;
+			}
 		}
+		STATS_ADD(PrimitiveTests, tests);
 		return false;
 	}
 	template<class Primitive>
 	bool BruteForce<Primitive>::intersect(Ray& ray, HitInfo& hitInfo) const {
+		STATS_INC(NodesVisited);
 		if (!bounds.intersect(ray))
 			return false;
+		STATS_ADD(PrimitiveTests, primitives.size());
 		bool result = false;
 		for (const auto& primitive : primitives) {
-			result = primitive->intersect(ray, hitInfo) || result;
+			// shapes take ray by const reference, so shrink ray here to keep closest hit
+			if (primitive->intersect(ray, hitInfo)) {
+				ray.tMax = hitInfo.t;
+				result = true;
+			}
 		}
 		return result;
 	}
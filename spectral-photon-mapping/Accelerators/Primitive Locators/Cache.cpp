@@ -0,0 +1,77 @@
+#include "Cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <windows.h>
+#undef min
+#undef max
+
+
+namespace PrimitiveLocators {
+	namespace Cache {
+		static const char Magic[4] = { 'A', 'C', 'C', 'L' };
+
+		uint64_t hash(const void* data, size_t size, uint64_t seed) {
+			// FNV-1a
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			uint64_t result = seed;
+			for (size_t i = 0; i < size; ++i) {
+				result ^= bytes[i];
+				result *= 1099511628211ull;
+			}
+			return result;
+		}
+
+		bool write(const std::string& filename, const Header& header, std::initializer_list<Section> sections) {
+			std::string tempFilename = filename + ".tmp";
+			{
+				std::ofstream file(tempFilename, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+				if (!file.is_open())
+					return false;
+				Header result = header;
+				memcpy(result.magic, Magic, sizeof(Magic));
+				file.write(reinterpret_cast<const char*>(&result), sizeof(Header));
+				for (const auto& section : sections)
+					file.write(static_cast<const char*>(section.data), section.size);
+				if (!file.good()) {
+					file.close();
+					std::remove(tempFilename.c_str());
+					return false;
+				}
+			}
+			if (MoveFileExA(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+				return true;
+			// cache mapped by other process cannot be replaced, but it can be renamed aside and deleted,
+			// its readers keep their mapping until they close it
+			std::string staleFilename = filename + ".stale" + std::to_string(GetCurrentProcessId());
+			if (MoveFileExA(filename.c_str(), staleFilename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+				if (MoveFileExA(tempFilename.c_str(), filename.c_str(), MOVEFILE_WRITE_THROUGH)) {
+					DeleteFileA(staleFilename.c_str());
+					return true;
+				}
+				MoveFileExA(staleFilename.c_str(), filename.c_str(), 0);
+			}
+			std::remove(tempFilename.c_str());
+			return false;
+		}
+
+		std::shared_ptr<MappedFile> open(const std::string& filename, uint32_t version, uint64_t key, uint32_t nodeSize, Header& header) {
+			std::shared_ptr<MappedFile> file;
+			try {
+				file = std::make_shared<MappedFile>(filename);
+			}
+			catch (const std::runtime_error&) {
+				return nullptr;
+			}
+			if (file->size() < sizeof(Header))
+				return nullptr;
+			memcpy(&header, file->data(), sizeof(Header));
+			if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != version ||
+				header.key != key || header.nodeSize != nodeSize)
+				return nullptr;
+			return file;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <initializer_list>
+
+#include "../../MappedFile.h"
+
+
+namespace PrimitiveLocators {
+	// Versioned binary files with flattened accelerators
+	// Layout: header followed by sections written back to back
+	namespace Cache {
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			// hash of input geometry and build parameters
+			uint64_t key;
+			// size of node structure, guards against layout changes
+			uint32_t nodeSize;
+			uint32_t nodeCount;
+			uint32_t indexCount;
+			uint32_t primitiveCount;
+			float rootBounds[6];
+			// pads header to cache line, so mapped nodes stay aligned
+			uint32_t reserved[2];
+		};
+		struct Section {
+			const void* data;
+			size_t size;
+		};
+		uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+		// writes into temporary file and renames it, so readers never see partially written cache,
+		// file mapped by other process is renamed aside first, returns false if cache could not be replaced
+		bool write(const std::string& filename, const Header& header, std::initializer_list<Section> sections);
+		// maps file read-only, returns nullptr if file is missing or header does not match
+		std::shared_ptr<MappedFile> open(const std::string& filename, uint32_t version, uint64_t key, uint32_t nodeSize, Header& header);
+	}
+}
\ No newline at end of file
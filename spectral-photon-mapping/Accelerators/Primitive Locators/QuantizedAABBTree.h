@@ -0,0 +1,318 @@
+#pragma once
+#include "AABBTree.h"
+#include <cstdint>
+
+namespace PrimitiveLocators {
+	/// Compressed AABB tree for large scenes, node is 20 bytes instead of 32
+	/// Child bounds are stored with 8 bits per plane relative to decoded parent bounds and
+	/// rounded outwards, so decoded boxes always contain full precision ones.
+	/// Tree is built as AABBTree with TreeBuilder and converted, full precision nodes are not kept.
+	template<class Primitive, class TreeBuilder>
+	class QuantizedAABBTree : public Base<Primitive> {
+		using SourceTree = AABBTree<Primitive, TreeBuilder>;
+		using Base<Primitive>::primitives;
+		struct Node {
+			// per child: min xyz, max xyz in steps of parent extent
+			uint8_t bounds[2][6];
+			// inner child: node index, leaf child: LeafFlag | offset of leaf in leafData
+			uint32_t children[2];
+		};
+		struct StackEntry {
+			uint32_t nodeId;
+			AABB bounds;
+		};
+		static const uint32_t LeafFlag = 0x80000000u;
+		static const uint32_t EmptyChild = 0xFFFFFFFFu;
+		static const int QuantizationSteps = 255;
+		std::vector<Node> nodes;
+		// each leaf is primitive count followed by primitive indices
+		std::vector<int> leafData;
+		AABB rootBounds;
+		int referenceCount = 0;
+		void convert(const SourceTree& tree);
+		uint32_t convertNode(const SourceTree& tree, int sourceId, const AABB& bounds);
+		uint32_t convertChild(const SourceTree& tree, int sourceId, const AABB& parentBounds, uint8_t* quantizedBounds);
+		static float decodePlane(const AABB& parent, int dim, int step);
+		static AABB decode(const AABB& parent, const uint8_t* quantizedBounds);
+		static void encode(const AABB& parent, const AABB& child, uint8_t* quantizedBounds);
+	public:
+		template <class Iterator>
+		QuantizedAABBTree(Iterator begin, Iterator end, std::function<Primitive*(Iterator&)> get, int maxDepth = -1);
+		template <class Iterator>
+		QuantizedAABBTree(Iterator begin, Iterator end, Primitive*(*get)(Iterator&), int maxDepth = -1);
+		template <class Iterator>
+		QuantizedAABBTree(Iterator begin, Iterator end, int maxDepth = -1);
+		template<class Object>
+		std::vector<int> intersectedIndicies(const Object& object) const;
+		virtual bool intersect(const Ray& ray) const override;
+		virtual bool intersect(Ray& ray, HitInfo& hitInfo) const override;
+		virtual AABB bbox() const override;
+		// memory used by nodes, leaves and primitive pointers in bytes
+		size_t memoryUsage() const;
+		bool test() const;
+	};
+
+	template<class Primitive, class TreeBuilder>
+	template <class Iterator>
+	QuantizedAABBTree<Primitive, TreeBuilder>::QuantizedAABBTree(Iterator begin, Iterator end, std::function<Primitive*(Iterator&)> get, int maxDepth) {
+		convert(SourceTree(begin, end, get, maxDepth));
+	}
+
+	template<class Primitive, class TreeBuilder>
+	template <class Iterator>
+	QuantizedAABBTree<Primitive, TreeBuilder>::QuantizedAABBTree(Iterator begin, Iterator end, Primitive*(*get)(Iterator&), int maxDepth) {
+		convert(SourceTree(begin, end, get, maxDepth));
+	}
+
+	template<class Primitive, class TreeBuilder>
+	template <class Iterator>
+	QuantizedAABBTree<Primitive, TreeBuilder>::QuantizedAABBTree(Iterator begin, Iterator end, int maxDepth) {
+		convert(SourceTree(begin, end, maxDepth));
+	}
+
+	template<class Primitive, class TreeBuilder>
+	float QuantizedAABBTree<Primitive, TreeBuilder>::decodePlane(const AABB& parent, int dim, int step) {
+		// last step is exactly parent plane, otherwise rounding could move it inside
+		if (step == QuantizationSteps)
+			return parent.max()[dim];
+		return std::min(parent.min()[dim] + step * (parent.size()[dim] / QuantizationSteps), parent.max()[dim]);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	AABB QuantizedAABBTree<Primitive, TreeBuilder>::decode(const AABB& parent, const uint8_t* quantizedBounds) {
+		vec3 min;
+		vec3 max;
+		for (int dim = 0; dim < 3; ++dim) {
+			min[dim] = decodePlane(parent, dim, quantizedBounds[dim]);
+			max[dim] = decodePlane(parent, dim, quantizedBounds[3 + dim]);
+		}
+		return AABB(min, max);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void QuantizedAABBTree<Primitive, TreeBuilder>::encode(const AABB& parent, const AABB& child, uint8_t* quantizedBounds) {
+		for (int dim = 0; dim < 3; ++dim) {
+			float stepSize = parent.size()[dim] / QuantizationSteps;
+			int min = 0;
+			int max = QuantizationSteps;
+			if (stepSize > 0.0f) {
+				min = glm::clamp(int(std::floor((child.min()[dim] - parent.min()[dim]) / stepSize)), 0, QuantizationSteps);
+				max = glm::clamp(int(std::ceil((child.max()[dim] - parent.min()[dim]) / stepSize)), 0, QuantizationSteps);
+				// decoding rounds differently from division above, move planes outwards until child is covered
+				while (min > 0 && decodePlane(parent, dim, min) > child.min()[dim])
+					min--;
+				while (max < QuantizationSteps && decodePlane(parent, dim, max) < child.max()[dim])
+					max++;
+			}
+			quantizedBounds[dim] = uint8_t(min);
+			quantizedBounds[3 + dim] = uint8_t(max);
+		}
+	}
+
+	template<class Primitive, class TreeBuilder>
+	uint32_t QuantizedAABBTree<Primitive, TreeBuilder>::convertChild(const SourceTree& tree, int sourceId, const AABB& parentBounds, uint8_t* quantizedBounds) {
+		const auto& source = tree.nodeData[sourceId];
+		encode(parentBounds, source.bbox, quantizedBounds);
+		if (source.type != SourceTree::Node::Leaf)
+			return convertNode(tree, sourceId, decode(parentBounds, quantizedBounds));
+		uint32_t offset = leafData.size();
+		leafData.push_back(source.secondChild - source.firstChild);
+		leafData.insert(leafData.end(), tree.indexData + source.firstChild, tree.indexData + source.secondChild);
+		return LeafFlag | offset;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	uint32_t QuantizedAABBTree<Primitive, TreeBuilder>::convertNode(const SourceTree& tree, int sourceId, const AABB& bounds) {
+		uint32_t nodeId = nodes.size();
+		nodes.emplace_back();
+		const auto& source = tree.nodeData[sourceId];
+		// nodes can be reallocated during recursion, so children are written through index
+		Node node;
+		node.children[0] = convertChild(tree, source.firstChild, bounds, node.bounds[0]);
+		node.children[1] = convertChild(tree, source.secondChild, bounds, node.bounds[1]);
+		nodes[nodeId] = node;
+		return nodeId;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	void QuantizedAABBTree<Primitive, TreeBuilder>::convert(const SourceTree& tree) {
+		primitives = tree.primitives;
+		referenceCount = tree.indexCount;
+		if (tree.nodeCount == 0)
+			return;
+		rootBounds = tree.nodeData[0].bbox;
+		if (tree.nodeData[0].type != SourceTree::Node::Leaf) {
+			convertNode(tree, 0, rootBounds);
+			return;
+		}
+		// single leaf tree still needs node to reference it
+		Node root;
+		root.children[0] = convertChild(tree, 0, rootBounds, root.bounds[0]);
+		root.children[1] = EmptyChild;
+		memset(root.bounds[1], 0, sizeof(root.bounds[1]));
+		nodes.push_back(root);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	AABB QuantizedAABBTree<Primitive, TreeBuilder>::bbox() const {
+		return rootBounds;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	size_t QuantizedAABBTree<Primitive, TreeBuilder>::memoryUsage() const {
+		return nodes.capacity() * sizeof(Node) + leafData.capacity() * sizeof(int) + primitives.capacity() * sizeof(Primitive*);
+	}
+
+	template<class Primitive, class TreeBuilder>
+	template<class Object>
+	std::vector<int> QuantizedAABBTree<Primitive, TreeBuilder>::intersectedIndicies(const Object& object) const {
+		std::vector<int> result;
+		if (nodes.empty() || !rootBounds.intersect(object))
+			return result;
+		std::stack<StackEntry> nodeStack;
+		nodeStack.push({ 0, rootBounds });
+		while (!nodeStack.empty()) {
+			StackEntry current = nodeStack.top();
+			nodeStack.pop();
+			const Node& node = nodes[current.nodeId];
+			for (int i = 0; i < 2; ++i) {
+				uint32_t child = node.children[i];
+				if (child == EmptyChild)
+					continue;
+				AABB childBounds = decode(current.bounds, node.bounds[i]);
+				if (!childBounds.intersect(object))
+					continue;
+				if (!(child & LeafFlag)) {
+					nodeStack.push({ child, childBounds });
+					continue;
+				}
+				const int* leaf = &leafData[child & ~LeafFlag];
+				for (int j = 1; j <= leaf[0]; ++j) {
+					if (primitives[leaf[j]]->intersect(object))
+						result.push_back(leaf[j]);
+				}
+			}
+		}
+		// primitive may be referenced from several leaves
+		if (referenceCount > primitives.size()) {
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+		}
+		return result;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	bool QuantizedAABBTree<Primitive, TreeBuilder>::intersect(const Ray& ray) const {
+		if (nodes.empty() || !rootBounds.intersect(ray))
+			return false;
+		uint64_t visited = 1;
+		uint64_t tests = 0;
+		std::stack<StackEntry> nodeStack;
+		nodeStack.push({ 0, rootBounds });
+		while (!nodeStack.empty()) {
+			StackEntry current = nodeStack.top();
+			nodeStack.pop();
+			const Node& node = nodes[current.nodeId];
+			for (int i = 0; i < 2; ++i) {
+				uint32_t child = node.children[i];
+				if (child == EmptyChild)
+					continue;
+				AABB childBounds = decode(current.bounds, node.bounds[i]);
+				visited++;
+				if (!childBounds.intersect(ray))
+					continue;
+				if (!(child & LeafFlag)) {
+					nodeStack.push({ child, childBounds });
+					continue;
+				}
+				const int* leaf = &leafData[child & ~LeafFlag];
+				for (int j = 1; j <= leaf[0]; ++j) {
+					tests++;
+					if (primitives[leaf[j]]->intersect(ray)) {
+						STATS_ADD(NodesVisited, visited);
+						STATS_ADD(PrimitiveTests, tests);
+						return true;
+					}
+				}
+			}
+		}
+		STATS_ADD(NodesVisited, visited);
+		STATS_ADD(PrimitiveTests, tests);
+		return false;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	bool QuantizedAABBTree<Primitive, TreeBuilder>::intersect(Ray& ray, HitInfo& hitInfo) const {
+		if (nodes.empty() || !rootBounds.intersect(ray))
+			return false;
+		bool result = false;
+		uint64_t visited = 1;
+		uint64_t tests = 0;
+		std::stack<StackEntry> nodeStack;
+		nodeStack.push({ 0, rootBounds });
+		while (!nodeStack.empty()) {
+			StackEntry current = nodeStack.top();
+			nodeStack.pop();
+			const Node& node = nodes[current.nodeId];
+			for (int i = 0; i < 2; ++i) {
+				uint32_t child = node.children[i];
+				if (child == EmptyChild)
+					continue;
+				AABB childBounds = decode(current.bounds, node.bounds[i]);
+				visited++;
+				if (!childBounds.intersect(ray))
+					continue;
+				if (!(child & LeafFlag)) {
+					nodeStack.push({ child, childBounds });
+					continue;
+				}
+				const int* leaf = &leafData[child & ~LeafFlag];
+				tests += leaf[0];
+				for (int j = 1; j <= leaf[0]; ++j) {
+					// shapes take ray by const reference, so shrink ray here to keep closest hit
+					if (primitives[leaf[j]]->intersect(ray, hitInfo)) {
+						ray.tMax = hitInfo.t;
+						result = true;
+					}
+				}
+			}
+		}
+		STATS_ADD(NodesVisited, visited);
+		STATS_ADD(PrimitiveTests, tests);
+		return result;
+	}
+
+	template<class Primitive, class TreeBuilder>
+	bool QuantizedAABBTree<Primitive, TreeBuilder>::test() const {
+		if (nodes.empty())
+			return true;
+		// clipped references of spatial splits only overlap leaf box
+		bool hasClippedReferences = referenceCount > primitives.size();
+		std::stack<StackEntry> nodeStack;
+		nodeStack.push({ 0, rootBounds });
+		while (!nodeStack.empty()) {
+			StackEntry current = nodeStack.top();
+			nodeStack.pop();
+			const Node& node = nodes[current.nodeId];
+			for (int i = 0; i < 2; ++i) {
+				uint32_t child = node.children[i];
+				if (child == EmptyChild)
+					continue;
+				AABB childBounds = decode(current.bounds, node.bounds[i]);
+				if (!current.bounds.contains(childBounds))
+					return false;
+				if (!(child & LeafFlag)) {
+					nodeStack.push({ child, childBounds });
+					continue;
+				}
+				const int* leaf = &leafData[child & ~LeafFlag];
+				for (int j = 1; j <= leaf[0]; ++j) {
+					const AABB primitiveBBox = primitives[leaf[j]]->bbox();
+					if (hasClippedReferences ? intersectionOp(childBounds, primitiveBBox).isEmpty() : !childBounds.contains(primitiveBBox))
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+}
\ No newline at end of file
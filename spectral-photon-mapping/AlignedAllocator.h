@@ -0,0 +1,36 @@
+#pragma once
+#include <malloc.h>
+#include <cstddef>
+#include <new>
+
+
+// std::allocator ignores alignment above alignof(max_align_t) before C++17
+template<class T, size_t Alignment>
+class AlignedAllocator {
+public:
+	using value_type = T;
+	template<class U>
+	struct rebind {
+		using other = AlignedAllocator<U, Alignment>;
+	};
+	AlignedAllocator() = default;
+	template<class U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+	T* allocate(size_t count) {
+		void* result = _aligned_malloc(count * sizeof(T), Alignment);
+		if (!result)
+			throw std::bad_alloc();
+		return static_cast<T*>(result);
+	}
+	void deallocate(T* pointer, size_t) {
+		_aligned_free(pointer);
+	}
+	template<class U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const {
+		return true;
+	}
+	template<class U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+		return false;
+	}
+};
\ No newline at end of file
@@ -28,7 +28,7 @@ vec3 BBox3D::size() const {
 }
 
 bool BBox3D::isEmpty() const {
-	return _max.x > _min.x || _max.y > _min.y || _max.z > _min.z;
+	return _max.x < _min.x || _max.y < _min.y || _max.z < _min.z;
 }
 
 bool BBox3D::isInBall(const vec3& center, float radiusSqr) const {
@@ -114,7 +114,7 @@ bool BBox3D::intersectInclusive(const Ray& ray) const {
 	vec3 tmin = -s + o;
 	vec3 tmax = s + o;
 	float tNear = std::max(std::max(tmin.x, tmin.y), tmin.z);
-	float tFar = std::max(std::max(tmax.x, tmax.y), tmax.z);
+	float tFar = std::min(std::min(tmax.x, tmax.y), tmax.z);
 	if (tNear > tFar)
 		return false;
 	if ((tNear < ray.tMin || tNear > ray.tMax) && (tFar < ray.tMin || tFar > ray.tMax))
@@ -128,7 +128,7 @@ bool BBox3D::intersectInclusive(const Ray& ray, float& t) const {
 	vec3 tmin = -s + o;
 	vec3 tmax = s + o;
 	float tNear = std::max(std::max(tmin.x, tmin.y), tmin.z);
-	float tFar = std::max(std::max(tmax.x, tmax.y), tmax.z);
+	float tFar = std::min(std::min(tmax.x, tmax.y), tmax.z);
 	if (tNear > tFar)
 		return false;
 	if (!(tNear < ray.tMin || tNear > ray.tMax)) {
@@ -149,7 +149,7 @@ bool BBox3D::intersect(const Ray& ray) const {
 	vec3 tmin = -s + o;
 	vec3 tmax = s + o;
 	float tNear = std::max(std::max(tmin.x, tmin.y), tmin.z);
-	float tFar = std::max(std::max(tmax.x, tmax.y), tmax.z);
+	float tFar = std::min(std::min(tmax.x, tmax.y), tmax.z);
 	if (tNear > tFar || tFar < ray.tMin || tNear > ray.tMax)
 		return false;
 	return true;
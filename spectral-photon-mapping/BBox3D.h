@@ -53,7 +53,7 @@ BBox3D subtractionOp(const BBox3D& a, const BBox3D& b);
 template<size_t Size>
 BBox3D::BBox3D(const std::array<glm::vec3, Size> array)
 	:_min(std::numeric_limits<float>::max())
-	, _max(std::numeric_limits<float>::min()) {
+	, _max(std::numeric_limits<float>::lowest()) {
 	for (int i = 0; i < Size; i++) {
 		const auto& element = array[i];
 		_min = glm::min(_min, element);
@@ -64,7 +64,7 @@ BBox3D::BBox3D(const std::array<glm::vec3, Size> array)
 template<class Iterator>
 BBox3D::BBox3D(const Iterator& begin, const Iterator& end)
 	:_min(std::numeric_limits<float>::max())
-	, _max(std::numeric_limits<float>::min()) {
+	, _max(std::numeric_limits<float>::lowest()) {
 	for (auto it = begin; it != end; ++it) {
 		_min = glm::min(*it, _min);
 		_max = glm::max(*it, _max);
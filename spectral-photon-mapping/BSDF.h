@@ -1,6 +1,9 @@
 #pragma once
 #include "BxDF.h"
 
+#include <algorithm>
+#include <limits>
+
 template<class Color>
 class BSDF {
 	std::vector<spBxDF<Color>> bxdfs;
@@ -10,7 +13,8 @@ public:
 	void add(const spBxDF<Color>& bxdf);
 	int numComponents(int type) const;
 	bool hasType(int type) const;
-	Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int matchTypes, int& sampledType, bool isBackward = true) const;
+	// u.x chooses component and is then rescaled for its sampling
+	Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int matchTypes, int& sampledType, bool isBackward = true) const;
 	Color f(const vec3& wo, const vec3& wi, const vec3& normal, int matchTypes) const;
 	float pdf(const vec3& wo, const vec3& wi, const vec3& normal, int matchTypes) const;
 };
@@ -27,6 +31,12 @@ namespace RGB {
 	const auto makeBSDF = std::make_shared<BSDF>;
 }
 
+namespace Hero {
+	using BSDF = ::BSDF<Color>;
+	using spBSDF = std::shared_ptr<BSDF>;
+	const auto makeBSDF = std::make_shared<BSDF>;
+}
+
 
 template<class Color>
 BSDF<Color>::BSDF() {
@@ -54,13 +64,14 @@ bool BSDF<Color>::hasType(int type) const {
 	return result;
 }
 template<class Color>
-Color BSDF<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int matchTypes, int& sampledType, bool isBackward) const {
+Color BSDF<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int matchTypes, int& sampledType, bool isBackward) const {
 	int matchingComponents = numComponents(matchTypes);
 	pdf = 0.0f;
 	if (matchingComponents == 0) {
 		return 0.0f;
 	}
-	int choosen = Random::random(matchingComponents - 1);
+	int choosen = std::min(int(u.x * matchingComponents), matchingComponents - 1);
+	vec2 uRemapped(std::min(u.x * matchingComponents - choosen, 1.0f - std::numeric_limits<float>::epsilon()), u.y);
 	BxDF<Color>* bxdf = nullptr;
 	for (int i = 0; i < bxdfs.size(); ++i) {
 		if (bxdfs[i]->hasType(matchTypes) && choosen-- == 0) {
@@ -68,7 +79,7 @@ Color BSDF<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, float&
 			break;
 		}
 	}
-	Color f = bxdf->sampleF(wo, wi, normal, pdf, sampledType, isBackward);
+	Color f = bxdf->sampleF(wo, wi, normal, uRemapped, pdf, sampledType, isBackward);
 	if (pdf == 0.0f)
 		return 0.0f;
 	if (!(bxdf->getType() & BxDF<Color>::Specular) && matchingComponents > 1)
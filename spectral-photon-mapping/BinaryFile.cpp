@@ -0,0 +1,67 @@
+#include "BinaryFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <windows.h>
+#undef min
+#undef max
+
+
+BinaryWriter::BinaryWriter(const std::string& filename)
+	: filename(filename), tempFilename(filename + ".tmp"),
+	file(tempFilename, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc)
+{}
+
+BinaryWriter::~BinaryWriter() {
+	if (committed)
+		return;
+	if (file.is_open())
+		file.close();
+	std::remove(tempFilename.c_str());
+}
+
+void BinaryWriter::write(const void* data, size_t size) {
+	file.write(static_cast<const char*>(data), size);
+}
+
+void BinaryWriter::writeString(const std::string& value) {
+	write(uint64_t(value.size()));
+	write(value.data(), value.size());
+}
+
+bool BinaryWriter::commit() {
+	if (!file.is_open())
+		return false;
+	file.close();
+	if (file.fail())
+		return false;
+	if (!MoveFileExA(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		return false;
+	committed = true;
+	return true;
+}
+
+BinaryReader::BinaryReader(const std::string& filename) : file(filename)
+{}
+
+void BinaryReader::read(void* data, size_t size) {
+	if (size > file.size() - offset)
+		throw std::runtime_error("Unexpected end of binary file");
+	if (size != 0)
+		memcpy(data, file.data() + offset, size);
+	offset += size;
+}
+
+std::string BinaryReader::readString() {
+	uint64_t size = read<uint64_t>();
+	if (size > file.size() - offset)
+		throw std::runtime_error("Unexpected end of binary file");
+	std::string value(file.data() + offset, size_t(size));
+	offset += size_t(size);
+	return value;
+}
+
+bool BinaryReader::atEnd() const {
+	return offset == file.size();
+}
\ No newline at end of file
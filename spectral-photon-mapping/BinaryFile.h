@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.h"
+
+
+// Sequential binary output into temporary file, commit renames it over target,
+// so readers never see partially written file
+class BinaryWriter {
+	std::string filename;
+	std::string tempFilename;
+	std::ofstream file;
+	bool committed = false;
+public:
+	BinaryWriter(const std::string& filename);
+	// removes temporary file unless it was committed
+	~BinaryWriter();
+	BinaryWriter(const BinaryWriter&) = delete;
+	BinaryWriter& operator=(const BinaryWriter&) = delete;
+	void write(const void* data, size_t size);
+	template<class T>
+	void write(const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are written as bytes");
+		write(&value, sizeof(T));
+	}
+	// element count followed by elements
+	template<class T>
+	void writeVector(const std::vector<T>& values) {
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are written as bytes");
+		write(uint64_t(values.size()));
+		write(values.data(), values.size() * sizeof(T));
+	}
+	void writeString(const std::string& value);
+	// returns false if anything failed to be written, target is then left untouched
+	bool commit();
+};
+
+// Reads values written by BinaryWriter from mapped file, throws if file ends before value
+class BinaryReader {
+	MappedFile file;
+	size_t offset = 0;
+public:
+	BinaryReader(const std::string& filename);
+	void read(void* data, size_t size);
+	template<class T>
+	T read() {
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are read as bytes");
+		T value;
+		read(&value, sizeof(T));
+		return value;
+	}
+	template<class T>
+	std::vector<T> readVector() {
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are read as bytes");
+		uint64_t count = read<uint64_t>();
+		if (count > (file.size() - offset) / sizeof(T))
+			throw std::runtime_error("Unexpected end of binary file");
+		std::vector<T> values(static_cast<size_t>(count));
+		read(values.data(), values.size() * sizeof(T));
+		return values;
+	}
+	std::string readString();
+	bool atEnd() const;
+};
\ No newline at end of file
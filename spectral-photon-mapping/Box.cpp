@@ -64,8 +64,10 @@ std::vector<Interval> Box::intersectionList(const Ray& ray) const {
 		return {};
 	return { Interval{tNear, getNormal(ray.ro + ray.rd * tNear), tFar, getNormal(ray.ro + ray.rd * tFar)} };
 }
-HitInfo Box::sample() const {
-	int index = surfAreaDist.sampleDiscrete(Random::random());
+HitInfo Box::sample(const vec2& u) const {
+	float pdf;
+	vec2 r = u;
+	int index = surfAreaDist.sampleDiscrete(u.x, pdf, r.x);
 	static const vec3 normal[6] = {
 		vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0),
 		vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
@@ -84,8 +86,8 @@ HitInfo Box::sample() const {
 	HitInfo result;
 	result.normal = normal[index];
 	result.localPosition = center + (normal[index] * 0.5f +
-		tangentX[index / 2] * (Random::random() - 0.5f) +
-		tangentY[index / 2] * (Random::random() - 0.5f)) * size;
+		tangentX[index / 2] * (r.x - 0.5f) +
+		tangentY[index / 2] * (r.y - 0.5f)) * size;
 	return result;
 }
 float Box::area() const {
@@ -24,7 +24,8 @@ public:
 	bool hasType(int type) const;
 	bool hasExactType(int type) const;
 	virtual Color f(const vec3& wi, const vec3& wo, const vec3& normal) const = 0;
-	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward = true) const;
+	// u is uniform sample in [0, 1)^2
+	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward = true) const;
 	virtual float pdf(const vec3& wo, const vec3& wi, const vec3& normal) const;
 };
 template<class Color>
@@ -41,7 +42,7 @@ class SpecularReflection : public BxDF<Color> {
 public:
 	SpecularReflection(const Color& R);
 	virtual Color f(const vec3& wi, const vec3& wo, const vec3& normal) const override;
-	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward = true) const override;
+	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward = true) const override;
 	virtual float pdf(const vec3& wo, const vec3& wi, const vec3& normal) const override;
 };
 
@@ -52,7 +53,7 @@ class SpecularTransmission : public BxDF<Color> {
 public:
 	SpecularTransmission(const Color& T);
 	virtual Color f(const vec3& wi, const vec3& wo, const vec3& normal) const override;
-	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward = true) const override;
+	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward = true) const override;
 	virtual float pdf(const vec3& wo, const vec3& wi, const vec3& normal) const override;
 };
 
@@ -64,7 +65,7 @@ class IdealGlass : public BxDF<Color> {
 public:
 	IdealGlass(const Color& R, const Color& T, float refractionIndex);
 	virtual Color f(const vec3& wi, const vec3& wo, const vec3& normal) const override;
-	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward = true) const override;
+	virtual Color sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward = true) const override;
 	virtual float pdf(const vec3& wo, const vec3& wi, const vec3& normal) const override;
 };
 template<class Color>
@@ -89,9 +90,9 @@ float BxDF<Color>::pdf(const vec3& wo, const vec3& wi, const vec3& normal) const
 	return sameHemisphere(wo, wi, normal)? glm::abs(glm::dot(wi, normal)) * glm::one_over_pi<float>() : 0.0f;
 }
 template<class Color>
-Color BxDF<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward) const {
+Color BxDF<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward) const {
 	sampledType = this->type;
-	wi = Sampling::cosWeightedHemisphere(normal);
+	wi = Sampling::cosWeightedHemisphere(normal, u);
 	if (glm::dot(wo, normal) < 0.0f)
 		wi *= -1.0f;
 	pdf = BxDF<Color>::pdf(wo, wi, normal);
@@ -119,7 +120,7 @@ Color SpecularReflection<Color>::f(const vec3& wi, const vec3& wo, const vec3& n
 	return Color(0.0);
 }
 template<class Color>
-Color SpecularReflection<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward) const {
+Color SpecularReflection<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward) const {
 	sampledType = this->type;
 	vec3 tNormal = normal;
 	if (glm::dot(wo, normal) < 0.0f)
@@ -144,7 +145,7 @@ Color SpecularTransmission<Color>::f(const vec3& wi, const vec3& wo, const vec3&
 	return Color(0.0f);
 }
 template<class Color>
-Color SpecularTransmission<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward) const {
+Color SpecularTransmission<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward) const {
 	float cosTheta = glm::dot(wo, normal);
 	sampledType = BxDF<Color>::Specular | BxDF<Color>::Reflection;
 	pdf = 1.0;
@@ -177,7 +178,7 @@ Color IdealGlass<Color>::f(const vec3& wi, const vec3& wo, const vec3& normal) c
 	return Color(0.0);
 }
 template<class Color>
-Color IdealGlass<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, float& pdf, int& sampledType, bool isBackward) const {
+Color IdealGlass<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, const vec2& u, float& pdf, int& sampledType, bool isBackward) const {
 	float cosTheta = glm::dot(wo, normal);
 	vec3 tempNormal = normal;
 	float eta = 1.0f / refractionIndex;
@@ -192,7 +193,7 @@ Color IdealGlass<Color>::sampleF(const vec3& wo, vec3& wi, const vec3& normal, f
 	if (eta * eta * (1.0f - cosTheta * cosTheta) >= 1.0f) {
 		f = 1.0f;
 	}
-	if (Random::random() < f) {
+	if (u.x < f) {
 		sampledType = BxDF<Color>::Specular | BxDF<Color>::Reflection;
 		pdf = f;
 		wi = glm::reflect(-wo, tempNormal);
@@ -235,4 +236,12 @@ namespace RGB {
 	using LambertianReflection = ::LambertianReflection<Color>;
 	using SpecularReflection = ::SpecularReflection<Color>;
 	using IdealGlass = ::IdealGlass<Color>;
+}
+
+namespace Hero {
+	using BxDF = ::BxDF<Color>;
+	using spBxDF = std::shared_ptr<BxDF>;
+	using LambertianReflection = ::LambertianReflection<Color>;
+	using SpecularReflection = ::SpecularReflection<Color>;
+	using IdealGlass = ::IdealGlass<Color>;
 }
\ No newline at end of file
@@ -15,7 +15,11 @@ public:
 	Camera(const Affine& cameraToWorld, float aspectRatio)
 		:cameraToWorld(cameraToWorld), aspectRatio(aspectRatio)
 	{}
-	virtual Ray generateRay(const vec2& ndc) const = 0;
+	// uLens is uniform sample in [0, 1)^2 for point on aperture
+	virtual Ray generateRay(const vec2& ndc, const vec2& uLens) const = 0;
+	Ray generateRay(const vec2& ndc) const {
+		return generateRay(ndc, vec2(Random::random(), Random::random()));
+	}
 	virtual Ray sampleRay(const vec2& ndc) const {
 		throw std::runtime_error("Not implemented");
 	}
@@ -29,12 +33,12 @@ class Pinhole: public Camera {
 public:
 	Pinhole(float fov, float focus, float aperture, const Affine& cameraToWorld, float aspectRatio)
 		:Camera(cameraToWorld, aspectRatio), fov(fov), focus(focus), aperture(aperture) {}
-	Ray generateRay(const vec2& ndc) const override {
+	Ray generateRay(const vec2& ndc, const vec2& uLens) const override {
 		Ray ray;
 		ray.ro = vec3(0.0);
 		ray.rd = glm::normalize(forward + glm::tan(fov) * (right * ndc.x / aspectRatio + up * ndc.y));
 	    vec3 fp = ray.ro + ray.rd * focus;
-		vec2 shift = Sampling::uniformDisk(aperture);
+		vec2 shift = Sampling::uniformDisk(aperture, uLens);
 		ray.ro = ray.ro + right * shift.x +  up * shift.y;
 		ray.rd = glm::normalize(fp - ray.ro);
 		return cameraToWorld.transform(ray);
@@ -50,12 +54,12 @@ public:
 	OrthoProjectionCamera(float height, float focus, float aperture,
 		const Affine& cameraToWorld, float aspectRatio)
 		:Camera(cameraToWorld, aspectRatio), focus(focus), aperture(aperture), h(height) {}
-	Ray generateRay(const vec2& ndc) const override {
+	Ray generateRay(const vec2& ndc, const vec2& uLens) const override {
 		Ray ray;
 		ray.ro = h * (up * ndc.y + right * ndc.x / aspectRatio);
 		ray.rd = forward;
 		vec3 fp = ray.ro + ray.rd * focus;
-		vec2 shift = Sampling::uniformDisk(aperture);
+		vec2 shift = Sampling::uniformDisk(aperture, uLens);
 		ray.ro = ray.ro + right * shift.x + up * shift.y;
 		ray.rd = glm::normalize(fp - ray.ro);
 		return cameraToWorld.transform(ray);
@@ -66,7 +70,7 @@ public:
 class CustomFisheye : public Camera {
 	virtual float radiusToTheta(float r) const = 0;
 public:
-	Ray generateRay(const vec2& ndc) const override {
+	Ray generateRay(const vec2& ndc, const vec2& uLens) const override {
 		Ray ray;
 		float theta = radiusToTheta(glm::length(ndc));
 		float phi = glm::atan(ndc.y, ndc.x / aspectRatio);
@@ -100,7 +104,7 @@ class Fisheye : public Camera {
 				break;
 		}
 	}
-	Ray generateRay(const vec2& ndc) const override {
+	Ray generateRay(const vec2& ndc, const vec2& uLens) const override {
 		float theta = 0.0f;
 		float r = glm::length(ndc);
 		// todo: check correctness of this formulas
@@ -1,4 +1,38 @@
 #include "Color.h"
+#include "Config.h"
+
+namespace {
+	// range of CIE 1931 standard observer, matching functions are zero outside
+	const int CIETableMin = 360;
+	const int CIETableMax = 830;
+	const int CIETableSize = CIETableMax - CIETableMin + 1;
+
+	// 1 nm samples of colour matching functions and their linear RGB, filled from analytical fits once
+	struct CIETable {
+		std::array<vec3, CIETableSize> xyz;
+		std::array<vec3, CIETableSize> rgb;
+		CIETable() {
+			for (int i = 0; i < CIETableSize; ++i) {
+				float wavelength = float(CIETableMin + i);
+				xyz[i] = vec3(xFit_1931(wavelength), yFit_1931(wavelength), zFit_1931(wavelength));
+				rgb[i] = XYZToRGB(xyz[i]);
+			}
+		}
+		static const CIETable& get() {
+			static CIETable table;
+			return table;
+		}
+	};
+
+	vec3 lookup(const std::array<vec3, CIETableSize>& table, float wavelength) {
+		float x = wavelength - CIETableMin;
+		if (!(x >= 0.0f && x < CIETableSize - 1))
+			return vec3(0.0f);
+		int i = int(x);
+		float t = x - i;
+		return table[i] * (1.0f - t) + table[i + 1] * t;
+	}
+}
 
 float integratProduct(const ColorSampler* const a, const ColorSampler* const b, float min, float max, int samples) {
 	assert(samples != 1);
@@ -39,22 +73,74 @@ vec3 XYZToRGB(vec3 xyz) {
 	return glm::transpose(XYZ_to_RGB) * xyz;
 }
 
+vec3 wavelengthToXYZ(float wavelength) {
+	if (Config::get().colorMatching() == ColorMatching::Tabulated)
+		return lookup(CIETable::get().xyz, wavelength);
+	return vec3(xFit_1931(wavelength), yFit_1931(wavelength), zFit_1931(wavelength));
+}
+
 vec3 wavelengthToRGB(float wavelength, float intensity) {
+	// fused table skips XYZ to RGB matrix
+	if (Config::get().colorMatching() == ColorMatching::Tabulated)
+		return intensity * lookup(CIETable::get().rgb, wavelength);
 	return XYZToRGB(intensity * vec3(xFit_1931(wavelength),
 		yFit_1931(wavelength), zFit_1931(wavelength)));
 }
 
+vec3 wavelengthToRGB(const SpectralSample& wavelengths, const SpectralSample& intensity) {
+	vec3 rgb(0.0f);
+	for (int i = 0; i < SpectralSample::Size; ++i) {
+		if (intensity[i] != 0.0f)
+			rgb += wavelengthToRGB(wavelengths[i], intensity[i]);
+	}
+	return rgb / float(SpectralSample::Size);
+}
+
 vec3 spectrumToRGB(const ColorSampler* const sampler, float min, float max, int samples) {
 	assert(samples > 1);
 	vec3 xyz(0.0f);
 	for (int i = 0; i < samples; ++i) {
 		float wavelength = glm::mix(min, max, i / float(samples - 1));
-		xyz += vec3(xFit_1931(wavelength), yFit_1931(wavelength), zFit_1931(wavelength)) * sampler->sample(wavelength);
+		xyz += wavelengthToXYZ(wavelength) * sampler->sample(wavelength);
 	}
 	xyz *= (max - min) / float(samples);
 	return glm::max(XYZToRGB(xyz), 0.0f);
 }
 
+static Distribution1D tabulate(float min, float max, const std::function<float(float)>& function, int bins) {
+	assert(min < max && bins > 0);
+	std::vector<float> values(bins);
+	for (int i = 0; i < bins; ++i)
+		values[i] = std::max(function(glm::mix(min, max, (i + 0.5f) / bins)), 0.0f);
+	return Distribution1D(values.begin(), values.end());
+}
+
+WavelengthDistribution::WavelengthDistribution(float min, float max, const std::function<float(float)>& importance, int bins)
+	: distribution(tabulate(min, max, importance, bins)), min(min), max(max)
+{
+}
+
+float WavelengthDistribution::sample(float value, float& pdf) const {
+	float x = distribution.sampleContinuous(value, pdf);
+	pdf /= max - min;
+	return glm::mix(min, max, x);
+}
+
+float WavelengthDistribution::pdf(float wavelength) const {
+	return distribution.continuousPDF((wavelength - min) / (max - min)) / (max - min);
+}
+
+SpectralSample WavelengthDistribution::sampleHero(float value, SpectralSample& weights) const {
+	SpectralSample wavelengths;
+	for (int i = 0; i < SpectralSample::Size; ++i) {
+		float pdf;
+		// hero stands for all lanes after dispersion, so it has to follow whole distribution as well
+		wavelengths[i] = sample(glm::fract(value + float(i) / SpectralSample::Size), pdf);
+		weights[i] = 1.0f / ((max - min) * pdf);
+	}
+	return wavelengths;
+}
+
 float BlackBodySPD::sample(float wavelength) const {
 	return blackBodyRadiance(wavelength, temperature);
 }
@@ -77,7 +163,37 @@ float ColorSampler::integral(float min, float max, int samples) const  {
 	return result * (max - min) / float(samples);
 }
 
-float BlackBodyColorSampler::sample(float wavelength) const {
+SpectralSample ColorSampler::sample(const SpectralSample& wavelengths) const {
+	return SpectralSample(sample(wavelengths[0]), sample(wavelengths[1]), sample(wavelengths[2]), sample(wavelengths[3]));
+}
+
+float ColorSampler::bake(float min, float max, float step) {
+	assert(min < max && step > 0.0f);
+	// error is measured in between grid points, where interpolation is farthest from spectrum
+	const int ErrorSamples = 8;
+	int count = int(std::ceil((max - min) / step)) + 1;
+	std::vector<float> values(count);
+	for (int i = 0; i < count; ++i)
+		values[i] = evaluate(min + i * step);
+	float error = 0.0f;
+	for (int i = 0; i + 1 < count; ++i) {
+		for (int j = 1; j < ErrorSamples; ++j) {
+			float t = j / float(ErrorSamples);
+			float interpolated = values[i] + (values[i + 1] - values[i]) * t;
+			error = std::max(error, std::abs(evaluate(min + (i + t) * step) - interpolated));
+		}
+	}
+	table = std::move(values);
+	tableMin = min;
+	tableInvStep = 1.0f / step;
+	return error;
+}
+
+bool ColorSampler::isBaked() const {
+	return !table.empty();
+}
+
+float BlackBodyColorSampler::evaluate(float wavelength) const {
 	return spd.sample(wavelength) * intensity;
 }
 
@@ -88,7 +204,7 @@ GridFunction1D RGBColorSampler::greenCurve(380.0f, 730.0f,
 GridFunction1D RGBColorSampler::blueCurve(380.0f, 730.0f,
 	{ 0.967865135f, 0.968827912f, 0.967128582f, 0.965460137f, 0.963110055f, 0.962150324f, 0.960391811f, 0.958925903f, 0.953890935f, 0.925442998f, 0.817997886f, 0.42509696f, 0.167036273f, 0.078894327f, 0.043852038f, 0.031560435f, 0.024170984f, 0.020245519f, 0.01830814f, 0.016588218f, 0.01602049f, 0.015554808f, 0.013384959f, 0.012535491f, 0.011199484f, 0.011318274f, 0.011353953f, 0.012285073f, 0.012663188f, 0.012761325f, 0.013067426f, 0.013369566f, 0.013427487f, 0.01363574f, 0.013893597f, 0.014025757f });
 
-float RGBColorSampler::sample(float wavelength) const {
+float RGBColorSampler::evaluate(float wavelength) const {
 	vec3 curve(
 		redCurve.sample(wavelength),
 		greenCurve.sample(wavelength),
@@ -97,6 +213,6 @@ float RGBColorSampler::sample(float wavelength) const {
 	return glm::max(glm::dot(curve, rgb), 0.0f);
 }
 
-float SpectrumSampler::sample(float wavelength) const {
+float SpectrumSampler::evaluate(float wavelength) const {
 	return function->sample(wavelength);
 }
\ No newline at end of file
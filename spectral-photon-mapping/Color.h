@@ -2,9 +2,11 @@
 #include <glm/common.hpp>
 #include <functional>
 #include <array>
+#include <algorithm>
 
 #include "Distribution1D.h"
 #include "Function1D.h"
+#include "SpectralSample.h"
 
 using rgb = glm::vec3;
 
@@ -14,6 +16,10 @@ namespace Spectral {
 namespace RGB {
 	using Color = rgb;
 }
+// hero wavelength with 3 companions
+namespace Hero {
+	using Color = SpectralSample;
+}
 
 
 class ColorSampler;
@@ -49,11 +55,30 @@ T zFit_1931(T wave) {
 		T(0.681) * glm::exp(-T(0.5) * t2 * t2);
 }
 
+// CIE 1931 colour matching functions, tabulated or analytical depending on Config::colorMatching
+vec3 wavelengthToXYZ(float wavelength);
 vec3 wavelengthToRGB(float wavelength, float intensity = 1.0f);
+// average over lanes, every lane is an estimate for whole spectrum
+vec3 wavelengthToRGB(const SpectralSample& wavelengths, const SpectralSample& intensity);
 vec3 spectrumToRGB(const ColorSampler* const sampler, float min, float max, int samples = 60);
 
 static const float D65 = 6504;
 
+// Piecewise constant pdf over [min, max] built from importance function, for choosing wavelengths
+class WavelengthDistribution {
+	Distribution1D distribution;
+	float min;
+	float max;
+public:
+	WavelengthDistribution(float min, float max, const std::function<float(float)>& importance, int bins = 300);
+	// pdf is per nanometer
+	float sample(float value, float& pdf) const;
+	float pdf(float wavelength) const;
+	// hero wavelength takes value, companions are shifted by 1/4 in sample space modulo 1, so every lane
+	// follows whole distribution; weights are Monte Carlo weights relative to uniform sampling
+	SpectralSample sampleHero(float value, SpectralSample& weights) const;
+};
+
 class BlackBodySPD {
 protected:
 	float temperature = 2856; // standart illuminant A
@@ -70,19 +95,44 @@ public:
 };
 
 class ColorSampler {
+	// spectrum resampled on uniform grid, empty until baked
+	std::vector<float> table;
+	float tableMin = 0.0f;
+	float tableInvStep = 0.0f;
 public:
 	float integral(float min, float max, int samples = 60) const;
-	// wavelength in nanometers
-	virtual float sample(float wavelength) const = 0;
+	// exact spectrum, wavelength in nanometers
+	virtual float evaluate(float wavelength) const = 0;
+	// wavelength in nanometers, reads baked table inside its range and falls back to evaluate() outside
+	float sample(float wavelength) const {
+		float x = (wavelength - tableMin) * tableInvStep;
+		int last = int(table.size()) - 1;
+		if (!(x >= 0.0f && x <= float(last)) || last < 1)
+			return evaluate(wavelength);
+		int i = std::min(int(x), last - 1);
+		float t = x - i;
+		return table[i] + (table[i + 1] - table[i]) * t;
+	}
+	SpectralSample sample(const SpectralSample& wavelengths) const;
+	// resamples spectrum on [min, max] with given step, returns max absolute error of interpolation
+	float bake(float min, float max, float step);
+	bool isBaked() const;
+	// false for samplers which are cheaper to evaluate than to interpolate
+	virtual bool isWorthBaking() const {
+		return true;
+	}
 };
 
 class ConstantSampler : public ColorSampler {
 	float value;
 public:
 	ConstantSampler(float value) : value(value) {}
-	virtual float sample(float wavelength) const override {
+	virtual float evaluate(float wavelength) const override {
 		return value;
 	}
+	virtual bool isWorthBaking() const override {
+		return false;
+	}
 };
 
 template<typename Functor>
@@ -93,7 +143,7 @@ public:
 	AnalyticalSampler(const Functor& function):function(function)
 	{
 	}
-	virtual float sample(float wavelength) const override {
+	virtual float evaluate(float wavelength) const override {
 		return function(wavelength);
 	}
 };
@@ -104,7 +154,7 @@ class BlackBodyColorSampler : public ColorSampler {
 public:
 	BlackBodyColorSampler(float temperature, float intensity) :spd(temperature), intensity(intensity){
 	}
-	virtual float sample(float wavelength) const override;
+	virtual float evaluate(float wavelength) const override;
 };
 
 class RGBColorSampler : public ColorSampler {
@@ -116,14 +166,14 @@ class RGBColorSampler : public ColorSampler {
 public:
 	RGBColorSampler(const vec3& rgb) :rgb(rgb) {}
 	vec3 color() const { return rgb; }
-	virtual float sample(float wavelength) const override;
+	virtual float evaluate(float wavelength) const override;
 };
 
 class SpectrumSampler : public ColorSampler {
 	std::shared_ptr<Function1D> function;
 public:
 	SpectrumSampler(const std::shared_ptr<Function1D>& function) : function(function) {}
-	virtual float sample(float wavelength) const override;
+	virtual float evaluate(float wavelength) const override;
 };
 
 
@@ -16,4 +16,10 @@ float Config::spectrumMax() const {
 }
 void Config::spectrumMax(float value) {
 	_spectrumMax = value;
+}
+ColorMatching Config::colorMatching() const {
+	return _colorMatching;
+}
+void Config::colorMatching(ColorMatching value) {
+	_colorMatching = value;
 }
\ No newline at end of file
@@ -1,10 +1,18 @@
 #pragma once
 
 
+// how wavelengths are converted to XYZ/RGB
+enum class ColorMatching {
+	// multi-lobe gaussian fits, slow, kept for validation
+	Analytical,
+	// 1 nm tables with linear interpolation
+	Tabulated
+};
 
 class Config {
 	float _spectrumMin = 400.0f;
 	float _spectrumMax = 700.0f;
+	ColorMatching _colorMatching = ColorMatching::Tabulated;
 private:
 	Config() = default;
 public:
@@ -13,4 +21,6 @@ public:
 	void spectrumMin(float value);
 	float spectrumMax() const;
 	void spectrumMax(float value);
+	ColorMatching colorMatching() const;
+	void colorMatching(ColorMatching value);
 };
\ No newline at end of file
@@ -72,7 +72,7 @@ public:
 	virtual float pdf() const override {
 		throw std::runtime_error("Cannot sample infinite shape");
 	}
-	virtual HitInfo sample() const override {
+	virtual HitInfo sample(const vec2& u) const override {
 		throw std::runtime_error("Cannot sample infinite shape");
 	}
 	virtual float pdf(const vec3& pos, const vec3& wi, const Affine& transform) const override {
@@ -8,10 +8,10 @@ Disc::Disc(float radius) : radius(radius) {
 BBox3D Disc::bbox() const {
 	return BBox3D(vec3(-radius, -radius, 0.0f), vec3(radius, radius, 0.0f));
 }
-HitInfo Disc::sample() const {
+HitInfo Disc::sample(const vec2& u) const {
 	HitInfo result;
 	result.normal = vec3(0.0f, 1.0f, 0.0f);
-	vec2 sample = Sampling::uniformDisk(radius);
+	vec2 sample = Sampling::uniformDisk(radius, u);
 	result.localPosition = vec3(sample.x, 0.0f, sample.y);
 	return result;
 }
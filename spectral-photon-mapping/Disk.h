@@ -8,6 +8,6 @@ protected:
 public:
 	Disc(float radius = 1.0f);
 	virtual BBox3D bbox() const override;
-	virtual HitInfo sample() const override;
+	virtual HitInfo sample(const vec2& u) const override;
 	virtual float area() const override;
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "Distributed.h"
+
+#include <stdexcept>
+
+
+namespace Spectral {
+	namespace SPPM {
+		namespace Distributed {
+			Image<rgb> merge(const std::vector<PartialImage>& images) {
+				if (images.empty())
+					throw std::runtime_error("Nothing to merge");
+				const int width = images[0].width;
+				const int height = images[0].height;
+				for (const auto& image : images)
+					if (image.width != width || image.height != height)
+						throw std::runtime_error("Merged images differ in size");
+				Image<rgb> result(width, height, rgb(0.0f));
+				for (int j = 0; j < height; j++) {
+					for (int i = 0; i < width; i++) {
+						int index = i + j * width;
+						rgb sum(0.0f);
+						rgb plainSum(0.0f);
+						float weight = 0.0f;
+						for (const auto& image : images) {
+							sum += image.weights[index] * image.radiance[index];
+							plainSum += image.radiance[index];
+							weight += image.weights[index];
+						}
+						result(i, j) = weight > 0.0f ? sum / weight : plainSum / float(images.size());
+					}
+				}
+				return result;
+			}
+
+			void sendImage(Socket& socket, const PartialImage& image) {
+				socket.send(image.width);
+				socket.send(image.height);
+				socket.send(image.radiance.data(), image.radiance.size() * sizeof(rgb));
+				socket.send(image.weights.data(), image.weights.size() * sizeof(float));
+			}
+
+			PartialImage receiveImage(Socket& socket) {
+				PartialImage image;
+				image.width = socket.receive<int32_t>();
+				image.height = socket.receive<int32_t>();
+				// guards against allocating whatever garbage header asks for
+				const int32_t MaxSize = 1 << 16;
+				if (image.width <= 0 || image.height <= 0 || image.width > MaxSize || image.height > MaxSize)
+					throw std::runtime_error("Invalid size of received image");
+				size_t pixels = size_t(image.width) * size_t(image.height);
+				image.radiance.resize(pixels);
+				image.weights.resize(pixels);
+				socket.receive(image.radiance.data(), pixels * sizeof(rgb));
+				socket.receive(image.weights.data(), pixels * sizeof(float));
+				return image;
+			}
+
+			std::string streamFilename(const std::string& filename, int streamIndex) {
+				size_t dot = filename.find_last_of('.');
+				size_t separator = filename.find_last_of("/\\");
+				std::string suffix = "." + std::to_string(streamIndex);
+				if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+					return filename + suffix;
+				return filename.substr(0, dot) + suffix + filename.substr(dot);
+			}
+
+			namespace {
+				// checked before port is bound
+				int checkedWorkers(int workers) {
+					if (workers < 1)
+						throw std::runtime_error("Coordinator needs at least one worker");
+					return workers;
+				}
+			}
+
+			Coordinator::Coordinator(uint16_t port, int workers)
+				: listening(Socket::listen(port, checkedWorkers(workers))), workers(workers)
+			{}
+
+			Image<rgb> Coordinator::run(const std::unique_ptr<Progress>& progress) {
+				std::vector<Socket> connections;
+				for (int i = 0; i < workers; ++i) {
+					connections.push_back(listening.accept());
+					connections.back().send(Assignment{ i, workers });
+				}
+				// workers render at the same time, so waiting for them in order costs nothing
+				std::vector<PartialImage> images;
+				for (auto& connection : connections) {
+					images.push_back(receiveImage(connection));
+					progress->emitProgress(float(images.size()) / workers);
+				}
+				return merge(images);
+			}
+		}
+	}
+}
\ No newline at end of file
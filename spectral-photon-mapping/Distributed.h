@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SPPM.h"
+#include "Socket.h"
+
+
+namespace Spectral {
+	namespace SPPM {
+		// Rendering by several processes, coordinator gives each worker its own sample stream and merges their images
+		// Every worker shrinks radii of its own, so photon statistics of different workers cannot be added up,
+		// their final estimates are averaged instead, weighted by photons behind each pixel
+		// Progressive Photon Mapping: A Probabilistic Approach, Knaus and Zwicker 2011
+		namespace Distributed {
+			struct Assignment {
+				int32_t streamIndex;
+				int32_t streamCount;
+			};
+			// estimate of one worker and number of photons behind each pixel
+			struct PartialImage {
+				int32_t width;
+				int32_t height;
+				std::vector<rgb> radiance;
+				std::vector<float> weights;
+			};
+			// pixels without weight in all images get plain mean
+			Image<rgb> merge(const std::vector<PartialImage>& images);
+			void sendImage(Socket& socket, const PartialImage& image);
+			PartialImage receiveImage(Socket& socket);
+
+			// listens from construction, so workers may be started right after it
+			class Coordinator {
+				Socket listening;
+				int workers;
+			public:
+				Coordinator(uint16_t port, int workers);
+				// waits for all workers, then for their images
+				Image<rgb> run(const std::unique_ptr<Progress>& progress);
+			};
+
+			// filename with stream index inserted before extension, so image viewers still recognize it
+			std::string streamFilename(const std::string& filename, int streamIndex);
+
+			// connects to coordinator, renders assigned stream with render(tracer) and sends image back
+			// workers on one host write checkpoints and snapshots to files suffixed by stream index
+			template<class RayTraceAccel, class Render>
+			void work(const std::string& host, uint16_t port, Tracer<RayTraceAccel>& tracer, Settings settings, const Render& render) {
+				Socket socket = Socket::connect(host, port);
+				Assignment assignment = socket.receive<Assignment>();
+				settings.streamIndex = assignment.streamIndex;
+				settings.streamCount = assignment.streamCount;
+				if (!settings.checkpointFilename.empty())
+					settings.checkpointFilename += "." + std::to_string(assignment.streamIndex);
+				if (!settings.snapshotFilename.empty())
+					settings.snapshotFilename = streamFilename(settings.snapshotFilename, assignment.streamIndex);
+				tracer.setSettings(settings);
+				Image<rgb> image = render(tracer);
+				const Image<float>& iterations = tracer.iterationCounts();
+				PartialImage result;
+				result.width = image.width();
+				result.height = image.height();
+				for (int j = 0; j < image.height(); j++) {
+					for (int i = 0; i < image.width(); i++) {
+						result.radiance.push_back(image(i, j));
+						result.weights.push_back(iterations(i, j) * settings.photonsPerIteration);
+					}
+				}
+				sendImage(socket, result);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "Distribution1D.h"
 
+#include <algorithm>
+#include <limits>
+
 
 Distribution1D::Distribution1D(std::initializer_list<float> initializer) {
 	integral = 0.0f;
@@ -8,25 +11,51 @@ Distribution1D::Distribution1D(std::initializer_list<float> initializer) {
 		values.push_back(value);
 		cdf.push_back(integral = integral + value);
 	}
-	cdf.back() = 1.0f;
 	for (auto& value : cdf)
 		value /= integral;
+	cdf.back() = 1.0f;
+	buildAliasTable();
 }
-float Distribution1D::sampleContinuous(float value, float& pdf) const {
-	//todo: rewrite
-	int l = 0;
-	int r = values.size() - 1;
-	while (l != r) {
-		int i = (r + l) / 2;
-		if (cdf[i + 1] > value)
-			r = i;
+void Distribution1D::buildAliasTable() {
+	int n = values.size();
+	aliasProbability.assign(n, 1.0f);
+	alias.resize(n);
+	std::vector<float> scaled(n);
+	std::vector<int> small;
+	std::vector<int> large;
+	for (int i = 0; i < n; ++i) {
+		alias[i] = i;
+		scaled[i] = values[i] * n / integral;
+		if (scaled[i] < 1.0f)
+			small.push_back(i);
 		else
-			l = i + 1;
+			large.push_back(i);
 	}
-	float delta = value - cdf[l - 1];
-	delta = delta / (cdf[l] - cdf[l - 1]);
-	pdf = values[l] / integral;
-	return (l + delta) / values.size();
+	while (!small.empty() && !large.empty()) {
+		int s = small.back();
+		small.pop_back();
+		int l = large.back();
+		aliasProbability[s] = scaled[s];
+		alias[s] = l;
+		scaled[l] -= 1.0f - scaled[s];
+		if (scaled[l] < 1.0f) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// bins left in either list are full up to rounding errors and keep probability 1
+}
+float Distribution1D::sampleContinuous(float value, float& pdf) const {
+	int l = sampleDiscrete(value);
+	float delta = value - cdf[l];
+	if (cdf[l + 1] > cdf[l])
+		delta /= cdf[l + 1] - cdf[l];
+	pdf = values[l] * values.size() / integral;
+	return std::min((l + delta) / values.size(), 1.0f - std::numeric_limits<float>::epsilon());
+}
+float Distribution1D::continuousPDF(float x) const {
+	int i = glm::clamp(int(x * values.size()), 0, int(values.size()) - 1);
+	return values[i] * values.size() / integral;
 }
 int Distribution1D::sampleDiscrete(float value, float& pdf) const {
 	int l = 0;
@@ -41,6 +70,12 @@ int Distribution1D::sampleDiscrete(float value, float& pdf) const {
 	pdf = discretePDF(l);
 	return l;
 }
+int Distribution1D::sampleDiscrete(float value, float& pdf, float& remapped) const {
+	int l = sampleDiscrete(value, pdf);
+	remapped = cdf[l + 1] > cdf[l] ? (value - cdf[l]) / (cdf[l + 1] - cdf[l]) : 0.0f;
+	remapped = glm::clamp(remapped, 0.0f, 1.0f - std::numeric_limits<float>::epsilon());
+	return l;
+}
 int Distribution1D::sampleDiscrete(float value) const {
 	int l = 0;
 	int r = values.size() - 1;
@@ -53,10 +88,33 @@ int Distribution1D::sampleDiscrete(float value) const {
 	}
 	return l;
 }
+int Distribution1D::sampleAlias(float value, float& pdf) const {
+	float remapped;
+	return sampleAlias(value, pdf, remapped);
+}
+int Distribution1D::sampleAlias(float value, float& pdf, float& remapped) const {
+	int n = values.size();
+	float scaled = value * n;
+	int bin = std::min(int(scaled), n - 1);
+	float fraction = scaled - bin;
+	int result = bin;
+	if (fraction < aliasProbability[bin])
+		remapped = fraction / aliasProbability[bin];
+	else {
+		result = alias[bin];
+		remapped = (fraction - aliasProbability[bin]) / (1.0f - aliasProbability[bin]);
+	}
+	remapped = std::min(remapped, 1.0f - std::numeric_limits<float>::epsilon());
+	pdf = discretePDF(result);
+	return result;
+}
 float Distribution1D::discretePDF(int index) const {
-	return values[index] / (integral * values.size());
+	return values[index] / integral;
 }
 int Distribution1D::sampleDiscrete() const {
 	float value = Random::random();
 	return sampleDiscrete(value);
+}
+int Distribution1D::size() const {
+	return values.size();
 }
\ No newline at end of file
@@ -10,16 +10,28 @@ class Distribution1D {
 	std::vector<float> cdf;
 	std::vector<float> values;
 	float integral;
+	// Walker/Vose alias table, bin i keeps itself with aliasProbability[i], otherwise alias[i]
+	std::vector<float> aliasProbability;
+	std::vector<int> alias;
+	void buildAliasTable();
 public:
 	template<class Iterator>
 	Distribution1D(const Iterator& begin, const Iterator& end, float(*get)(const Iterator&));
 	template<class Iterator>
 	Distribution1D(const Iterator& begin, const Iterator& end);
 	Distribution1D(std::initializer_list<float> initializer);
+	// returns point in [0, 1), pdf is density over [0, 1]
 	float sampleContinuous(float value, float& pdf) const;
+	float continuousPDF(float x) const;
 	int sampleDiscrete(float value, float& pdf) const;
+	// remapped is value rescaled within chosen bin, it can be reused as a new uniform sample
+	int sampleDiscrete(float value, float& pdf, float& remapped) const;
 	int sampleDiscrete(float value) const;
+	// O(1) sampling, unlike sampleDiscrete it does not preserve order of values
+	int sampleAlias(float value, float& pdf) const;
+	int sampleAlias(float value, float& pdf, float& remapped) const;
 	float discretePDF(int index) const;
+	int size() const;
 	int sampleDiscrete() const;
 };
 
@@ -31,9 +43,10 @@ Distribution1D::Distribution1D(const Iterator& begin, const Iterator& end, float
 		values.push_back(get(it));
 		cdf.push_back(integral = integral + get(it));
 	}
-	cdf.back() = 1.0f;
 	for (auto& value : cdf)
 		value /= integral;
+	cdf.back() = 1.0f;
+	buildAliasTable();
 }
 
 template<class Iterator>
@@ -44,7 +57,8 @@ Distribution1D::Distribution1D(const Iterator& begin, const Iterator& end) {
 		values.push_back(*it);
 		cdf.push_back(integral = integral + *it);
 	}
-	cdf.back() = 1.0f;
 	for (auto& value : cdf)
 		value /= integral;
+	cdf.back() = 1.0f;
+	buildAliasTable();
 }
\ No newline at end of file
@@ -6,4 +6,10 @@ float HitInfo::lightEmitted(const vec3& wo, float wavelength) const  {
 	if (light)
 		return light->lightEmitted(wo, normal, wavelength);
 	return 0.0f;
+}
+
+SpectralSample HitInfo::lightEmitted(const vec3& wo, const SpectralSample& wavelengths) const {
+	if (light)
+		return light->lightEmitted(wo, normal, wavelengths);
+	return 0.0f;
 }
\ No newline at end of file
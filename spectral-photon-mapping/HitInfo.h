@@ -1,5 +1,6 @@
 #pragma once
 #include "common.h"
+#include "SpectralSample.h"
 
 class Primitive;
 class Light;
@@ -14,4 +15,5 @@ struct HitInfo {
 	const Primitive* primitive = nullptr;
 	const Light* light = nullptr;
 	float lightEmitted(const vec3& wo, float wavelength) const;
+	SpectralSample lightEmitted(const vec3& wo, const SpectralSample& wavelengths) const;
 };
\ No newline at end of file
@@ -10,6 +10,8 @@ public:
 	Image(int width, int height, const PixelType& defaultValue);
 	PixelType& operator()(int i, int j);
 	const PixelType& operator()(int i, int j) const;
+	// pixel i, j is at i + j * width
+	const PixelType* pixels() const;
 	void multiply(float scalar);
 	int width() const;
 	int height() const;
@@ -29,6 +31,10 @@ const PixelType& Image<PixelType>::operator()(int i, int j) const {
 	return data[i + j * _width];
 }
 template<class PixelType>
+const PixelType* Image<PixelType>::pixels() const {
+	return data.get();
+}
+template<class PixelType>
 void Image<PixelType>::multiply(float scalar) {
 	for (int i = 0; i < _width * _height; i++)
 		data[i] *= scalar;
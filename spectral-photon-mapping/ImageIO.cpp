@@ -0,0 +1,191 @@
+#include "ImageIO.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "BinaryFile.h"
+
+
+namespace ImageIO {
+	namespace {
+		// size of strip encoded at once, smaller files are written with single call
+		const size_t StripSize = 1 << 24;
+
+		int rowsPerStrip(size_t rowSize) {
+			return int(std::max<size_t>(StripSize / std::max<size_t>(rowSize, 1), 1));
+		}
+
+		// encodes rows [begin, end) with encodeRow(row, destination) and writes them strip by strip
+		template<class EncodeRow>
+		void writeRows(BinaryWriter& writer, size_t rowSize, int begin, int end, const EncodeRow& encodeRow) {
+			std::vector<char> strip;
+			int stripRows = rowsPerStrip(rowSize);
+			for (int first = begin; first < end; first += stripRows) {
+				int last = std::min(first + stripRows, end);
+				strip.resize(rowSize * (last - first));
+				for (int row = first; row < last; ++row)
+					encodeRow(row, strip.data() + rowSize * (row - first));
+				writer.write(strip.data(), strip.size());
+			}
+		}
+
+		template<class T>
+		void append(std::vector<char>& buffer, const T& value) {
+			const char* bytes = reinterpret_cast<const char*>(&value);
+			buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+		}
+		void appendString(std::vector<char>& buffer, const std::string& value) {
+			buffer.insert(buffer.end(), value.begin(), value.end());
+			buffer.push_back('\0');
+		}
+		void appendAttribute(std::vector<char>& buffer, const std::string& name, const std::string& type, const std::vector<char>& value) {
+			appendString(buffer, name);
+			appendString(buffer, type);
+			append(buffer, int32_t(value.size()));
+			buffer.insert(buffer.end(), value.begin(), value.end());
+		}
+		std::vector<char> box(int32_t xMin, int32_t yMin, int32_t xMax, int32_t yMax) {
+			std::vector<char> value;
+			append(value, xMin);
+			append(value, yMin);
+			append(value, xMax);
+			append(value, yMax);
+			return value;
+		}
+	}
+
+	std::vector<Channel> rgbChannels(const Image<rgb>& image, const std::string& prefix) {
+		const float* values = &image.pixels()[0].r;
+		return {
+			Channel{ prefix + "R", values, 3 },
+			Channel{ prefix + "G", values + 1, 3 },
+			Channel{ prefix + "B", values + 2, 3 }
+		};
+	}
+
+	Channel floatChannel(const Image<float>& image, const std::string& name) {
+		return Channel{ name, image.pixels(), 1 };
+	}
+
+	uint16_t toHalf(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+		uint32_t magnitude = bits & 0x7fffffff;
+		// NaN stays NaN, infinity stays infinity
+		if (magnitude >= 0x7f800000)
+			return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+		// rounds to infinity above largest half
+		if (magnitude >= 0x477ff000)
+			return sign | 0x7c00;
+		// subnormal half or zero
+		if (magnitude < 0x38800000) {
+			if (magnitude < 0x33000000)
+				return sign;
+			uint32_t exponent = magnitude >> 23;
+			uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+			uint32_t shift = 126 - exponent;
+			uint32_t result = mantissa >> shift;
+			// round to nearest even
+			uint32_t remainder = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (result & 1)))
+				result++;
+			return sign | uint16_t(result);
+		}
+		// normal half, exponent is rebiased and mantissa rounded to nearest even
+		uint32_t result = (magnitude - 0x38000000) >> 13;
+		uint32_t remainder = magnitude & 0x1fff;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+			result++;
+		return sign | uint16_t(result);
+	}
+
+	bool writePPM(const std::string& filename, const Image<rgb>& image) {
+		BinaryWriter writer(filename);
+		std::string header = "P6\n" + std::to_string(image.width()) + " " + std::to_string(image.height()) + "\n255\n";
+		writer.write(header.data(), header.size());
+		// PPM starts with top row
+		writeRows(writer, 3 * size_t(image.width()), 0, image.height(), [&](int row, char* destination) {
+			const rgb* pixels = image.pixels() + size_t(image.height() - row - 1) * image.width();
+			for (int i = 0; i < image.width(); i++) {
+				vec3 color = glm::pow(glm::max(pixels[i], vec3(0.0f)), vec3(1.0f / 2.2f));
+				for (int c = 0; c < 3; c++)
+					destination[3 * i + c] = char(glm::clamp<int>(int(255.0f * color[c] + 0.5f), 0, 255));
+			}
+		});
+		return writer.commit();
+	}
+
+	bool writePFM(const std::string& filename, const Image<rgb>& image) {
+		BinaryWriter writer(filename);
+		// negative scale marks little endian floats
+		std::string header = "PF\n" + std::to_string(image.width()) + " " + std::to_string(image.height()) + "\n-1.0\n";
+		writer.write(header.data(), header.size());
+		// PFM starts with bottom row, so rows are written as they are
+		size_t rowSize = 3 * sizeof(float) * size_t(image.width());
+		writeRows(writer, rowSize, 0, image.height(), [&](int row, char* destination) {
+			memcpy(destination, image.pixels() + size_t(row) * image.width(), rowSize);
+		});
+		return writer.commit();
+	}
+
+	bool writeEXR(const std::string& filename, int width, int height, std::vector<Channel> channels) {
+		std::sort(channels.begin(), channels.end(), [](const Channel& a, const Channel& b) { return a.name < b.name; });
+		std::vector<char> header;
+		append(header, int32_t(20000630));
+		// version 2, single part scanline file
+		append(header, int32_t(2));
+		std::vector<char> channelList;
+		for (const auto& channel : channels) {
+			appendString(channelList, channel.name);
+			// half, not perceptually linear, reserved bytes, x and y sampling
+			append(channelList, int32_t(1));
+			append(channelList, int32_t(0));
+			append(channelList, int32_t(1));
+			append(channelList, int32_t(1));
+		}
+		channelList.push_back('\0');
+		appendAttribute(header, "channels", "chlist", channelList);
+		appendAttribute(header, "compression", "compression", std::vector<char>(1, 0));
+		appendAttribute(header, "dataWindow", "box2i", box(0, 0, width - 1, height - 1));
+		appendAttribute(header, "displayWindow", "box2i", box(0, 0, width - 1, height - 1));
+		appendAttribute(header, "lineOrder", "lineOrder", std::vector<char>(1, 0));
+		std::vector<char> value;
+		append(value, 1.0f);
+		appendAttribute(header, "pixelAspectRatio", "float", value);
+		value.clear();
+		append(value, 0.0f);
+		append(value, 0.0f);
+		appendAttribute(header, "screenWindowCenter", "v2f", value);
+		value.clear();
+		append(value, 1.0f);
+		appendAttribute(header, "screenWindowWidth", "float", value);
+		header.push_back('\0');
+		// uncompressed chunk is one scanline with its y and size, so offsets are known in advance
+		size_t pixelDataSize = channels.size() * sizeof(uint16_t) * size_t(width);
+		size_t chunkSize = 2 * sizeof(int32_t) + pixelDataSize;
+		uint64_t offset = header.size() + sizeof(uint64_t) * size_t(height);
+		for (int y = 0; y < height; y++)
+			append(header, uint64_t(offset + chunkSize * y));
+		BinaryWriter writer(filename);
+		writer.write(header.data(), header.size());
+		// EXR starts with top row, channels of scanline follow each other
+		writeRows(writer, chunkSize, 0, height, [&](int y, char* destination) {
+			int32_t chunkHeader[2] = { y, int32_t(pixelDataSize) };
+			memcpy(destination, chunkHeader, sizeof(chunkHeader));
+			uint16_t* halves = reinterpret_cast<uint16_t*>(destination + sizeof(chunkHeader));
+			size_t row = size_t(height - y - 1) * width;
+			for (const auto& channel : channels) {
+				const float* values = channel.values + row * channel.stride;
+				for (int i = 0; i < width; i++)
+					*halves++ = toHalf(values[i * channel.stride]);
+			}
+		});
+		return writer.commit();
+	}
+
+	bool writeEXR(const std::string& filename, const Image<rgb>& image) {
+		return writeEXR(filename, image.width(), image.height(), rgbChannels(image));
+	}
+}
\ No newline at end of file
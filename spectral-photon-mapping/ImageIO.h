@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Color.h"
+#include "Image.h"
+
+
+// Binary image files
+// Files of usual size are encoded into one buffer and written with single call, bigger ones are
+// encoded and written in strips of rows, so memory does not grow with frame size
+// Files are written through BinaryWriter, so they are replaced atomically
+// Row 0 of image is bottom one, as in renders of tracers
+namespace ImageIO {
+	// one float of each pixel, components of rgb image are channels with stride 3
+	struct Channel {
+		std::string name;
+		const float* values;
+		int stride;
+	};
+	std::vector<Channel> rgbChannels(const Image<rgb>& image, const std::string& prefix = "");
+	Channel floatChannel(const Image<float>& image, const std::string& name);
+	uint16_t toHalf(float value);
+
+	// 8 bit binary PPM with gamma 2.2, values are clamped
+	bool writePPM(const std::string& filename, const Image<rgb>& image);
+	// linear 32 bit float color
+	bool writePFM(const std::string& filename, const Image<rgb>& image);
+	// scanline OpenEXR with uncompressed half float channels, channels are sorted by name as format requires
+	bool writeEXR(const std::string& filename, int width, int height, std::vector<Channel> channels);
+	bool writeEXR(const std::string& filename, const Image<rgb>& image);
+}
\ No newline at end of file
@@ -8,4 +8,9 @@ public:
 	virtual bool intersect(const Ray& ray) const = 0;
 	virtual bool intersect(Ray& ray, HitInfo& hitInfo) const = 0;
 	virtual BBox3D bbox() const = 0;
+	// bounds of part of object inside box, used by spatial split builders
+	// conservative by default, objects with known geometry can clip exactly
+	virtual BBox3D clippedBBox(const BBox3D& box) const {
+		return intersectionOp(bbox(), box);
+	}
 };
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "Disk.h"
 #include "Config.h"
 #include "Rect.h"
+#include "LightBounds.h"
 #include <memory>
 
 class Light;
@@ -20,10 +21,16 @@ public:
 	virtual void preprocess() {};
 	Light(const Affine& lightToWorld)
 		:lightToWorld(lightToWorld) {}
-	virtual float sampleLe(Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const = 0;
-	virtual float sampleLi(const HitInfo& hitInfo, float wavelength, vec3& worldPosition, float& pdf) const = 0;
+	// uPos and uDir are uniform samples in [0, 1)^2 for position and direction
+	virtual float sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const = 0;
+	virtual float sampleLi(const HitInfo& hitInfo, const vec2& u, float wavelength, vec3& worldPosition, float& pdf) const = 0;
+	// same as above, but for hero wavelength and its companions
+	virtual SpectralSample sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, const SpectralSample& wavelengths) const = 0;
+	virtual SpectralSample sampleLi(const HitInfo& hitInfo, const vec2& u, const SpectralSample& wavelengths, vec3& worldPosition, float& pdf) const = 0;
 	virtual float power(float wavelength) const = 0;
 	virtual float power() const = 0;
+	// position, power and orientation bounds for light hierarchy
+	virtual LightBounds bounds() const = 0;
 	// aka "is intersectable"
 	virtual bool hasZeroArea() const = 0;
 	virtual bool intersect(const Ray& ray) const = 0;
@@ -33,11 +40,20 @@ public:
 	virtual float lightEmitted(const Ray& ray, float wavelength) const {
 		return 0.0f;
 	}
+	virtual SpectralSample lightEmitted(const Ray& ray, const SpectralSample& wavelengths) const {
+		return 0.0f;
+	}
 	// for area lights
 	virtual float lightEmitted(const vec3& wo, const vec3& normal, float wavelength) const {
 		return 0.0f;
 	}
+	virtual SpectralSample lightEmitted(const vec3& wo, const vec3& normal, const SpectralSample& wavelengths) const {
+		return 0.0f;
+	}
 	virtual float pdfLi(const HitInfo& hi, const vec3& wi) const = 0;
+	// visits emission spectra, e.g. for baking
+	virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const {
+	}
 };
 
 // DONE
@@ -60,8 +76,16 @@ public:
 	virtual float power() const override {
 		return 4.0f * glm::pi<float>() * totalPower;
 	}
-	virtual float sampleLe(Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const override {
-		vec3 dir = Sampling::uniformSphere();
+	virtual LightBounds bounds() const override {
+		return LightBounds(BBox3D(worldCenter, worldCenter), power(), vec3(0.0f, 0.0f, 1.0f), -1.0f, 0.0f);
+	}
+	virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const override {
+		visitor(intensity);
+	}
+	// Wavelength is either float or SpectralSample, emitted light has the same type
+	template<class Wavelength>
+	Wavelength sampleLeSpectral(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, const Wavelength& wavelength) const {
+		vec3 dir = Sampling::uniformSphere(uDir);
 		ray.ro = worldCenter;
 		ray.rd = dir;
 		lightNormal = dir;
@@ -69,12 +93,25 @@ public:
 		pdfDir = Sampling::uniformSpherePdf();
 		return intensity->sample(wavelength);
 	}
-	virtual float sampleLi(const HitInfo& hitInfo, float wavelength, vec3& worldPosition, float& pdf) const override{
+	template<class Wavelength>
+	Wavelength sampleLiSpectral(const HitInfo& hitInfo, const vec2& u, const Wavelength& wavelength, vec3& worldPosition, float& pdf) const {
 		float dist = glm::l2Norm(hitInfo.globalPosition - worldCenter);
 		worldPosition = worldCenter;
 		pdf = 1.0f;
 		return intensity->sample(wavelength) / (dist * dist);
 	}
+	virtual float sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const override {
+		return sampleLeSpectral(uPos, uDir, ray, lightNormal, pdfPos, pdfDir, wavelength);
+	}
+	virtual SpectralSample sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, const SpectralSample& wavelengths) const override {
+		return sampleLeSpectral(uPos, uDir, ray, lightNormal, pdfPos, pdfDir, wavelengths);
+	}
+	virtual float sampleLi(const HitInfo& hitInfo, const vec2& u, float wavelength, vec3& worldPosition, float& pdf) const override {
+		return sampleLiSpectral(hitInfo, u, wavelength, worldPosition, pdf);
+	}
+	virtual SpectralSample sampleLi(const HitInfo& hitInfo, const vec2& u, const SpectralSample& wavelengths, vec3& worldPosition, float& pdf) const override {
+		return sampleLiSpectral(hitInfo, u, wavelengths, worldPosition, pdf);
+	}
 	virtual bool intersect(const Ray& ray) const override {
 		return false;
 	}
@@ -94,7 +131,7 @@ class DirectionalLight : public Light {
 	spColorSampler intensity;
 	float totalPower;
 protected:
-	virtual vec2 samplePosition() const = 0;
+	virtual vec2 samplePosition(const vec2& u) const = 0;
 	virtual bool isInBounds(vec2 localPosition) const = 0;
 	virtual float surfaceArea() const = 0;
 public:
@@ -112,8 +149,18 @@ public:
 	virtual float power() const override {
 		return totalPower * surfaceArea();
 	}
-	virtual float sampleLe(Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const override {
-		vec2 sample = samplePosition();
+	// beam is parallel to normal, but is bounded by hemisphere, since importance
+	// of bounds does not know whether point is inside of it
+	virtual LightBounds bounds() const override {
+		vec3 normal = lightToWorld.transformNormal(vec3(0.0f, 1.0f, 0.0f));
+		return LightBounds(lightToWorld.transform(bbox()), power(), normal, 1.0f, 0.0f);
+	}
+	virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const override {
+		visitor(intensity);
+	}
+	template<class Wavelength>
+	Wavelength sampleLeSpectral(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, const Wavelength& wavelength) const {
+		vec2 sample = samplePosition(uPos);
 		ray.ro = lightToWorld.transformPoint(vec3(sample.x, 0.0f, sample.y));
 		ray.rd = glm::normalize(lightToWorld.transformNormal(vec3(0.f, 1.f, 0.f)));
 		lightNormal = ray.rd;
@@ -121,7 +168,8 @@ public:
 		pdfDir = 1.0f;
 		return intensity->sample(wavelength);
 	}
-	virtual float sampleLi(const HitInfo& hitInfo, float wavelength, vec3& worldPosition, float& pdf) const override {
+	template<class Wavelength>
+	Wavelength sampleLiSpectral(const HitInfo& hitInfo, const vec2& u, const Wavelength& wavelength, vec3& worldPosition, float& pdf) const {
 		vec3 localPosition = lightToWorld.transformInversePoint(hitInfo.globalPosition);
 		if (localPosition.y < 0.0f)
 			return 0.0f;
@@ -132,6 +180,18 @@ public:
 		pdf = 1.0f;
 		return intensity->sample(wavelength);
 	}
+	virtual float sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const override {
+		return sampleLeSpectral(uPos, uDir, ray, lightNormal, pdfPos, pdfDir, wavelength);
+	}
+	virtual SpectralSample sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, const SpectralSample& wavelengths) const override {
+		return sampleLeSpectral(uPos, uDir, ray, lightNormal, pdfPos, pdfDir, wavelengths);
+	}
+	virtual float sampleLi(const HitInfo& hitInfo, const vec2& u, float wavelength, vec3& worldPosition, float& pdf) const override {
+		return sampleLiSpectral(hitInfo, u, wavelength, worldPosition, pdf);
+	}
+	virtual SpectralSample sampleLi(const HitInfo& hitInfo, const vec2& u, const SpectralSample& wavelengths, vec3& worldPosition, float& pdf) const override {
+		return sampleLiSpectral(hitInfo, u, wavelengths, worldPosition, pdf);
+	}
 	virtual bool intersect(const Ray& ray) const override {
 		const Ray rayLocal = lightToWorld.transformInverse(ray);
 		float t = -rayLocal.ro.y / rayLocal.rd.y;
@@ -170,8 +230,8 @@ public:
 class RectDirectionalLight : public DirectionalLight {
 	vec2 size;
 protected:
-	virtual vec2 samplePosition() const override {
-		return vec2(Random::random() - 0.5f, Random::random() - 0.5f) * size;
+	virtual vec2 samplePosition(const vec2& u) const override {
+		return (u - vec2(0.5f)) * size;
 	}
 	virtual bool isInBounds(vec2 localPosition) const override {
 		return std::abs(localPosition.x) <= 0.5f * size.x && std::abs(localPosition.y) <= 0.5f * size.y;
@@ -194,8 +254,8 @@ public:
 class DiscDirectionalLight : public DirectionalLight {
 	float radius;
 protected:
-	virtual vec2 samplePosition() const override {
-		return Sampling::uniformDisk(radius);
+	virtual vec2 samplePosition(const vec2& u) const override {
+		return Sampling::uniformDisk(radius, u);
 	}
 	virtual bool isInBounds(vec2 localPosition) const override {
 		return glm::dot(localPosition, localPosition) < radius * radius;
@@ -244,11 +304,22 @@ public:
 	virtual float power() const override {
 		return totalPower * area * 2.0f * glm::pi<float>();
 	}
-	virtual float sampleLe(Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const override {
-		HitInfo hitInfo = shape->sample();
+	// emits to one side only, so emission angle is pi / 2 around normals
+	virtual LightBounds bounds() const override {
+		vec3 axis;
+		float cosTheta;
+		shape->normalBounds(axis, cosTheta);
+		return LightBounds(bbox(), totalPower * area, lightToWorld.transformNormal(axis), cosTheta, 0.0f);
+	}
+	virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const override {
+		visitor(intensity);
+	}
+	template<class Wavelength>
+	Wavelength sampleLeSpectral(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, const Wavelength& wavelength) const {
+		HitInfo hitInfo = shape->sample(uPos);
 		lightNormal = lightToWorld.transformNormal(hitInfo.normal);
 		ray.ro = lightToWorld.transformPoint(hitInfo.localPosition);
-		ray.rd = Sampling::uniformHemisphere(lightNormal);
+		ray.rd = Sampling::uniformHemisphere(lightNormal, uDir);
 		pdfPos = shape->pdf();
 		pdfDir = Sampling::uniformHemispherePdf();
 		return intensity->sample(wavelength);
@@ -269,11 +340,19 @@ public:
 		ray.tMax = hitInfo.t;
 		return true;
 	}
-	virtual float lightEmitted(const vec3& wo, const vec3& normal, float wavelength) const {
-		return glm::dot(wo, normal) > 0.0f ? intensity->sample(wavelength): 0.0f;
+	template<class Wavelength>
+	Wavelength lightEmittedSpectral(const vec3& wo, const vec3& normal, const Wavelength& wavelength) const {
+		return glm::dot(wo, normal) > 0.0f ? intensity->sample(wavelength) : Wavelength(0.0f);
 	}
-	virtual float sampleLi(const HitInfo& hitInfo, float wavelength, vec3& worldPosition, float& pdf) const override {
-		HitInfo sample = shape->sample();
+	virtual float lightEmitted(const vec3& wo, const vec3& normal, float wavelength) const override {
+		return lightEmittedSpectral(wo, normal, wavelength);
+	}
+	virtual SpectralSample lightEmitted(const vec3& wo, const vec3& normal, const SpectralSample& wavelengths) const override {
+		return lightEmittedSpectral(wo, normal, wavelengths);
+	}
+	template<class Wavelength>
+	Wavelength sampleLiSpectral(const HitInfo& hitInfo, const vec2& u, const Wavelength& wavelength, vec3& worldPosition, float& pdf) const {
+		HitInfo sample = shape->sample(u);
 		sample.globalPosition = lightToWorld.transformPoint(sample.localPosition);
 		sample.normal = lightToWorld.transformNormal(sample.normal);
 		if (glm::dot(hitInfo.globalPosition - worldPosition, sample.normal) < 0.0f)
@@ -285,6 +364,18 @@ public:
 		pdf = shape->pdf() * distSqr / glm::abs(glm::dot(sample.normal, -wi));
 		return intensity->sample(wavelength);
 	}
+	virtual float sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, float wavelength) const override {
+		return sampleLeSpectral(uPos, uDir, ray, lightNormal, pdfPos, pdfDir, wavelength);
+	}
+	virtual SpectralSample sampleLe(const vec2& uPos, const vec2& uDir, Ray& ray, vec3& lightNormal, float& pdfPos, float& pdfDir, const SpectralSample& wavelengths) const override {
+		return sampleLeSpectral(uPos, uDir, ray, lightNormal, pdfPos, pdfDir, wavelengths);
+	}
+	virtual float sampleLi(const HitInfo& hitInfo, const vec2& u, float wavelength, vec3& worldPosition, float& pdf) const override {
+		return sampleLiSpectral(hitInfo, u, wavelength, worldPosition, pdf);
+	}
+	virtual SpectralSample sampleLi(const HitInfo& hitInfo, const vec2& u, const SpectralSample& wavelengths, vec3& worldPosition, float& pdf) const override {
+		return sampleLiSpectral(hitInfo, u, wavelengths, worldPosition, pdf);
+	}
 	virtual BBox3D bbox() const override {
 		return lightToWorld.transform(shape->bbox());
 	}
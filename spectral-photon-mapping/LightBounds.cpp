@@ -0,0 +1,100 @@
+#include "LightBounds.h"
+
+#include <algorithm>
+
+
+namespace {
+	float safeSqrt(float x) {
+		return std::sqrt(std::max(x, 0.0f));
+	}
+	// cos(max(0, a - b)) from sines and cosines of a and b
+	float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+		if (cosA > cosB)
+			return 1.0f;
+		return cosA * cosB + sinA * sinB;
+	}
+	float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+		if (cosA > cosB)
+			return 0.0f;
+		return sinA * cosB - cosA * sinB;
+	}
+	// rotates v around unit axis
+	vec3 rotate(const vec3& v, const vec3& axis, float angle) {
+		float c = std::cos(angle);
+		float s = std::sin(angle);
+		return v * c + glm::cross(axis, v) * s + axis * glm::dot(axis, v) * (1.0f - c);
+	}
+}
+
+LightBounds::LightBounds(const BBox3D& bounds, float phi, const vec3& w, float cosThetaO, float cosThetaE)
+	: bounds(bounds), phi(phi), w(glm::normalize(w)), cosThetaO(cosThetaO), cosThetaE(cosThetaE)
+{}
+
+float LightBounds::importance(const vec3& point, const vec3& normal) const {
+	if (phi == 0.0f)
+		return 0.0f;
+	vec3 center = bounds.center();
+	float radius = 0.5f * glm::length(bounds.size());
+	vec3 toPoint = point - center;
+	float distanceSqr = glm::dot(toPoint, toPoint);
+	// distance is clamped, so nearby bounds do not get unbounded importance
+	float clampedSqr = std::max(distanceSqr, radius);
+	// inside bounding sphere light may shine in any direction
+	if (distanceSqr <= radius * radius)
+		return phi / clampedSqr;
+	vec3 wi = toPoint / std::sqrt(distanceSqr);
+	// angle subtended by bounding sphere
+	float sinThetaB = std::min(radius / std::sqrt(distanceSqr), 1.0f);
+	float cosThetaB = safeSqrt(1.0f - sinThetaB * sinThetaB);
+	// angle between wi and normals cone, reduced by subtended angle
+	float cosThetaW = glm::dot(w, wi);
+	float sinThetaW = safeSqrt(1.0f - cosThetaW * cosThetaW);
+	float sinThetaO = safeSqrt(1.0f - cosThetaO * cosThetaO);
+	float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= cosThetaE)
+		return 0.0f;
+	float result = phi * cosThetaP / clampedSqr;
+	if (normal != vec3(0.0f)) {
+		float cosThetaI = std::abs(glm::dot(wi, normal));
+		float sinThetaI = safeSqrt(1.0f - cosThetaI * cosThetaI);
+		result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+	return std::max(result, 0.0f);
+}
+
+LightBounds unionOp(const LightBounds& a, const LightBounds& b) {
+	if (a.phi == 0.0f)
+		return b;
+	if (b.phi == 0.0f)
+		return a;
+	LightBounds result;
+	result.bounds = unionOp(a.bounds, b.bounds);
+	result.phi = a.phi + b.phi;
+	result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+	// smallest cone containing both normal cones
+	float thetaA = std::acos(glm::clamp(a.cosThetaO, -1.0f, 1.0f));
+	float thetaB = std::acos(glm::clamp(b.cosThetaO, -1.0f, 1.0f));
+	float thetaD = std::acos(glm::clamp(glm::dot(a.w, b.w), -1.0f, 1.0f));
+	const float Pi = glm::pi<float>();
+	if (std::min(thetaD + thetaB, Pi) <= thetaA) {
+		result.w = a.w;
+		result.cosThetaO = a.cosThetaO;
+	}
+	else if (std::min(thetaD + thetaA, Pi) <= thetaB) {
+		result.w = b.w;
+		result.cosThetaO = b.cosThetaO;
+	}
+	else {
+		float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+		vec3 axis = glm::cross(a.w, b.w);
+		result.w = a.w;
+		result.cosThetaO = -1.0f;
+		if (thetaO < Pi && glm::dot(axis, axis) > 0.0f) {
+			result.w = glm::normalize(rotate(a.w, glm::normalize(axis), thetaO - thetaA));
+			result.cosThetaO = std::cos(thetaO);
+		}
+	}
+	return result;
+}
\ No newline at end of file
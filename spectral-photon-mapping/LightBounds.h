@@ -0,0 +1,23 @@
+#pragma once
+#include "common.h"
+#include "BBox3D.h"
+
+
+// Bounds of light position, power and emission directions
+// Importance Sampling of Many Lights with Adaptive Tree Splitting, Conty Estevez and Kulla 2018
+struct LightBounds {
+	BBox3D bounds;
+	// estimate of emitted power, zero for empty bounds
+	float phi = 0.0f;
+	// cone of surface normals: axis and cosine of half angle
+	vec3 w = vec3(0.0f, 0.0f, 1.0f);
+	float cosThetaO = -1.0f;
+	// cosine of largest emission angle around normal
+	float cosThetaE = 0.0f;
+	LightBounds() = default;
+	LightBounds(const BBox3D& bounds, float phi, const vec3& w, float cosThetaO, float cosThetaE);
+	// conservative estimate of contribution to point, normal of receiving surface may be zero
+	float importance(const vec3& point, const vec3& normal) const;
+};
+
+LightBounds unionOp(const LightBounds& a, const LightBounds& b);
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "LightSampler.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+
+namespace {
+	const float OneMinusEpsilon = 0.99999994f;
+}
+
+std::unique_ptr<LightSampler> LightSampler::create(LightSamplerType type, const std::vector<spLight>& lights) {
+	switch (type) {
+	case LightSamplerType::Uniform:
+		return std::make_unique<UniformLightSampler>(lights);
+	case LightSamplerType::Power:
+		return std::make_unique<PowerLightSampler>(lights);
+	case LightSamplerType::BVH:
+		return std::make_unique<BVHLightSampler>(lights);
+	}
+	throw std::runtime_error("Unknown light sampler type");
+}
+
+UniformLightSampler::UniformLightSampler(const std::vector<spLight>& lights)
+	: count(lights.size())
+{}
+
+int UniformLightSampler::sample(const vec3& position, const vec3& normal, float value, float& pdf) const {
+	if (count == 0)
+		return -1;
+	pdf = 1.0f / count;
+	return std::min(int(value * count), count - 1);
+}
+
+float UniformLightSampler::pdf(const vec3& position, const vec3& normal, int index) const {
+	return count == 0 ? 0.0f : 1.0f / count;
+}
+
+PowerLightSampler::PowerLightSampler(const std::vector<spLight>& lights) {
+	if (lights.empty())
+		return;
+	std::vector<float> power;
+	float sum = 0.0f;
+	for (const auto& light : lights) {
+		power.push_back(light->power());
+		sum += power.back();
+	}
+	// without any power lights are chosen uniformly
+	if (sum == 0.0f)
+		std::fill(power.begin(), power.end(), 1.0f);
+	distribution = std::make_unique<Distribution1D>(power.begin(), power.end());
+}
+
+int PowerLightSampler::sample(const vec3& position, const vec3& normal, float value, float& pdf) const {
+	if (!distribution)
+		return -1;
+	return distribution->sampleAlias(value, pdf);
+}
+
+float PowerLightSampler::pdf(const vec3& position, const vec3& normal, int index) const {
+	return distribution ? distribution->discretePDF(index) : 0.0f;
+}
+
+BVHLightSampler::BVHLightSampler(const std::vector<spLight>& lights)
+	: lightTrails(lights.size(), ~0ull)
+{
+	std::vector<std::pair<int, LightBounds>> bounded;
+	for (int i = 0; i < lights.size(); ++i) {
+		LightBounds bounds = lights[i]->bounds();
+		if (bounds.phi > 0.0f)
+			bounded.push_back(std::make_pair(i, bounds));
+	}
+	if (bounded.empty())
+		return;
+	nodes.reserve(2 * bounded.size() - 1);
+	build(bounded, 0, bounded.size(), 0, 0);
+}
+
+// cost of node for surface area orientation heuristic
+float BVHLightSampler::cost(const LightBounds& bounds, const BBox3D& nodeBounds, int axis) {
+	const float Pi = glm::pi<float>();
+	float thetaO = std::acos(glm::clamp(bounds.cosThetaO, -1.0f, 1.0f));
+	float thetaE = std::acos(glm::clamp(bounds.cosThetaE, -1.0f, 1.0f));
+	float thetaW = std::min(thetaO + thetaE, Pi);
+	float sinThetaO = std::sqrt(std::max(1.0f - bounds.cosThetaO * bounds.cosThetaO, 0.0f));
+	// solid angle of directions lit by orientation cone
+	float omega = 2.0f * Pi * (1.0f - bounds.cosThetaO) +
+		0.5f * Pi * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + bounds.cosThetaO);
+	// penalizes splits across thin extent of node
+	vec3 size = nodeBounds.size();
+	float kr = std::max(size.x, std::max(size.y, size.z)) / size[axis];
+	return bounds.phi * omega * kr * bounds.bounds.area();
+}
+
+int BVHLightSampler::build(std::vector<std::pair<int, LightBounds>>& lights, int begin, int end, uint64_t trail, int depth) {
+	if (end - begin == 1) {
+		int index = nodes.size();
+		nodes.push_back(Node{ lights[begin].second, lights[begin].first, true });
+		lightTrails[lights[begin].first] = trail;
+		return index;
+	}
+	if (depth >= 64)
+		throw std::runtime_error("Light hierarchy is too deep");
+	BBox3D bounds, centroidBounds;
+	for (int i = begin; i < end; ++i) {
+		const BBox3D& lightBounds = lights[i].second.bounds;
+		vec3 centroid = lightBounds.center();
+		bounds = unionOp(bounds, lightBounds);
+		centroidBounds = unionOp(centroidBounds, BBox3D(centroid, centroid));
+	}
+	vec3 centroidSize = centroidBounds.size();
+	auto bucketOf = [&](const LightBounds& lightBounds, int axis) {
+		float offset = (lightBounds.bounds.center()[axis] - centroidBounds.min()[axis]) / centroidSize[axis];
+		return glm::clamp(int(offset * Buckets), 0, Buckets - 1);
+	};
+	float minCost = std::numeric_limits<float>::max();
+	int minAxis = -1;
+	int minBucket = -1;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (centroidSize[axis] == 0.0f)
+			continue;
+		LightBounds buckets[Buckets];
+		for (int i = begin; i < end; ++i) {
+			int bucket = bucketOf(lights[i].second, axis);
+			buckets[bucket] = unionOp(buckets[bucket], lights[i].second);
+		}
+		for (int split = 0; split < Buckets - 1; ++split) {
+			LightBounds below, above;
+			for (int i = 0; i <= split; ++i)
+				below = unionOp(below, buckets[i]);
+			for (int i = split + 1; i < Buckets; ++i)
+				above = unionOp(above, buckets[i]);
+			// empty side does not split anything
+			if (below.phi == 0.0f || above.phi == 0.0f)
+				continue;
+			float splitCost = cost(below, bounds, axis) + cost(above, bounds, axis);
+			if (splitCost < minCost) {
+				minCost = splitCost;
+				minAxis = axis;
+				minBucket = split;
+			}
+		}
+	}
+	int mid;
+	if (minAxis != -1 && minCost > 0.0f) {
+		auto pivot = std::partition(lights.begin() + begin, lights.begin() + end,
+			[&](const std::pair<int, LightBounds>& light) { return bucketOf(light.second, minAxis) <= minBucket; });
+		mid = pivot - lights.begin();
+	}
+	else {
+		// coincident centroids or zero cost everywhere, e.g. for point lights, median keeps tree balanced
+		mid = (begin + end) / 2;
+		int axis = centroidBounds.maxExtentDirection();
+		std::nth_element(lights.begin() + begin, lights.begin() + mid, lights.begin() + end,
+			[axis](const std::pair<int, LightBounds>& a, const std::pair<int, LightBounds>& b) {
+			return a.second.bounds.center()[axis] < b.second.bounds.center()[axis];
+		});
+	}
+	int index = nodes.size();
+	nodes.push_back(Node());
+	build(lights, begin, mid, trail, depth + 1);
+	int second = build(lights, mid, end, trail | (1ull << depth), depth + 1);
+	nodes[index].bounds = unionOp(nodes[index + 1].bounds, nodes[second].bounds);
+	nodes[index].childOrLight = second;
+	nodes[index].isLeaf = false;
+	return index;
+}
+
+int BVHLightSampler::sample(const vec3& position, const vec3& normal, float value, float& pdf) const {
+	if (nodes.empty() || nodes[0].bounds.importance(position, normal) == 0.0f)
+		return -1;
+	pdf = 1.0f;
+	int index = 0;
+	while (!nodes[index].isLeaf) {
+		const Node& node = nodes[index];
+		float first = nodes[index + 1].bounds.importance(position, normal);
+		float second = nodes[node.childOrLight].bounds.importance(position, normal);
+		if (first == 0.0f && second == 0.0f)
+			return -1;
+		float probability = first / (first + second);
+		// value is rescaled, so it stays uniform for next level
+		if (value < probability) {
+			value = std::min(value / probability, OneMinusEpsilon);
+			pdf *= probability;
+			index = index + 1;
+		}
+		else {
+			value = std::min((value - probability) / (1.0f - probability), OneMinusEpsilon);
+			pdf *= 1.0f - probability;
+			index = node.childOrLight;
+		}
+	}
+	return nodes[index].childOrLight;
+}
+
+float BVHLightSampler::pdf(const vec3& position, const vec3& normal, int index) const {
+	uint64_t trail = lightTrails[index];
+	if (trail == ~0ull || nodes[0].bounds.importance(position, normal) == 0.0f)
+		return 0.0f;
+	float pdf = 1.0f;
+	int node = 0;
+	for (; !nodes[node].isLeaf; trail >>= 1) {
+		float first = nodes[node + 1].bounds.importance(position, normal);
+		float second = nodes[nodes[node].childOrLight].bounds.importance(position, normal);
+		if (first == 0.0f && second == 0.0f)
+			return 0.0f;
+		if (trail & 1) {
+			pdf *= second / (first + second);
+			node = nodes[node].childOrLight;
+		}
+		else {
+			pdf *= first / (first + second);
+			node = node + 1;
+		}
+	}
+	return pdf;
+}
\ No newline at end of file
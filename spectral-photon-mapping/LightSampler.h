@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Light.h"
+#include "Distribution1D.h"
+
+
+enum class LightSamplerType {
+	// every light with the same probability
+	Uniform,
+	// proportional to total power
+	Power,
+	// light hierarchy, probability depends on receiving point
+	BVH
+};
+
+// Chooses one light for direct lighting at receiving point
+// Normal of receiving surface may be zero, e.g. for media or two sided materials
+class LightSampler {
+public:
+	static std::unique_ptr<LightSampler> create(LightSamplerType type, const std::vector<spLight>& lights);
+	virtual ~LightSampler() {}
+	// returns -1 if no light may contribute to point
+	virtual int sample(const vec3& position, const vec3& normal, float value, float& pdf) const = 0;
+	virtual float pdf(const vec3& position, const vec3& normal, int index) const = 0;
+};
+
+class UniformLightSampler : public LightSampler {
+	int count;
+public:
+	UniformLightSampler(const std::vector<spLight>& lights);
+	virtual int sample(const vec3& position, const vec3& normal, float value, float& pdf) const override;
+	virtual float pdf(const vec3& position, const vec3& normal, int index) const override;
+};
+
+class PowerLightSampler : public LightSampler {
+	std::unique_ptr<Distribution1D> distribution;
+public:
+	PowerLightSampler(const std::vector<spLight>& lights);
+	virtual int sample(const vec3& position, const vec3& normal, float value, float& pdf) const override;
+	virtual float pdf(const vec3& position, const vec3& normal, int index) const override;
+};
+
+// Binary tree over light bounds, each node is traversed to child with probability
+// proportional to importance of its bounds for receiving point
+// Importance Sampling of Many Lights with Adaptive Tree Splitting, Conty Estevez and Kulla 2018
+class BVHLightSampler : public LightSampler {
+	struct Node {
+		LightBounds bounds;
+		// second child for interior node, its first child follows it, light index for leaf
+		int childOrLight;
+		bool isLeaf;
+	};
+	// buckets of centroid range evaluated for each split
+	static const int Buckets = 12;
+	std::vector<Node> nodes;
+	// path from root to light leaf, one bit per level, 1 means second child
+	// lights with zero power are not in tree and have no trail
+	std::vector<uint64_t> lightTrails;
+	int build(std::vector<std::pair<int, LightBounds>>& lights, int begin, int end, uint64_t trail, int depth);
+	static float cost(const LightBounds& bounds, const BBox3D& centroidBounds, int axis);
+public:
+	BVHLightSampler(const std::vector<spLight>& lights);
+	virtual int sample(const vec3& position, const vec3& normal, float value, float& pdf) const override;
+	virtual float pdf(const vec3& position, const vec3& normal, int index) const override;
+};
\ No newline at end of file
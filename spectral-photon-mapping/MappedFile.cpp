@@ -0,0 +1,51 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <windows.h>
+#undef min
+#undef max
+
+
+MappedFile::MappedFile(const std::string& filename) : file(INVALID_HANDLE_VALUE), mapping(nullptr), _data(nullptr), _size(0) {
+	// sharing for deletion lets writers rename mapped file aside and replace it, see Cache::write
+	file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Cannot open file " + filename);
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("Cannot get size of file " + filename);
+	}
+	_size = size_t(fileSize.QuadPart);
+	// empty files cannot be mapped
+	if (_size == 0)
+		return;
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		throw std::runtime_error("Cannot map file " + filename);
+	}
+	_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (_data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Cannot map view of file " + filename);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+const char* MappedFile::data() const {
+	return _data;
+}
+
+size_t MappedFile::size() const {
+	return _size;
+}
\ No newline at end of file
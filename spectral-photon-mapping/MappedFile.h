@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+
+// Read-only memory mapping of whole file
+class MappedFile {
+	void* file;
+	void* mapping;
+	const char* _data;
+	size_t _size;
+public:
+	MappedFile(const std::string& filename);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	const char* data() const;
+	size_t size() const;
+};
\ No newline at end of file
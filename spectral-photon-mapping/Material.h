@@ -22,6 +22,14 @@ namespace Spectral {
 	class Material {
 	public:
 		virtual std::shared_ptr<BSDF> bsdf(const HitInfo& hitInfo, float wavelength) const = 0;
+		virtual Hero::spBSDF bsdf(const HitInfo& hitInfo, const SpectralSample& wavelengths) const = 0;
+		// true if transmitted lanes take different directions, path continues with hero wavelength only
+		virtual bool isDispersive(const HitInfo& hitInfo, const SpectralSample& wavelengths) const {
+			return false;
+		}
+		// visits all spectra used by material, e.g. for baking
+		virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const {
+		}
 	};
 	class DiffuseMaterial : public Material {
 		spTex<spColorSampler> R;
@@ -35,6 +43,14 @@ namespace Spectral {
 				);
 			return bsdf;
 		}
+		virtual Hero::spBSDF bsdf(const HitInfo& hitInfo, const SpectralSample& wavelengths) const override {
+			return std::make_shared<Hero::BSDF>(
+				std::vector<Hero::spBxDF>({ std::make_shared<Hero::LambertianReflection>(R->sample(hitInfo)->sample(wavelengths)) })
+				);
+		}
+		virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const override {
+			R->forEachValue(visitor);
+		}
 	};
 
 
@@ -50,6 +66,14 @@ namespace Spectral {
 				);
 			return bsdf;
 		}
+		virtual Hero::spBSDF bsdf(const HitInfo& hitInfo, const SpectralSample& wavelengths) const override {
+			return std::make_shared<Hero::BSDF>(
+				std::vector<Hero::spBxDF>({ std::make_shared<Hero::SpecularReflection>(R->sample(hitInfo)->sample(wavelengths)) })
+				);
+		}
+		virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const override {
+			R->forEachValue(visitor);
+		}
 	};
 
 	// todo:
@@ -75,6 +99,22 @@ namespace Spectral {
 				);
 			return bsdf;
 		}
+		// direction is chosen by hero wavelength
+		virtual Hero::spBSDF bsdf(const HitInfo& hitInfo, const SpectralSample& wavelengths) const override {
+			return std::make_shared<Hero::BSDF>(
+				std::vector<Hero::spBxDF>({ std::make_shared<Hero::IdealGlass>(R->sample(hitInfo)->sample(wavelengths),
+					T->sample(hitInfo)->sample(wavelengths),
+					refraction->sample(hitInfo)->sample(wavelengths[0])) })
+				);
+		}
+		virtual bool isDispersive(const HitInfo& hitInfo, const SpectralSample& wavelengths) const override {
+			return !refraction->sample(hitInfo)->sample(wavelengths).isUniform();
+		}
+		virtual void forEachSampler(const std::function<void(const spColorSampler&)>& visitor) const override {
+			R->forEachValue(visitor);
+			T->forEachValue(visitor);
+			refraction->forEachValue(visitor);
+		}
 	};
 
 	using spMaterial = std::shared_ptr<Material>;
@@ -3,9 +3,8 @@
 #include "Triangle.h"
 
 
-// todo: add indexed mesh
-// todo: NOT IMPLEMENTED
-// todo: add accelerator structure for intersections
+// mesh of separate triangles over generic primitive accelerator
+// use TriangleMesh for indexed meshes
 template<class PrimitiveAccelerator>
 class Mesh : public Shape {
 	std::vector<Triangle> triangles;
@@ -16,8 +15,10 @@ public:
 	Mesh(std::initializer_list<Triangle> list);
 	template<typename Iterator>
 	Mesh(const Iterator& begin, const Iterator& end);
-	virtual HitInfo sample() const override;
+	virtual HitInfo sample(const vec2& u) const override;
 	virtual BBox3D bbox() const override;
+	virtual BBox3D clippedBBox(const BBox3D& box) const override;
+	virtual BBox3D clippedBBox(const BBox3D& box, const Affine& transform) const override;
 	virtual bool intersect(const Ray& ray) const override;
 	virtual bool intersect(const Ray& ray, HitInfo& hitInfo) const override;
 	virtual float area() const override;
@@ -33,7 +34,7 @@ Mesh<Accelerator>::Mesh(const Iterator& begin, const Iterator& end) {
 		triangles.push_back(*it);
 		_area += it->area();
 	}
-	accelerator(triangles.begin(), triangles.end());
+	accelerator = std::make_unique<Accelerator>(triangles.begin(), triangles.end());
 }
 
 
@@ -52,7 +53,7 @@ Mesh<Accelerator>::Mesh(std::initializer_list<Triangle> list) {
 }
 
 template<class Accelerator>
-HitInfo Mesh<Accelerator>::sample() const {
+HitInfo Mesh<Accelerator>::sample(const vec2& u) const {
 	throw std::runtime_error("Not implemented");
 }
 
@@ -61,6 +62,22 @@ BBox3D Mesh<Accelerator>::bbox() const {
 	return accelerator->bbox();
 }
 
+template<class Accelerator>
+BBox3D Mesh<Accelerator>::clippedBBox(const BBox3D& box) const {
+	BBox3D result;
+	for (const auto& triangle : triangles)
+		result = unionOp(result, triangle.clippedBBox(box));
+	return result;
+}
+
+template<class Accelerator>
+BBox3D Mesh<Accelerator>::clippedBBox(const BBox3D& box, const Affine& transform) const {
+	BBox3D result;
+	for (const auto& triangle : triangles)
+		result = unionOp(result, triangle.clippedBBox(box, transform));
+	return result;
+}
+
 template<class Accelerator>
 bool Mesh<Accelerator>::intersect(const Ray& ray) const {
 	return accelerator->intersect(ray);
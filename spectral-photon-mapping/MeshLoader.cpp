@@ -0,0 +1,821 @@
+#include "MeshLoader.h"
+#include "MappedFile.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <stdexcept>
+#include <unordered_map>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+
+
+namespace MeshLoader {
+	namespace {
+		size_t peakMemoryUsage() {
+			PROCESS_MEMORY_COUNTERS counters;
+			if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+				return 0;
+			return counters.PeakWorkingSetSize;
+		}
+
+		int threadCount(int threads) {
+			if (threads > 0)
+				return threads;
+			return std::max(1, int(std::thread::hardware_concurrency()));
+		}
+
+		// runs func(threadId) on each thread and waits for all of them
+		// first exception thrown by workers is rethrown in calling thread
+		template<class Func>
+		void runParallel(int threads, const Func& func) {
+			if (threads <= 0)
+				return;
+			std::vector<std::exception_ptr> errors(threads);
+			auto task = [&](int threadId) {
+				try {
+					func(threadId);
+				}
+				catch (...) {
+					errors[threadId] = std::current_exception();
+				}
+			};
+			std::vector<std::thread> workers;
+			for (int threadId = 1; threadId < threads; ++threadId)
+				workers.emplace_back(task, threadId);
+			task(0);
+			for (auto& worker : workers)
+				worker.join();
+			for (auto& error : errors) {
+				if (error)
+					std::rethrow_exception(error);
+			}
+		}
+
+		// [begin, end) range of item for thread
+		template<class T>
+		void threadRange(T count, int threads, int threadId, T& begin, T& end) {
+			begin = count * threadId / threads;
+			end = count * (threadId + 1) / threads;
+		}
+
+		inline bool isSpace(char c) {
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		inline void skipSpaces(const char*& p, const char* end) {
+			while (p < end && isSpace(*p))
+				++p;
+		}
+
+		inline void skipLine(const char*& p, const char* end) {
+			while (p < end && *p != '\n')
+				++p;
+			if (p < end)
+				++p;
+		}
+
+		// parsers stop at end of mapped range, file is not null terminated
+		bool parseInt(const char*& p, const char* end, int& value) {
+			bool negative = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negative = *p == '-';
+				++p;
+			}
+			if (p == end || *p < '0' || *p > '9')
+				return false;
+			int result = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+				result = result * 10 + (*p++ - '0');
+			value = negative ? -result : result;
+			return true;
+		}
+
+		bool parseFloat(const char*& p, const char* end, float& value) {
+			bool negative = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negative = *p == '-';
+				++p;
+			}
+			const char* start = p;
+			double result = 0.0;
+			while (p < end && *p >= '0' && *p <= '9')
+				result = result * 10.0 + (*p++ - '0');
+			if (p < end && *p == '.') {
+				++p;
+				double scale = 0.1;
+				while (p < end && *p >= '0' && *p <= '9') {
+					result += (*p++ - '0') * scale;
+					scale *= 0.1;
+				}
+			}
+			if (p == start)
+				return false;
+			if (p < end && (*p == 'e' || *p == 'E')) {
+				++p;
+				int exponent = 0;
+				if (!parseInt(p, end, exponent))
+					return false;
+				result *= std::pow(10.0, exponent);
+			}
+			value = float(negative ? -result : result);
+			return true;
+		}
+
+		// splits data into ranges ending at line breaks
+		std::vector<std::pair<const char*, const char*>> splitLines(const char* begin, const char* end, int count) {
+			std::vector<std::pair<const char*, const char*>> chunks;
+			size_t size = end - begin;
+			const char* chunkBegin = begin;
+			for (int i = 1; i <= count && chunkBegin < end; ++i) {
+				const char* chunkEnd = i == count ? end : std::max(chunkBegin, begin + size * i / count);
+				while (chunkEnd < end && *(chunkEnd - 1) != '\n')
+					++chunkEnd;
+				chunks.emplace_back(chunkBegin, chunkEnd);
+				chunkBegin = chunkEnd;
+			}
+			return chunks;
+		}
+
+		void fillStats(Stats* stats, const TriangleMesh& mesh, size_t fileSize, int threads, double parseTime, double loadTime) {
+			if (!stats)
+				return;
+			stats->fileSize = fileSize;
+			stats->vertices = mesh.numVertices();
+			stats->triangles = mesh.numTriangles();
+			stats->threads = threads;
+			stats->parseTime = parseTime;
+			stats->loadTime = loadTime;
+			stats->peakMemory = peakMemoryUsage();
+			stats->meshMemory = mesh.memoryUsage();
+		}
+
+		struct ObjCorner {
+			enum : unsigned char {
+				RelativePosition = 1,
+				RelativeUV = 2,
+				RelativeNormal = 4
+			};
+			int position;
+			int uv;
+			int normal;
+			// relative indices are counted from start of chunk until resolved
+			unsigned char relative;
+		};
+
+		struct ObjChunk {
+			std::vector<vec3> positions;
+			std::vector<vec2> uvs;
+			std::vector<vec3> normals;
+			// corners of triangulated faces
+			std::vector<ObjCorner> corners;
+			bool missingUV = false;
+			bool missingNormal = false;
+		};
+
+		const int MissingIndex = std::numeric_limits<int>::min();
+
+		// converts 1-based or negative OBJ index into 0-based index, relative to chunk for negative, 0 is invalid
+		inline int objIndex(int index, int localCount, unsigned char flag, unsigned char& relative) {
+			if (index > 0)
+				return index - 1;
+			if (index == 0)
+				throw std::runtime_error("Bad OBJ face");
+			relative |= flag;
+			return localCount + index;
+		}
+
+		bool parseObjCorner(const char*& p, const char* end, ObjChunk& chunk, ObjCorner& corner) {
+			int index;
+			corner.relative = 0;
+			corner.uv = MissingIndex;
+			corner.normal = MissingIndex;
+			if (!parseInt(p, end, index))
+				return false;
+			corner.position = objIndex(index, chunk.positions.size(), ObjCorner::RelativePosition, corner.relative);
+			if (p < end && *p == '/') {
+				++p;
+				if (p < end && *p != '/') {
+					if (!parseInt(p, end, index))
+						return false;
+					corner.uv = objIndex(index, chunk.uvs.size(), ObjCorner::RelativeUV, corner.relative);
+				}
+				if (p < end && *p == '/') {
+					++p;
+					if (!parseInt(p, end, index))
+						return false;
+					corner.normal = objIndex(index, chunk.normals.size(), ObjCorner::RelativeNormal, corner.relative);
+				}
+			}
+			return true;
+		}
+
+		void parseObjChunk(const char* p, const char* end, ObjChunk& chunk) {
+			std::vector<ObjCorner> face;
+			while (p < end) {
+				skipSpaces(p, end);
+				if (p + 1 >= end) {
+					skipLine(p, end);
+					continue;
+				}
+				if (p[0] == 'v' && isSpace(p[1])) {
+					vec3 position;
+					p += 2;
+					for (int i = 0; i < 3; ++i) {
+						skipSpaces(p, end);
+						if (!parseFloat(p, end, position[i]))
+							throw std::runtime_error("Bad OBJ vertex position");
+					}
+					chunk.positions.push_back(position);
+				}
+				else if (p[0] == 'v' && p[1] == 't') {
+					vec2 uv;
+					p += 2;
+					for (int i = 0; i < 2; ++i) {
+						skipSpaces(p, end);
+						if (!parseFloat(p, end, uv[i]))
+							throw std::runtime_error("Bad OBJ texture coordinate");
+					}
+					chunk.uvs.push_back(uv);
+				}
+				else if (p[0] == 'v' && p[1] == 'n') {
+					vec3 normal;
+					p += 2;
+					for (int i = 0; i < 3; ++i) {
+						skipSpaces(p, end);
+						if (!parseFloat(p, end, normal[i]))
+							throw std::runtime_error("Bad OBJ normal");
+					}
+					chunk.normals.push_back(normal);
+				}
+				else if (p[0] == 'f' && isSpace(p[1])) {
+					p += 2;
+					face.clear();
+					ObjCorner corner;
+					while (true) {
+						skipSpaces(p, end);
+						if (p == end || *p == '\n' || *p == '#')
+							break;
+						if (!parseObjCorner(p, end, chunk, corner))
+							throw std::runtime_error("Bad OBJ face");
+						face.push_back(corner);
+					}
+					// triangle fan
+					for (size_t i = 2; i < face.size(); ++i) {
+						chunk.corners.push_back(face[0]);
+						chunk.corners.push_back(face[i - 1]);
+						chunk.corners.push_back(face[i]);
+					}
+					for (const auto& corner : face) {
+						chunk.missingUV |= corner.uv == MissingIndex;
+						chunk.missingNormal |= corner.normal == MissingIndex;
+					}
+				}
+				// comments, groups, materials and other statements are skipped
+				skipLine(p, end);
+			}
+		}
+
+		struct CornerKey {
+			int position;
+			int uv;
+			int normal;
+			bool operator==(const CornerKey& other) const {
+				return position == other.position && uv == other.uv && normal == other.normal;
+			}
+		};
+
+		struct CornerKeyHash {
+			size_t operator()(const CornerKey& key) const {
+				size_t hash = std::hash<int>()(key.position);
+				hash = hash * 31 + std::hash<int>()(key.uv);
+				return hash * 31 + std::hash<int>()(key.normal);
+			}
+		};
+	}
+
+	spTriangleMesh loadOBJ(const std::string& filename, Stats* stats, int threads) {
+		Timer<double> timer;
+		threads = threadCount(threads);
+		MappedFile file(filename);
+		auto ranges = splitLines(file.data(), file.data() + file.size(), threads);
+		int chunkCount = ranges.size();
+		std::vector<ObjChunk> chunks(chunkCount);
+		runParallel(chunkCount, [&](int chunkId) {
+			parseObjChunk(ranges[chunkId].first, ranges[chunkId].second, chunks[chunkId]);
+		});
+		// offsets of chunk data in whole file
+		std::vector<int> positionOffsets(chunkCount + 1, 0);
+		std::vector<int> uvOffsets(chunkCount + 1, 0);
+		std::vector<int> normalOffsets(chunkCount + 1, 0);
+		std::vector<size_t> cornerOffsets(chunkCount + 1, 0);
+		bool hasUV = true;
+		bool hasNormal = true;
+		for (int i = 0; i < chunkCount; ++i) {
+			positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+			uvOffsets[i + 1] = uvOffsets[i] + chunks[i].uvs.size();
+			normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+			cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].corners.size();
+			hasUV &= !chunks[i].missingUV;
+			hasNormal &= !chunks[i].missingNormal;
+		}
+		int positionCount = positionOffsets.back();
+		hasUV &= uvOffsets.back() > 0;
+		hasNormal &= normalOffsets.back() > 0;
+		// resolve indices and check if attributes share position indices
+		std::vector<char> aligned(chunkCount, 1);
+		runParallel(chunkCount, [&](int chunkId) {
+			for (auto& corner : chunks[chunkId].corners) {
+				if (corner.relative & ObjCorner::RelativePosition)
+					corner.position += positionOffsets[chunkId];
+				if (corner.relative & ObjCorner::RelativeUV)
+					corner.uv += uvOffsets[chunkId];
+				if (corner.relative & ObjCorner::RelativeNormal)
+					corner.normal += normalOffsets[chunkId];
+				if (corner.position < 0 || corner.position >= positionCount)
+					aligned[chunkId] = -1;
+				else if (aligned[chunkId] == 1 && ((hasUV && corner.uv != corner.position) || (hasNormal && corner.normal != corner.position)))
+					aligned[chunkId] = 0;
+			}
+		});
+		bool attributesAligned = true;
+		for (char value : aligned) {
+			if (value == -1)
+				throw std::runtime_error("OBJ index out of range in " + filename);
+			attributesAligned &= value == 1;
+		}
+		hasUV &= !attributesAligned || uvOffsets.back() == positionCount;
+		hasNormal &= !attributesAligned || normalOffsets.back() == positionCount;
+		std::vector<vec3> positions;
+		std::vector<vec3> normals;
+		std::vector<vec2> uvs;
+		std::vector<int> indices;
+		if (attributesAligned || (!hasUV && !hasNormal)) {
+			// vertices map one to one, copy chunks straight into buffers
+			positions.resize(positionCount);
+			if (hasUV)
+				uvs.resize(positionCount);
+			if (hasNormal)
+				normals.resize(positionCount);
+			indices.resize(cornerOffsets.back());
+			runParallel(chunkCount, [&](int chunkId) {
+				const ObjChunk& chunk = chunks[chunkId];
+				std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionOffsets[chunkId]);
+				if (hasUV)
+					std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvOffsets[chunkId]);
+				if (hasNormal)
+					std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalOffsets[chunkId]);
+				size_t offset = cornerOffsets[chunkId];
+				for (size_t i = 0; i < chunk.corners.size(); ++i)
+					indices[offset + i] = chunk.corners[i].position;
+			});
+		}
+		else {
+			// attributes have own indices, merge unique corners into vertices
+			std::vector<const vec3*> chunkPositions(positionCount);
+			std::vector<const vec2*> chunkUVs(uvOffsets.back());
+			std::vector<const vec3*> chunkNormals(normalOffsets.back());
+			for (int chunkId = 0; chunkId < chunkCount; ++chunkId) {
+				const ObjChunk& chunk = chunks[chunkId];
+				for (size_t i = 0; i < chunk.positions.size(); ++i)
+					chunkPositions[positionOffsets[chunkId] + i] = &chunk.positions[i];
+				for (size_t i = 0; i < chunk.uvs.size(); ++i)
+					chunkUVs[uvOffsets[chunkId] + i] = &chunk.uvs[i];
+				for (size_t i = 0; i < chunk.normals.size(); ++i)
+					chunkNormals[normalOffsets[chunkId] + i] = &chunk.normals[i];
+			}
+			std::unordered_map<CornerKey, int, CornerKeyHash> vertexIds;
+			vertexIds.reserve(positionCount);
+			indices.reserve(cornerOffsets.back());
+			for (const auto& chunk : chunks) {
+				for (const auto& corner : chunk.corners) {
+					CornerKey key{ corner.position, hasUV ? corner.uv : 0, hasNormal ? corner.normal : 0 };
+					auto it = vertexIds.find(key);
+					if (it != vertexIds.end()) {
+						indices.push_back(it->second);
+						continue;
+					}
+					if ((hasUV && (key.uv < 0 || key.uv >= int(chunkUVs.size()))) ||
+						(hasNormal && (key.normal < 0 || key.normal >= int(chunkNormals.size()))))
+						throw std::runtime_error("OBJ index out of range in " + filename);
+					int vertexId = positions.size();
+					vertexIds.emplace(key, vertexId);
+					positions.push_back(*chunkPositions[key.position]);
+					if (hasUV)
+						uvs.push_back(*chunkUVs[key.uv]);
+					if (hasNormal)
+						normals.push_back(*chunkNormals[key.normal]);
+					indices.push_back(vertexId);
+				}
+			}
+		}
+		// free parser memory before accelerator build
+		chunks.clear();
+		chunks.shrink_to_fit();
+		double parseTime = timer.elapsed();
+		spTriangleMesh mesh = std::make_shared<TriangleMesh>(std::move(positions), std::move(indices), std::move(normals), std::move(uvs));
+		fillStats(stats, *mesh, file.size(), threads, parseTime, timer.elapsed());
+		return mesh;
+	}
+
+	namespace {
+		enum class PlyType {
+			Int8,
+			UInt8,
+			Int16,
+			UInt16,
+			Int32,
+			UInt32,
+			Float32,
+			Float64
+		};
+
+		struct PlyProperty {
+			std::string name;
+			PlyType type;
+			bool isList = false;
+			PlyType countType;
+			// byte offset in element if all previous properties have fixed size
+			size_t offset = 0;
+		};
+
+		struct PlyElement {
+			std::string name;
+			size_t count = 0;
+			std::vector<PlyProperty> properties;
+			// size of element in bytes, 0 if element has lists
+			size_t stride = 0;
+		};
+
+		int plyTypeSize(PlyType type) {
+			switch (type) {
+			case PlyType::Int8:
+			case PlyType::UInt8:
+				return 1;
+			case PlyType::Int16:
+			case PlyType::UInt16:
+				return 2;
+			case PlyType::Int32:
+			case PlyType::UInt32:
+			case PlyType::Float32:
+				return 4;
+			case PlyType::Float64:
+				return 8;
+			}
+			return 0;
+		}
+
+		PlyType plyType(const std::string& name) {
+			if (name == "char" || name == "int8")
+				return PlyType::Int8;
+			if (name == "uchar" || name == "uint8")
+				return PlyType::UInt8;
+			if (name == "short" || name == "int16")
+				return PlyType::Int16;
+			if (name == "ushort" || name == "uint16")
+				return PlyType::UInt16;
+			if (name == "int" || name == "int32")
+				return PlyType::Int32;
+			if (name == "uint" || name == "uint32")
+				return PlyType::UInt32;
+			if (name == "float" || name == "float32")
+				return PlyType::Float32;
+			if (name == "double" || name == "float64")
+				return PlyType::Float64;
+			throw std::runtime_error("Unknown PLY type " + name);
+		}
+
+		template<class T>
+		T readRaw(const char* p, bool swapBytes) {
+			char bytes[sizeof(T)];
+			memcpy(bytes, p, sizeof(T));
+			if (swapBytes)
+				std::reverse(bytes, bytes + sizeof(T));
+			T value;
+			memcpy(&value, bytes, sizeof(T));
+			return value;
+		}
+
+		double readPlyValue(const char* p, PlyType type, bool swapBytes) {
+			switch (type) {
+			case PlyType::Int8:
+				return readRaw<int8_t>(p, swapBytes);
+			case PlyType::UInt8:
+				return readRaw<uint8_t>(p, swapBytes);
+			case PlyType::Int16:
+				return readRaw<int16_t>(p, swapBytes);
+			case PlyType::UInt16:
+				return readRaw<uint16_t>(p, swapBytes);
+			case PlyType::Int32:
+				return readRaw<int32_t>(p, swapBytes);
+			case PlyType::UInt32:
+				return readRaw<uint32_t>(p, swapBytes);
+			case PlyType::Float32:
+				return readRaw<float>(p, swapBytes);
+			case PlyType::Float64:
+				return readRaw<double>(p, swapBytes);
+			}
+			return 0.0;
+		}
+
+		std::string nextToken(const char*& p, const char* end) {
+			skipSpaces(p, end);
+			const char* start = p;
+			while (p < end && !isSpace(*p) && *p != '\n')
+				++p;
+			return std::string(start, p);
+		}
+
+		// parses header and returns pointer to binary data
+		const char* parsePlyHeader(const char* p, const char* end, std::vector<PlyElement>& elements, bool& swapBytes) {
+			if (nextToken(p, end) != "ply")
+				throw std::runtime_error("Not a PLY file");
+			skipLine(p, end);
+			bool hasFormat = false;
+			while (p < end) {
+				std::string keyword = nextToken(p, end);
+				if (keyword == "end_header") {
+					skipLine(p, end);
+					if (!hasFormat)
+						throw std::runtime_error("PLY format is not specified");
+					return p;
+				}
+				if (keyword == "format") {
+					std::string format = nextToken(p, end);
+					if (format == "ascii")
+						throw std::runtime_error("ASCII PLY is not supported");
+					if (format != "binary_little_endian" && format != "binary_big_endian")
+						throw std::runtime_error("Unknown PLY format " + format);
+					// all supported platforms are little endian
+					swapBytes = format == "binary_big_endian";
+					hasFormat = true;
+				}
+				else if (keyword == "element") {
+					PlyElement element;
+					element.name = nextToken(p, end);
+					element.count = std::stoull(nextToken(p, end));
+					elements.push_back(element);
+				}
+				else if (keyword == "property") {
+					if (elements.empty())
+						throw std::runtime_error("PLY property without element");
+					PlyProperty property;
+					std::string type = nextToken(p, end);
+					if (type == "list") {
+						property.isList = true;
+						property.countType = plyType(nextToken(p, end));
+						type = nextToken(p, end);
+					}
+					property.type = plyType(type);
+					property.name = nextToken(p, end);
+					elements.back().properties.push_back(property);
+				}
+				// comments and obj_info are skipped
+				skipLine(p, end);
+			}
+			throw std::runtime_error("Unexpected end of PLY header");
+		}
+
+		void computeLayout(PlyElement& element) {
+			size_t offset = 0;
+			for (auto& property : element.properties) {
+				property.offset = offset;
+				if (property.isList) {
+					element.stride = 0;
+					return;
+				}
+				offset += plyTypeSize(property.type);
+			}
+			element.stride = offset;
+		}
+
+		// size of element with lists at p
+		size_t elementSize(const PlyElement& element, const char* p, const char* end, bool swapBytes) {
+			if (element.stride != 0)
+				return element.stride;
+			size_t size = 0;
+			for (const auto& property : element.properties) {
+				if (property.isList) {
+					if (p + size + plyTypeSize(property.countType) > end)
+						throw std::runtime_error("Unexpected end of PLY file");
+					size_t count = size_t(readPlyValue(p + size, property.countType, swapBytes));
+					size += plyTypeSize(property.countType) + count * plyTypeSize(property.type);
+				}
+				else
+					size += plyTypeSize(property.type);
+			}
+			return size;
+		}
+
+		int findProperty(const PlyElement& element, std::initializer_list<const char*> names) {
+			for (size_t i = 0; i < element.properties.size(); ++i) {
+				for (const char* name : names) {
+					if (element.properties[i].name == name)
+						return i;
+				}
+			}
+			return -1;
+		}
+
+		void readPlyVertices(const PlyElement& element, const char* data, bool swapBytes, int threads,
+			std::vector<vec3>& positions, std::vector<vec3>& normals, std::vector<vec2>& uvs) {
+			if (element.stride == 0)
+				throw std::runtime_error("PLY vertices with list properties are not supported");
+			int position[3] = {
+				findProperty(element, { "x" }),
+				findProperty(element, { "y" }),
+				findProperty(element, { "z" })
+			};
+			int normal[3] = {
+				findProperty(element, { "nx" }),
+				findProperty(element, { "ny" }),
+				findProperty(element, { "nz" })
+			};
+			int uv[2] = {
+				findProperty(element, { "u", "s", "texture_u", "texture_s" }),
+				findProperty(element, { "v", "t", "texture_v", "texture_t" })
+			};
+			if (position[0] == -1 || position[1] == -1 || position[2] == -1)
+				throw std::runtime_error("PLY vertices have no positions");
+			bool hasNormal = normal[0] != -1 && normal[1] != -1 && normal[2] != -1;
+			bool hasUV = uv[0] != -1 && uv[1] != -1;
+			positions.resize(element.count);
+			if (hasNormal)
+				normals.resize(element.count);
+			if (hasUV)
+				uvs.resize(element.count);
+			const auto& properties = element.properties;
+			runParallel(threads, [&](int threadId) {
+				size_t first, last;
+				threadRange(element.count, threads, threadId, first, last);
+				for (size_t i = first; i < last; ++i) {
+					const char* vertex = data + i * element.stride;
+					for (int dim = 0; dim < 3; ++dim)
+						positions[i][dim] = float(readPlyValue(vertex + properties[position[dim]].offset, properties[position[dim]].type, swapBytes));
+					if (hasNormal) {
+						for (int dim = 0; dim < 3; ++dim)
+							normals[i][dim] = float(readPlyValue(vertex + properties[normal[dim]].offset, properties[normal[dim]].type, swapBytes));
+					}
+					if (hasUV) {
+						for (int dim = 0; dim < 2; ++dim)
+							uvs[i][dim] = float(readPlyValue(vertex + properties[uv[dim]].offset, properties[uv[dim]].type, swapBytes));
+					}
+				}
+			});
+		}
+
+		// returns pointer past last face
+		const char* readPlyFaces(const PlyElement& element, const char* data, const char* end, bool swapBytes, int threads, int vertexCount,
+			std::vector<int>& indices) {
+			int listId = findProperty(element, { "vertex_indices", "vertex_index" });
+			if (listId == -1 || !element.properties[listId].isList)
+				throw std::runtime_error("PLY faces have no vertex indices");
+			const PlyProperty& list = element.properties[listId];
+			int countSize = plyTypeSize(list.countType);
+			int indexSize = plyTypeSize(list.type);
+			// size of properties around index list, they must have fixed size for parallel read
+			size_t before = 0;
+			size_t after = 0;
+			bool fixedSize = true;
+			for (size_t i = 0; i < element.properties.size(); ++i) {
+				const auto& property = element.properties[i];
+				if (int(i) == listId)
+					continue;
+				if (property.isList)
+					fixedSize = false;
+				(int(i) < listId ? before : after) += plyTypeSize(property.type);
+			}
+			if (fixedSize) {
+				// most files have only triangles, assume fixed stride and check counts
+				size_t stride = before + countSize + 3 * indexSize + after;
+				if (data + element.count * stride <= end) {
+					std::vector<char> valid(threads, 1);
+					indices.resize(3 * element.count);
+					runParallel(threads, [&](int threadId) {
+						size_t first, last;
+						threadRange(element.count, threads, threadId, first, last);
+						for (size_t i = first; i < last; ++i) {
+							const char* face = data + i * stride + before;
+							if (readPlyValue(face, list.countType, swapBytes) != 3.0) {
+								valid[threadId] = 0;
+								return;
+							}
+							for (int corner = 0; corner < 3; ++corner) {
+								int index = int(readPlyValue(face + countSize + corner * indexSize, list.type, swapBytes));
+								if (index < 0 || index >= vertexCount) {
+									valid[threadId] = 0;
+									return;
+								}
+								indices[3 * i + corner] = index;
+							}
+						}
+					});
+					if (std::all_of(valid.begin(), valid.end(), [](char value) { return value == 1; }))
+						return data + element.count * stride;
+					indices.clear();
+				}
+			}
+			// polygons or lists of other properties, sequential read with triangle fans
+			indices.reserve(3 * element.count);
+			const char* p = data;
+			for (size_t i = 0; i < element.count; ++i) {
+				size_t size = elementSize(element, p, end, swapBytes);
+				if (p + size > end)
+					throw std::runtime_error("Unexpected end of PLY file");
+				// offset of list in this face
+				size_t listOffset = 0;
+				for (int j = 0; j < listId; ++j) {
+					const auto& property = element.properties[j];
+					if (property.isList)
+						listOffset += plyTypeSize(property.countType) + size_t(readPlyValue(p + listOffset, property.countType, swapBytes)) * plyTypeSize(property.type);
+					else
+						listOffset += plyTypeSize(property.type);
+				}
+				const char* face = p + listOffset;
+				int count = int(readPlyValue(face, list.countType, swapBytes));
+				// points and edges have no triangles, their indices are not read
+				if (count < 3) {
+					p += size;
+					continue;
+				}
+				int first = int(readPlyValue(face + countSize, list.type, swapBytes));
+				for (int corner = 2; corner < count; ++corner) {
+					int second = int(readPlyValue(face + countSize + (corner - 1) * indexSize, list.type, swapBytes));
+					int third = int(readPlyValue(face + countSize + corner * indexSize, list.type, swapBytes));
+					if (std::max(first, std::max(second, third)) >= vertexCount || std::min(first, std::min(second, third)) < 0)
+						throw std::runtime_error("PLY index out of range");
+					indices.push_back(first);
+					indices.push_back(second);
+					indices.push_back(third);
+				}
+				p += size;
+			}
+			return p;
+		}
+	}
+
+	spTriangleMesh loadPLY(const std::string& filename, Stats* stats, int threads) {
+		Timer<double> timer;
+		threads = threadCount(threads);
+		MappedFile file(filename);
+		const char* end = file.data() + file.size();
+		std::vector<PlyElement> elements;
+		bool swapBytes = false;
+		const char* p = parsePlyHeader(file.data(), end, elements, swapBytes);
+		std::vector<vec3> positions;
+		std::vector<vec3> normals;
+		std::vector<vec2> uvs;
+		std::vector<int> indices;
+		bool hasVertices = false;
+		for (auto& element : elements) {
+			computeLayout(element);
+			if (element.name == "vertex") {
+				if (p + element.count * element.stride > end)
+					throw std::runtime_error("Unexpected end of PLY file " + filename);
+				readPlyVertices(element, p, swapBytes, threads, positions, normals, uvs);
+				p += element.count * element.stride;
+				hasVertices = true;
+			}
+			else if (element.name == "face") {
+				if (!hasVertices)
+					throw std::runtime_error("PLY faces before vertices are not supported");
+				p = readPlyFaces(element, p, end, swapBytes, threads, positions.size(), indices);
+			}
+			else if (element.stride != 0) {
+				p += element.count * element.stride;
+			}
+			else {
+				for (size_t i = 0; i < element.count; ++i)
+					p += elementSize(element, p, end, swapBytes);
+			}
+			if (p > end)
+				throw std::runtime_error("Unexpected end of PLY file " + filename);
+		}
+		double parseTime = timer.elapsed();
+		spTriangleMesh mesh = std::make_shared<TriangleMesh>(std::move(positions), std::move(indices), std::move(normals), std::move(uvs));
+		fillStats(stats, *mesh, file.size(), threads, parseTime, timer.elapsed());
+		return mesh;
+	}
+
+	spTriangleMesh load(const std::string& filename, Stats* stats, int threads) {
+		size_t dot = filename.find_last_of('.');
+		std::string extension = dot == std::string::npos ? "" : filename.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(tolower(c)); });
+		if (extension == "obj")
+			return loadOBJ(filename, stats, threads);
+		if (extension == "ply")
+			return loadPLY(filename, stats, threads);
+		throw std::runtime_error("Unknown mesh format " + filename);
+	}
+
+	void printStats(const Stats& stats) {
+		printf("Mesh: %d vertices, %d triangles, file %.2f MB\n", stats.vertices, stats.triangles, stats.fileSize / (1024.0 * 1024.0));
+		printf("Load time: %f s (parse %f s, %d threads)\n", stats.loadTime, stats.parseTime, stats.threads);
+		printf("Memory: mesh %.2f MB, peak %.2f MB\n", stats.meshMemory / (1024.0 * 1024.0), stats.peakMemory / (1024.0 * 1024.0));
+	}
+}
\ No newline at end of file
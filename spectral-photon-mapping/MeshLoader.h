@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+#include "TriangleMesh.h"
+
+
+// Importers of OBJ and binary PLY files into indexed triangle meshes
+// Files are memory mapped and parsed in parallel chunks straight into mesh buffers
+namespace MeshLoader {
+	struct Stats {
+		size_t fileSize = 0;
+		int vertices = 0;
+		int triangles = 0;
+		int threads = 0;
+		// time to fill vertex and index buffers in seconds
+		double parseTime = 0.0;
+		// parse time plus mesh accelerator build
+		double loadTime = 0.0;
+		// peak working set of process in bytes
+		size_t peakMemory = 0;
+		// memory used by loaded mesh in bytes
+		size_t meshMemory = 0;
+	};
+	// threads <= 0 uses all hardware threads
+	spTriangleMesh loadOBJ(const std::string& filename, Stats* stats = nullptr, int threads = 0);
+	spTriangleMesh loadPLY(const std::string& filename, Stats* stats = nullptr, int threads = 0);
+	// selects importer by file extension
+	spTriangleMesh load(const std::string& filename, Stats* stats = nullptr, int threads = 0);
+	void printStats(const Stats& stats);
+}
\ No newline at end of file
@@ -6,6 +6,10 @@ class PlanarShape :public Shape {
 public:
 	virtual bool intersect(const Ray& ray) const override;
 	virtual bool intersect(const Ray& ray, HitInfo& hitInfo) const override;
+	virtual void normalBounds(vec3& axis, float& cosTheta) const override {
+		axis = vec3(0.0f, 1.0f, 0.0f);
+		cosTheta = 1.0f;
+	}
 protected:
 	virtual bool isInBounds(vec2 p) const = 0;
 };
\ No newline at end of file
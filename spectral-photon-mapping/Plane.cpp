@@ -28,7 +28,7 @@ float Plane::area() const {
 	return std::numeric_limits<float>::infinity();
 }
 float Plane::pdf() const { return 0.0f; }
-HitInfo Plane::sample() const {
+HitInfo Plane::sample(const vec2& u) const {
 	throw std::runtime_error("Cannot sample inifinite plane");
 }
 float Plane::pdf(const vec3& pos, const vec3& wi, const Affine& transform) const {
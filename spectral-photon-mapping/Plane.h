@@ -13,6 +13,6 @@ public:
 	virtual std::vector<Interval> intersectionList(const Ray& ray) const override;
 	virtual float area() const override;
 	virtual float pdf() const override;
-	virtual HitInfo sample() const override;
+	virtual HitInfo sample(const vec2& u) const override;
 	virtual float pdf(const vec3& pos, const vec3& wi, const Affine& transform) const override;
 };
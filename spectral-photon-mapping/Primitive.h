@@ -13,12 +13,28 @@ class Primitive;
 using spPrimitive = std::shared_ptr<Primitive>;
 
 
+// Instance of a shape: shape is shared between primitives (bottom level),
+// primitive only stores transform and world bounds used by scene accelerator (top level)
 class Primitive: public Intersectable {
 public:
 	Primitive(const std::shared_ptr<Shape>& shape, const std::shared_ptr<Spectral::Material>& material, const Affine& transform)
-		:transform(transform), shape(shape), material(material) {}
+		:transform(transform), shape(shape), material(material), worldBounds(transform.transform(shape->bbox())) {}
 	virtual BBox3D bbox() const override {
-		return transform.transform(shape->bbox());
+		return worldBounds;
+	}
+	virtual BBox3D clippedBBox(const BBox3D& box) const override {
+		return intersectionOp(shape->clippedBBox(box, transform), worldBounds);
+	}
+	// scene accelerator should be rebuilt after that, shape accelerator stays untouched
+	void setTransform(const Affine& transform) {
+		this->transform = transform;
+		worldBounds = transform.transform(shape->bbox());
+	}
+	const Affine& getTransform() const {
+		return transform;
+	}
+	const std::shared_ptr<Shape>& getShape() const {
+		return shape;
 	}
 	virtual bool intersect(const Ray& ray) const override {
 		const Ray rayLocal = transform.transformInverse(ray);
@@ -43,4 +59,5 @@ protected:
 	std::shared_ptr<Shape> shape;
 	Affine transform;
 	std::shared_ptr<Spectral::Material> material;
+	BBox3D worldBounds;
 };
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "Random.h"
 
+#include <sstream>
+#include <stdexcept>
+
 float Random::random()
 {
 	return fdis(gen);
@@ -30,6 +33,21 @@ void Random::setSeed(int seed)
 	gen.seed(seed);
 }
 
+std::string Random::state()
+{
+	std::ostringstream stream;
+	stream << gen;
+	return stream.str();
+}
+
+void Random::setState(const std::string& state)
+{
+	std::istringstream stream(state);
+	stream >> gen;
+	if (stream.fail())
+		throw std::runtime_error("Invalid random generator state");
+}
+
 std::random_device Random::rd;
 std::mt19937 Random::gen = std::mt19937(Random::rd());
 std::uniform_real_distribution<float> Random::fdis(0.0f, 1.0f);
\ No newline at end of file
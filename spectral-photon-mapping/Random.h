@@ -1,5 +1,6 @@
 #pragma once
 #include <random>
+#include <string>
 
 class Random
 {
@@ -13,4 +14,7 @@ public:
 	static int random(int min, int max);
 	static int random(int max);
 	static void setSeed(int seed);
+	// textual state of generator, restoring it continues the same sequence
+	static std::string state();
+	static void setState(const std::string& state);
 };
\ No newline at end of file
@@ -5,26 +5,58 @@
 #include "Image.h"
 #include "Progress.h"
 #include "Distribution1D.h"
+#include "Sampler.h"
+#include "Timer.h"
+#include "BinaryFile.h"
+#include "SnapshotWriter.h"
+#include "Stats.h"
 
 namespace Spectral {
 	namespace SPPM {
 		vec3 toGrid(const vec3& p, const AABB& bounds, const glm::ivec3& gridRes);
 		vec3 toGridClamped(const vec3& p, const AABB& bounds, const glm::ivec3& gridRes);
 
+		// Welford's running mean and variance
+		struct RunningVariance {
+			int count = 0;
+			float mean = 0.0f;
+			float m2 = 0.0f;
+			void add(float value) {
+				count++;
+				float delta = value - mean;
+				mean += delta / count;
+				m2 += delta * (value - mean);
+			}
+			float variance() const {
+				return count > 1 ? m2 / (count - 1) : 0.0f;
+			}
+		};
+		inline float luminance(const vec3& color) {
+			return glm::dot(vec3(0.2126f, 0.7152f, 0.0722f), color);
+		}
 		struct PixelInfo {
 			float radius;
 			vec3 directLight = vec3(0.0f);
 			vec3 indirectLight = vec3(0.0f);
-			float phi = 0.0f;
+			SpectralSample phi = 0.0f;
 			float n = 0.0f;
 			int m = 0;
+			// iterations pixel took part in, direct and indirect light are averaged over them
+			int iterations = 0;
+			// luminance of estimates of single iterations
+			RunningVariance direct;
+			RunningVariance indirect;
+			// adaptive rendering skips converged pixels
+			bool converged = false;
 		};
 		struct SpectralPhoton {
 			vec3 center;
 			vec3 wi;
 			vec3 normal;
-			float power;
+			SpectralSample power;
 			const Primitive* primitive;
+			// companions were dropped on dispersive transmission
+			bool dispersed;
 			vec3 position() const {
 				return center;
 			}
@@ -33,10 +65,11 @@ namespace Spectral {
 			vec3 center;
 			PixelInfo* pi;
 			vec3 wo;
-			float luminocity;
+			SpectralSample luminocity;
 			vec3 normal;
-			Spectral::spBSDF bsdf;
+			Hero::spBSDF bsdf;
 			const Primitive* primitive;
+			bool dispersed;
 			vec3 position() const {
 				return center;
 			}
@@ -59,6 +92,105 @@ namespace Spectral {
 		const float ShadowEps = 0.001f;
 		const float OffsetEps = 0.001f;
 		float powerHeuristic(int nf, float fPdf, int ng, float gPdf);
+		// after dispersion only hero lane carries light, it has to represent whole spectrum
+		inline SpectralSample heroWeighted(const SpectralSample& value, bool dispersed) {
+			return dispersed ? value.heroOnly() : value;
+		}
+		// importance function for choosing wavelengths of iterations
+		enum class WavelengthImportance {
+			Uniform,
+			// CIE Y colour matching function
+			Luminance,
+			// CIE Y times total spectrum of scene lights
+			LuminanceLight
+		};
+		enum class RadiusReduction {
+			// SPPM, radius of each pixel shrinks with photons it gathered, so iteration depends on previous ones
+			PerPixel,
+			// PPPM, radius of iteration follows global schedule, so iterations are independent photon mapping renders
+			// whose estimates are averaged
+			// Progressive Photon Mapping: A Probabilistic Approach, Knaus and Zwicker 2011
+			Probabilistic
+		};
+		// how forward SPPM traces photon paths
+		enum class PhotonTracing {
+			// independent paths from lights
+			Uniform,
+			// Markov chain over paths reaching visibility points, mixed with uniform paths
+			// Robust Adaptive Photon Tracing using Photon Path Visibility, Hachisuka and Jensen 2011
+			AdaptiveMarkovChain
+		};
+		struct PhotonTracingStats {
+			// paths traced in iteration, for Markov chain both uniform and mutated ones
+			int traced = 0;
+			// paths reaching at least one visibility point
+			int useful = 0;
+			float mutationSize = 0.0f;
+			float acceptance = 0.0f;
+			float usefulRatio() const {
+				return traced > 0 ? float(useful) / traced : 0.0f;
+			}
+		};
+		// timing of last render, in seconds
+		struct RenderStats {
+			// completed iterations, in adaptive rendering some pixels may have less of them
+			int iterations = 0;
+			float totalTime = 0.0f;
+			// photon tracing, in forward rendering including splatting to visibility points
+			float photonTime = 0.0f;
+			// camera paths, visibility points in forward rendering and gathering in backward one
+			float cameraTime = 0.0f;
+			// search structure over visibility points or photons
+			float buildTime = 0.0f;
+			float checkpointTime = 0.0f;
+			// checkpoints are retried after next interval, previous file stays valid
+			int failedCheckpoints = 0;
+			float iterationTime() const {
+				return iterations > 0 ? (photonTime + cameraTime + buildTime) / iterations : 0.0f;
+			}
+		};
+		// photons kept by emitPhotons
+		enum class PhotonMap {
+			All,
+			// paths with only specular bounces since light
+			Caustic,
+			// paths with at least one diffuse or glossy bounce
+			Global
+		};
+		struct PhotonContribution {
+			PixelInfo* pixel;
+			SpectralSample phi;
+		};
+		// state of Markov chain photon tracing, kept across iterations
+		struct MarkovChainState {
+			PrimarySampleSampler current;
+			PrimarySampleSampler proposal;
+			// contributions of current path to visibility points of iteration
+			std::vector<PhotonContribution> currentContributions;
+			// false until a uniform path reaches visibility points
+			bool valid = false;
+			float mutationSize = 1.0f;
+			long long mutations = 0;
+			long long accepted = 0;
+			long long uniformPaths = 0;
+			long long uniformUseful = 0;
+		};
+		// what render loop carries across iterations, checkpoints store and restore it
+		struct RenderState {
+			int width = 0;
+			int height = 0;
+			// completed iterations
+			int iteration = 0;
+			// pixel iterations, compared with iterations * pixels budget
+			long long spent = 0;
+			float maxRadius = 0.0f;
+			std::vector<float> wavelengthSequence;
+			std::vector<PixelInfo> pixelInfos;
+			// empty unless caustics are separate
+			std::vector<PixelInfo> causticPixelInfos;
+			// used by forward rendering only
+			MarkovChainState chain;
+		};
 		struct Settings {
 			// todo: Not implemented
 			int threads = 8;
@@ -68,28 +200,179 @@ namespace Spectral {
 			int iterations = 200;
 			int maxDepth = 5;
 			float initialRadius = 1.0f;
+			RadiusReduction radiusReduction = RadiusReduction::PerPixel;
+			// fraction of photons kept by radius reduction
+			float alpha = 2.0f / 3.0f;
+			WavelengthImportance wavelengthImportance = WavelengthImportance::Luminance;
+			// part of uniform pdf mixed into importance, keeps weights at blue and red ends bounded
+			float wavelengthUniformFraction = 0.3f;
+			SamplerType sampler = SamplerType::Sobol;
+			PhotonTracing photonTracing = PhotonTracing::Uniform;
+			// acceptance rate of mutations adaptive mutation size is tuned to
+			float targetAcceptance = 0.234f;
+			// backward SPPM gathers caustics from their own photon map with own radius,
+			// photonsPerIteration and initialRadius are then used by global map
+			bool separateCaustics = false;
+			int causticPhotonsPerIteration = 100000;
+			float causticInitialRadius = 0.25f;
+			// pixels stop once relative standard error of their estimate is below threshold,
+			// iterations * pixels budget is then spent on other pixels, up to maxIterations each
+			bool adaptive = false;
+			float relativeErrorThreshold = 0.02f;
+			// iterations before pixel may stop, variance of fewer ones is unreliable
+			int minIterations = 16;
+			int maxIterations = 1000;
+			// if positive, render runs as many whole iterations as fit into this many seconds instead of fixed count,
+			// up to maxIterations, adaptive pixels then stop only by convergence
+			float timeBudget = 0.0f;
+			// render state is written every checkpointInterval iterations and after the last one,
+			// empty filename disables checkpoints, zero interval writes only the last one
+			std::string checkpointFilename;
+			int checkpointInterval = 0;
+			// render continues from checkpoint if its file exists, with unchanged settings bit exactly,
+			// raising iterations or lowering relativeErrorThreshold extends finished render
+			bool resume = false;
+			// render takes every streamCount-th sample index starting with streamIndex,
+			// so renders of different streams are independent and may be merged
+			int streamIndex = 0;
+			int streamCount = 1;
+			// current estimate is written to snapshotFilename every snapshotInterval iterations or snapshotSeconds,
+			// whichever comes first, zero disables either, writing happens on background thread
+			std::string snapshotFilename;
+			int snapshotInterval = 0;
+			float snapshotSeconds = 0.0f;
+			// work counters of each iteration are printed, counters of whole render are kept either way
+			bool printStatistics = false;
+		};
+		// settings estimate depends on, resumed render must have the same ones
+		struct CheckpointSettings {
+			int32_t photonsPerIteration;
+			int32_t maxDepth;
+			float initialRadius;
+			int32_t wavelengthImportance;
+			float wavelengthUniformFraction;
+			int32_t sampler;
+			int32_t photonTracing;
+			float targetAcceptance;
+			int32_t separateCaustics;
+			int32_t causticPhotonsPerIteration;
+			float causticInitialRadius;
+			int32_t adaptive;
+			int32_t streamIndex;
+			int32_t streamCount;
+			int32_t radiusReduction;
+			float alpha;
+			CheckpointSettings(const Settings& settings)
+				: photonsPerIteration(settings.photonsPerIteration), maxDepth(settings.maxDepth), initialRadius(settings.initialRadius),
+				wavelengthImportance(int32_t(settings.wavelengthImportance)), wavelengthUniformFraction(settings.wavelengthUniformFraction),
+				sampler(int32_t(settings.sampler)), photonTracing(int32_t(settings.photonTracing)), targetAcceptance(settings.targetAcceptance),
+				separateCaustics(settings.separateCaustics), causticPhotonsPerIteration(settings.causticPhotonsPerIteration),
+				causticInitialRadius(settings.causticInitialRadius), adaptive(settings.adaptive),
+				streamIndex(settings.streamIndex), streamCount(settings.streamCount),
+				radiusReduction(int32_t(settings.radiusReduction)), alpha(settings.alpha)
+			{}
+			CheckpointSettings() = default;
+			bool operator==(const CheckpointSettings& other) const {
+				return memcmp(this, &other, sizeof(CheckpointSettings)) == 0;
+			}
+		};
+		struct CheckpointHeader {
+			static const uint32_t Version = 3;
+			char magic[4];
+			uint32_t version;
+			// size of pixel structure, guards against layout changes
+			uint32_t pixelSize;
+			int32_t forward;
+			int32_t width;
+			int32_t height;
 		};
 		template<class RayTracerAccel>
 		class Tracer {
 			std::shared_ptr<Scene<RayTracerAccel>> scene;
 			std::shared_ptr<Camera> camera;
 			Settings settings;
+			// next sample index of each light, photons of one light form a single sequence across iterations
+			std::vector<uint64_t> lightSampleIndices;
+			// per iteration of last forward render
+			std::vector<PhotonTracingStats> stats;
+			RenderStats lastRenderStats;
+			// counted in this run only, they are not part of checkpoint
+			Stats::Counters lastRenderCounters;
+			// iterations of each pixel in last render
+			std::unique_ptr<Image<float>> iterationMap;
 		private:
-			float sampleLight(int index, const vec3& wo, const HitInfo& hitInfo, const std::shared_ptr<BSDF>& bsdf, float wavelength) const;
-			float sampleOneLight(const vec3& wo, const HitInfo& hitInfo, const std::shared_ptr<BSDF>& bsdf, float wavelength) const;
-			float sampleAllLights(const vec3& wo, const HitInfo& hitInfo, const std::shared_ptr<BSDF>& bsdf, float wavelength) const;
-			std::vector<SpectralPhoton> emitPhotons(float wavelength);
+			int iterationLimit() const;
+			// sample index of stream of this render
+			uint64_t streamSampleIndex(uint64_t index) const;
+			// false if rendering is out of iteration or time budget, cost of next iteration is predicted by estimate
+			bool withinBudget(long long spent, long long budget, Timer<float>& timer, float iterationEstimate) const;
+			float budgetProgress(long long spent, long long budget, Timer<float>& timer) const;
+			// running estimate of iteration cost, recent iterations weigh more as radii shrink and pixels converge
+			static float updateIterationEstimate(float estimate, float iterationTime, int iteration);
+			// adds indirect estimate of iteration, direct one is added when camera path is traced, and tests convergence
+			void finishPixelIteration(PixelInfo& pixel, float indirect) const;
+			// adds counters since iterationStart to counters of render and prints them if requested
+			void countIteration(const Stats::Counters& iterationStart, int iteration);
+			void updateConvergence(PixelInfo& pixel) const;
+			// radius of iteration in probabilistic reduction, iterations of all streams are counted
+			float probabilisticRadius(float initialRadius, int iteration) const;
+			// sets radii of iteration in probabilistic reduction, per pixel ones are left alone
+			void startIteration(RenderState& state, int iteration) const;
+			// adds flux of pixel.m photons gathered in iteration and reduces radius, returns luminance of estimate of iteration
+			float addIndirectFlux(PixelInfo& pixel, const vec3& flux, int photons) const;
+			// accumulated indirect light of pixel divided by iterations and photons behind it
+			vec3 indirectEstimate(const PixelInfo& pixel, int iterations, int photonsPerIteration) const;
+			// image estimated by pixels of state
+			void resolve(const RenderState& state, bool forward, Image<rgb>& image) const;
+			// null unless snapshots are enabled
+			std::unique_ptr<SnapshotWriter> createSnapshotWriter() const;
+			// resolves state into film of writer if snapshot is due and writer is idle
+			void snapshot(SnapshotWriter* writer, const RenderState& state, bool forward, Timer<float>& sinceLast) const;
+			// fresh state for image or state read from checkpoint if render is resumed
+			RenderState startRender(int width, int height, bool forward);
+			// writes checkpoint after iteration if it is due, returns false if writing failed
+			bool checkpoint(const RenderState& state, bool forward, bool last);
+			bool writeCheckpoint(const RenderState& state, bool forward) const;
+			// returns false if there is no checkpoint, throws if it belongs to other render
+			bool readCheckpoint(RenderState& state, int width, int height, bool forward);
+			void storeIterationCounts(const PixelInfo* pixelInfos, int width, int height);
+			// paths carry hero wavelength in lane 0 and 3 rotated companions, dispersed is set if light was reached
+			// through dispersive bsdf sample, its companions are zero then and caller weights hero with heroWeighted
+			SpectralSample sampleLight(int index, const vec3& wo, const HitInfo& hitInfo, const Hero::spBSDF& bsdf, const SpectralSample& wavelengths, Sampler& sampler, bool& dispersed) const;
+			SpectralSample sampleOneLight(const vec3& wo, const HitInfo& hitInfo, const Hero::spBSDF& bsdf, const SpectralSample& wavelengths, Sampler& sampler, bool& dispersed) const;
+			SpectralSample sampleAllLights(const vec3& wo, const HitInfo& hitInfo, const Hero::spBSDF& bsdf, const SpectralSample& wavelengths, Sampler& sampler, bool& dispersed) const;
+			// lanes refract differently on dispersive materials, so companions are dropped and path continues with hero only
+			bool isDispersiveEvent(const HitInfo& hitInfo, int sampledType, const SpectralSample& wavelengths) const;
+			WavelengthDistribution createWavelengthDistribution() const;
+			std::vector<SpectralPhoton> emitPhotons(const SpectralSample& wavelengths, Sampler& sampler, int count, PhotonMap map);
+			// traces photon path from light, splat is called with hit info, ray, intensity and dispersed flag on every hit after the first one
+			template<class Splat>
+			void tracePhoton(int lightIndex, float lightPdf, const SpectralSample& wavelengths, Sampler& sampler, const Splat& splat) const;
+			void addContributions(const std::vector<PhotonContribution>& contributions) const;
+			// caustic locator and pixel are null unless caustics are separate
+			template<class PointLocator>
+			void gather(const vec2& ndc, const SpectralSample& wavelengths, const SpectralSample& weights, const PointLocator& pointLocator, PixelInfo& pixel,
+				const PointLocator* causticLocator, PixelInfo* causticPixel, Sampler& sampler);
+			// adds photons around hit point to pixel and reduces its radius, returns luminance of estimate of this iteration
 			template<class PointLocator>
-			void gather(const vec2& ndc, float wavelength, const PointLocator& pointLocator, PixelInfo& pixel);
+			float gatherPhotons(const PointLocator& pointLocator, const HitInfo& hitInfo, const vec3& wo, const Hero::spBSDF& bsdf,
+				const SpectralSample& luminocity, bool dispersed, const SpectralSample& wavelengths, PixelInfo& pixel, int photons) const;
 		public:
 			void setScene(const spScene<RayTracerAccel>& scene);
 			void setSettings(const Settings& settings);
 			void setCamera(const std::shared_ptr<Camera>& camera);
-			std::vector<VisibilityPoint> getVisibilityPoints(int width, int height, float wavelength, PixelInfo* pixelInfos);
+			// weights are Monte Carlo weights of wavelengths, they are carried by camera paths
+			// camera path of pixel takes sample with index of iteration from sequence seeded by pixel
+			std::vector<VisibilityPoint> getVisibilityPoints(int width, int height, const SpectralSample& wavelengths, const SpectralSample& weights, PixelInfo* pixelInfos, Sampler& sampler, int iteration);
 			template<class SearchAccel, class...Params>
 			Image<rgb> renderForward(int width, int height, const std::unique_ptr<Progress>& progress, Params...params);
 			template<class PointLocator>
 			Image<rgb> renderBackward(int width, int height, const std::unique_ptr<Progress>& progress);
+			const std::vector<PhotonTracingStats>& photonTracingStats() const;
+			const Image<float>& iterationCounts() const;
+			const RenderStats& renderStats() const;
+			// work of last render, zero if counting is compiled out
+			const Stats::Counters& renderCounters() const;
 		};
 
 		template<class RayTraceAccel>
@@ -98,6 +381,8 @@ namespace Spectral {
 		}
 		template<class RayTraceAccel>
 		void Tracer<RayTraceAccel>::setSettings(const Settings& settings) {
+			if (settings.streamCount < 1 || settings.streamIndex < 0 || settings.streamIndex >= settings.streamCount)
+				throw std::runtime_error("Invalid sample stream");
 			this->settings = settings;
 		}
 		template<class RayTraceAccel>
@@ -105,35 +390,360 @@ namespace Spectral {
 			this->camera = camera;
 		}
 		template<class RayTraceAccel>
-		std::vector<VisibilityPoint> Tracer<RayTraceAccel>::getVisibilityPoints(int width, int height, float wavelength, PixelInfo* pixelInfos) {
+		const std::vector<PhotonTracingStats>& Tracer<RayTraceAccel>::photonTracingStats() const {
+			return stats;
+		}
+		template<class RayTraceAccel>
+		const Image<float>& Tracer<RayTraceAccel>::iterationCounts() const {
+			if (!iterationMap)
+				throw std::runtime_error("Nothing is rendered");
+			return *iterationMap;
+		}
+		template<class RayTraceAccel>
+		const RenderStats& Tracer<RayTraceAccel>::renderStats() const {
+			return lastRenderStats;
+		}
+		template<class RayTraceAccel>
+		const Stats::Counters& Tracer<RayTraceAccel>::renderCounters() const {
+			return lastRenderCounters;
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::countIteration(const Stats::Counters& iterationStart, int iteration) {
+			Stats::Counters counters = Stats::collect() - iterationStart;
+			lastRenderCounters += counters;
+			if (settings.printStatistics)
+				Stats::print(counters, ("Iteration " + std::to_string(iteration)).c_str());
+		}
+		template<class RayTraceAccel>
+		int Tracer<RayTraceAccel>::iterationLimit() const {
+			if (settings.timeBudget > 0.0f)
+				return settings.maxIterations;
+			return settings.adaptive ? std::max(settings.maxIterations, settings.iterations) : settings.iterations;
+		}
+		template<class RayTraceAccel>
+		uint64_t Tracer<RayTraceAccel>::streamSampleIndex(uint64_t index) const {
+			return index * uint64_t(settings.streamCount) + uint64_t(settings.streamIndex);
+		}
+		template<class RayTraceAccel>
+		bool Tracer<RayTraceAccel>::withinBudget(long long spent, long long budget, Timer<float>& timer, float iterationEstimate) const {
+			if (settings.timeBudget <= 0.0f)
+				return spent < budget;
+			// first iteration always runs, there is no estimate before it
+			return lastRenderStats.iterations == 0 || timer.elapsed() + iterationEstimate <= settings.timeBudget;
+		}
+		template<class RayTraceAccel>
+		float Tracer<RayTraceAccel>::budgetProgress(long long spent, long long budget, Timer<float>& timer) const {
+			if (settings.timeBudget <= 0.0f)
+				return float(spent) / budget;
+			return std::min(timer.elapsed() / settings.timeBudget, 1.0f);
+		}
+		template<class RayTraceAccel>
+		float Tracer<RayTraceAccel>::updateIterationEstimate(float estimate, float iterationTime, int iteration) {
+			if (iteration == 0)
+				return iterationTime;
+			const float Alpha = 0.25f;
+			// estimate is kept conservative, a single slower iteration raises it at once
+			return std::max(glm::mix(estimate, iterationTime, Alpha), iterationTime);
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::finishPixelIteration(PixelInfo& pixel, float indirect) const {
+			pixel.iterations++;
+			pixel.indirect.add(indirect);
+			updateConvergence(pixel);
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::updateConvergence(PixelInfo& pixel) const {
+			pixel.converged = false;
+			if (!settings.adaptive || pixel.iterations < settings.minIterations)
+				return;
+			// terms are estimated from different samples, so their variances add up
+			float error = std::sqrt((pixel.direct.variance() + pixel.indirect.variance()) / pixel.iterations);
+			pixel.converged = error <= settings.relativeErrorThreshold * (pixel.direct.mean + pixel.indirect.mean);
+		}
+		template<class RayTraceAccel>
+		float Tracer<RayTraceAccel>::probabilisticRadius(float initialRadius, int iteration) const {
+			// r_(i+1)^2 = r_i^2 (i + alpha) / (i + 1), product of factors of all previous iterations written with gamma functions,
+			// their logarithms are large, so difference is taken in double precision
+			double n = double(streamSampleIndex(iteration));
+			double alpha = settings.alpha;
+			return initialRadius * float(std::sqrt(std::exp(std::lgamma(n + 1.0 + alpha) - std::lgamma(1.0 + alpha) - std::lgamma(n + 2.0))));
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::startIteration(RenderState& state, int iteration) const {
+			if (settings.radiusReduction != RadiusReduction::Probabilistic)
+				return;
+			state.maxRadius = probabilisticRadius(settings.initialRadius, iteration);
+			for (auto& pixel : state.pixelInfos)
+				pixel.radius = state.maxRadius;
+			float causticRadius = probabilisticRadius(settings.causticInitialRadius, iteration);
+			for (auto& pixel : state.causticPixelInfos)
+				pixel.radius = causticRadius;
+		}
+		template<class RayTraceAccel>
+		float Tracer<RayTraceAccel>::addIndirectFlux(PixelInfo& pixel, const vec3& flux, int photons) const {
+			float density = 1.0f / (photons * pixel.radius * pixel.radius * glm::pi<float>());
+			if (settings.radiusReduction == RadiusReduction::Probabilistic) {
+				pixel.indirectLight += flux * density;
+				return luminance(flux) * density;
+			}
+			if (pixel.m != 0) {
+				float newN = pixel.n + settings.alpha * pixel.m;
+				float newRadius = pixel.radius * std::sqrt(newN / glm::max(pixel.n + pixel.m, 1.0f));
+				pixel.indirectLight = (pixel.indirectLight + flux) * (newRadius * newRadius) / (pixel.radius * pixel.radius);
+				pixel.radius = newRadius;
+				pixel.n = newN;
+			}
+			return luminance(flux) * density;
+		}
+		template<class RayTraceAccel>
+		vec3 Tracer<RayTraceAccel>::indirectEstimate(const PixelInfo& pixel, int iterations, int photonsPerIteration) const {
+			float count = std::max(iterations, 1);
+			// probabilistic reduction accumulates radiance estimates of iterations
+			if (settings.radiusReduction == RadiusReduction::Probabilistic)
+				return pixel.indirectLight / count;
+			float N = std::max(count * photonsPerIteration, 1.0f);
+			return pixel.indirectLight / (N * pixel.radius * pixel.radius * glm::pi<float>());
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::resolve(const RenderState& state, bool forward, Image<rgb>& image) const {
+			// chain estimates flux over visible paths only, uniform proposals measure their part of path space
+			float visibleFraction = 1.0f;
+			const MarkovChainState& chain = state.chain;
+			if (forward && settings.photonTracing == PhotonTracing::AdaptiveMarkovChain)
+				visibleFraction = chain.uniformPaths > 0 ? float(chain.uniformUseful) / chain.uniformPaths : 0.0f;
+			for (int j = 0; j < state.height; j++) {
+				for (int i = 0; i < state.width; i++) {
+					const PixelInfo& pixelInfo = state.pixelInfos[i + j * state.width];
+					float iterations = std::max(pixelInfo.iterations, 1);
+					image(i, j) = pixelInfo.directLight / iterations +
+						visibleFraction * indirectEstimate(pixelInfo, pixelInfo.iterations, settings.photonsPerIteration);
+					// caustic pixels take part in iterations of their pixels
+					if (!state.causticPixelInfos.empty())
+						image(i, j) += indirectEstimate(state.causticPixelInfos[i + j * state.width], pixelInfo.iterations, settings.causticPhotonsPerIteration);
+				}
+			}
+		}
+		template<class RayTraceAccel>
+		std::unique_ptr<SnapshotWriter> Tracer<RayTraceAccel>::createSnapshotWriter() const {
+			if (settings.snapshotFilename.empty() || (settings.snapshotInterval <= 0 && settings.snapshotSeconds <= 0.0f))
+				return nullptr;
+			return std::make_unique<SnapshotWriter>(settings.snapshotFilename);
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::snapshot(SnapshotWriter* writer, const RenderState& state, bool forward, Timer<float>& sinceLast) const {
+			if (!writer)
+				return;
+			bool due = (settings.snapshotInterval > 0 && state.iteration % settings.snapshotInterval == 0) ||
+				(settings.snapshotSeconds > 0.0f && sinceLast.elapsed() >= settings.snapshotSeconds);
+			// busy writer means disk is slower than snapshots, this one is skipped rather than waited for
+			if (!due || !writer->idle())
+				return;
+			resolve(state, forward, writer->film(state.width, state.height));
+			writer->submit();
+			sinceLast.restart();
+		}
+		template<class RayTraceAccel>
+		RenderState Tracer<RayTraceAccel>::startRender(int width, int height, bool forward) {
+			RenderState state;
+			lastRenderCounters = Stats::Counters();
+			if (!settings.resume || !readCheckpoint(state, width, height, forward)) {
+				state.width = width;
+				state.height = height;
+				state.maxRadius = settings.initialRadius;
+				state.pixelInfos.resize(width * height);
+				for (auto& pixel : state.pixelInfos)
+					pixel.radius = settings.initialRadius;
+				if (!forward && settings.separateCaustics) {
+					state.causticPixelInfos.resize(width * height);
+					for (auto& pixel : state.causticPixelInfos)
+						pixel.radius = settings.causticInitialRadius;
+				}
+				lightSampleIndices.assign(scene->numLights(), 0);
+				stats.clear();
+				lastRenderStats = RenderStats();
+			}
+			// extended render gets strata of its own for new iterations
+			int missing = iterationLimit() - int(state.wavelengthSequence.size());
+			if (missing > 0) {
+				std::vector<float> sequence = Sampling::stratifiedSequence(missing);
+				state.wavelengthSequence.insert(state.wavelengthSequence.end(), sequence.begin(), sequence.end());
+			}
+			return state;
+		}
+		template<class RayTraceAccel>
+		bool Tracer<RayTraceAccel>::checkpoint(const RenderState& state, bool forward, bool last) {
+			if (settings.checkpointFilename.empty())
+				return true;
+			if (!last && (settings.checkpointInterval <= 0 || state.iteration % settings.checkpointInterval != 0))
+				return true;
+			Timer<float> timer;
+			bool written = writeCheckpoint(state, forward);
+			if (!written)
+				lastRenderStats.failedCheckpoints++;
+			lastRenderStats.checkpointTime += timer.elapsed();
+			return written;
+		}
+		// Layout: header, settings, loop counters, then arrays with element counts, stats and random generator state
+		// Pixels are written as they are in memory, checkpoints are not portable between builds
+		template<class RayTraceAccel>
+		bool Tracer<RayTraceAccel>::writeCheckpoint(const RenderState& state, bool forward) const {
+			BinaryWriter writer(settings.checkpointFilename);
+			CheckpointHeader header;
+			memcpy(header.magic, "SPPM", sizeof(header.magic));
+			header.version = CheckpointHeader::Version;
+			header.pixelSize = sizeof(PixelInfo);
+			header.forward = forward;
+			header.width = state.width;
+			header.height = state.height;
+			writer.write(header);
+			writer.write(CheckpointSettings(settings));
+			writer.write(int32_t(state.iteration));
+			writer.write(int64_t(state.spent));
+			writer.write(state.maxRadius);
+			writer.writeVector(state.wavelengthSequence);
+			writer.writeVector(state.pixelInfos);
+			writer.writeVector(state.causticPixelInfos);
+			writer.writeVector(lightSampleIndices);
+			const MarkovChainState& chain = state.chain;
+			writer.writeVector(chain.current.primarySamples());
+			writer.write(int32_t(chain.valid));
+			writer.write(chain.mutationSize);
+			writer.write(int64_t(chain.mutations));
+			writer.write(int64_t(chain.accepted));
+			writer.write(int64_t(chain.uniformPaths));
+			writer.write(int64_t(chain.uniformUseful));
+			writer.writeVector(stats);
+			writer.write(lastRenderStats);
+			writer.writeString(Random::state());
+			return writer.commit();
+		}
+		template<class RayTraceAccel>
+		bool Tracer<RayTraceAccel>::readCheckpoint(RenderState& state, int width, int height, bool forward) {
+			std::unique_ptr<BinaryReader> reader;
+			try {
+				reader = std::make_unique<BinaryReader>(settings.checkpointFilename);
+			}
+			catch (const std::runtime_error&) {
+				return false;
+			}
+			CheckpointHeader header = reader->read<CheckpointHeader>();
+			if (memcmp(header.magic, "SPPM", sizeof(header.magic)) != 0 || header.version != CheckpointHeader::Version ||
+				header.pixelSize != sizeof(PixelInfo))
+				throw std::runtime_error("Unsupported checkpoint " + settings.checkpointFilename);
+			if (header.forward != int32_t(forward) || header.width != width || header.height != height ||
+				!(reader->read<CheckpointSettings>() == CheckpointSettings(settings)))
+				throw std::runtime_error("Checkpoint " + settings.checkpointFilename + " belongs to other render");
+			state.width = width;
+			state.height = height;
+			state.iteration = reader->read<int32_t>();
+			state.spent = reader->read<int64_t>();
+			state.maxRadius = reader->read<float>();
+			state.wavelengthSequence = reader->readVector<float>();
+			state.pixelInfos = reader->readVector<PixelInfo>();
+			state.causticPixelInfos = reader->readVector<PixelInfo>();
+			std::vector<uint64_t> indices = reader->readVector<uint64_t>();
+			if (state.pixelInfos.size() != size_t(width * height) || indices.size() != scene->numLights())
+				throw std::runtime_error("Checkpoint " + settings.checkpointFilename + " belongs to other render");
+			MarkovChainState& chain = state.chain;
+			chain.current.setPrimarySamples(reader->readVector<float>());
+			chain.valid = reader->read<int32_t>() != 0;
+			chain.mutationSize = reader->read<float>();
+			chain.mutations = reader->read<int64_t>();
+			chain.accepted = reader->read<int64_t>();
+			chain.uniformPaths = reader->read<int64_t>();
+			chain.uniformUseful = reader->read<int64_t>();
+			std::vector<PhotonTracingStats> iterationStats = reader->readVector<PhotonTracingStats>();
+			RenderStats renderStats = reader->read<RenderStats>();
+			std::string randomState = reader->readString();
+			// nothing is changed until whole file is read
+			Random::setState(randomState);
+			lightSampleIndices = std::move(indices);
+			stats = std::move(iterationStats);
+			lastRenderStats = renderStats;
+			// threshold may be changed to extend render
+			for (auto& pixel : state.pixelInfos)
+				updateConvergence(pixel);
+			return true;
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::storeIterationCounts(const PixelInfo* pixelInfos, int width, int height) {
+			iterationMap = std::make_unique<Image<float>>(width, height, 0.0f);
+			for (int j = 0; j < height; j++)
+				for (int i = 0; i < width; i++)
+					(*iterationMap)(i, j) = float(pixelInfos[i + j * width].iterations);
+		}
+		template<class RayTraceAccel>
+		bool Tracer<RayTraceAccel>::isDispersiveEvent(const HitInfo& hitInfo, int sampledType, const SpectralSample& wavelengths) const {
+			return (sampledType & BxDF::Transmission) && hitInfo.primitive->getMaterial()->isDispersive(hitInfo, wavelengths);
+		}
+		template<class RayTraceAccel>
+		WavelengthDistribution Tracer<RayTraceAccel>::createWavelengthDistribution() const {
+			float min = Config::get().spectrumMin();
+			float max = Config::get().spectrumMax();
+			std::function<float(float)> importance;
+			switch (settings.wavelengthImportance) {
+			case WavelengthImportance::Uniform:
+				importance = [](float wavelength) { return 1.0f; };
+				break;
+			case WavelengthImportance::Luminance:
+				importance = [](float wavelength) { return wavelengthToXYZ(wavelength).y; };
+				break;
+			case WavelengthImportance::LuminanceLight:
+				importance = [this](float wavelength) {
+					float power = 0.0f;
+					for (int i = 0; i < scene->numLights(); ++i)
+						power += scene->light(i)->power(wavelength);
+					return wavelengthToXYZ(wavelength).y * power;
+				};
+				break;
+			}
+			// normalize importance by its mean, so uniform part has known proportion
+			const int Samples = 300;
+			float mean = 0.0f;
+			for (int i = 0; i < Samples; ++i)
+				mean += importance(glm::mix(min, max, (i + 0.5f) / Samples)) / Samples;
+			float fraction = mean > 0.0f ? settings.wavelengthUniformFraction : 1.0f;
+			return WavelengthDistribution(min, max, [&](float wavelength) {
+				return (1.0f - fraction) * importance(wavelength) / glm::max(mean, 1e-20f) + fraction;
+			}, Samples);
+		}
+		template<class RayTraceAccel>
+		std::vector<VisibilityPoint> Tracer<RayTraceAccel>::getVisibilityPoints(int width, int height, const SpectralSample& wavelengths, const SpectralSample& weights, PixelInfo* pixelInfos, Sampler& sampler, int iteration) {
 			vec2 resolution(width, height);
 			std::vector<VisibilityPoint> visibilityPoints;
 			visibilityPoints.reserve(width * height);
 			for (int j = 0; j < height; j++) {
 				for (int i = 0; i < width; i++) {
-					vec2 aaShift = Sampling::uniformDisk(1.0f);
+					PixelInfo& pi = pixelInfos[i + j * width];
+					if (pi.converged)
+						continue;
+					sampler.startSample(streamSampleIndex(iteration), uint32_t(i + j * width));
+					vec2 aaShift = Sampling::uniformDisk(1.0f, sampler.get2D());
 					vec2 ndc = (2.0f * vec2(i, j) + aaShift - resolution + vec2(1.0f)) / resolution;
-					float luminocity = 1.0f;
-					Ray ray = camera->generateRay(ndc);
+					SpectralSample luminocity = weights;
+					SpectralSample directLight = 0.0f;
+					Ray ray = camera->generateRay(ndc, sampler.get2D());
 					bool specularBounce = false;
-					float phi = 0.0f;
-					PixelInfo& pi = pixelInfos[i + j * width];
+					bool dispersed = false;
 					for (int depth = 0; depth < settings.maxDepth; depth++)
 					{
 						HitInfo hitInfo;
 						if (!scene->intersect(ray, hitInfo)) {
 							for (int i = 0; i < scene->numLights(); ++i)
-								pi.directLight += wavelengthToRGB(wavelength, luminocity * scene->light(i)->lightEmitted(ray, wavelength));
+								directLight += heroWeighted(luminocity * scene->light(i)->lightEmitted(ray, wavelengths), dispersed);
 							break;
 						}
 						vec3 wo = -ray.rd;
 						if (depth == 0 || specularBounce)
-							pi.directLight += wavelengthToRGB(wavelength, luminocity * hitInfo.lightEmitted(wo, wavelength));
+							directLight += heroWeighted(luminocity * hitInfo.lightEmitted(wo, wavelengths), dispersed);
 						if (!hitInfo.primitive) {
 							break;
 						}
-						std::shared_ptr<Spectral::BSDF> bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelength);
-						pi.directLight += wavelengthToRGB(wavelength, luminocity * sampleOneLight(wo, hitInfo, bsdf, wavelength));
+						Hero::spBSDF bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelengths);
+						STATS_INC(BSDFCalls);
+						bool lightDispersed;
+						SpectralSample ld = sampleOneLight(wo, hitInfo, bsdf, wavelengths, sampler, lightDispersed);
+						directLight += heroWeighted(luminocity * ld, dispersed || lightDispersed);
 
 						bool isDiffuse = bsdf->hasType(BxDF::Diffuse);
 						bool isGlossy = bsdf->hasType(BxDF::Glossy);
@@ -146,7 +756,8 @@ namespace Spectral {
 								luminocity,
 								hitInfo.normal,
 								bsdf,
-								hitInfo.primitive });
+								hitInfo.primitive,
+								dispersed });
 							break;
 						}
 						// bounce ray
@@ -154,16 +765,23 @@ namespace Spectral {
 							float pdf;
 							vec3 wi;
 							int type;
-							float f = bsdf->sampleF(wo, wi, hitInfo.normal, pdf, BxDF::All, type);
-							if (f == 0.0f || pdf == 0.0f)
+							SpectralSample f = bsdf->sampleF(wo, wi, hitInfo.normal, sampler.get2D(), pdf, BxDF::All, type);
+							if (f.isBlack() || pdf == 0.0f)
 								break;
 							specularBounce = (type & BxDF::Specular);
 							luminocity *= f * glm::abs(glm::dot(wi, hitInfo.normal)) / pdf;
-							if (luminocity == 0.0f)
+							if (!dispersed && isDispersiveEvent(hitInfo, type, wavelengths)) {
+								dispersed = true;
+								luminocity = SpectralSample(luminocity[0], 0.0f, 0.0f, 0.0f);
+							}
+							if (luminocity.isBlack())
 								break;
 							ray = Ray(hitInfo.globalPosition, wi);
 						}
 					}
+					vec3 direct = wavelengthToRGB(wavelengths, directLight);
+					pi.directLight += direct;
+					pi.direct.add(luminance(direct));
 				}
 			}
 			return visibilityPoints;
@@ -171,15 +789,33 @@ namespace Spectral {
 		template<class RayTraceAccel>
 		template<class SearchAccel, class...Params>
 		Image<rgb> Tracer<RayTraceAccel>::renderForward(int width, int height, const std::unique_ptr<Progress>& progress, Params...params) {
-			std::unique_ptr<PixelInfo[]> pixelInfos(new PixelInfo[width * height]);
-			for (int i = 0; i < width * height; i++)
-				pixelInfos[i].radius = settings.initialRadius;
+			WavelengthDistribution wavelengthDistribution = createWavelengthDistribution();
+			RenderState state = startRender(width, height, true);
+			std::vector<PixelInfo>& pixelInfos = state.pixelInfos;
+			float& maxRadius = state.maxRadius;
+			const std::vector<float>& wavelengthSequence = state.wavelengthSequence;
+			std::unique_ptr<Sampler> sampler = Sampler::create(settings.sampler);
+			MarkovChainState& chain = state.chain;
+			// pixel iterations left, adaptive rendering spends iterations of converged pixels on others
+			const long long budget = (long long)settings.iterations * width * height;
+			long long& spent = state.spent;
+			// resumed render adds time of this run to time of previous ones
+			const float previousTime = lastRenderStats.totalTime;
+			Timer<float> renderTimer;
+			Timer<float> phaseTimer;
+			float iterationEstimate = 0.0f;
+			std::unique_ptr<SnapshotWriter> snapshotWriter = createSnapshotWriter();
+			Timer<float> sinceSnapshot;
+			for (int k = state.iteration; k < iterationLimit() && withinBudget(spent, budget, renderTimer, iterationEstimate); k++) {
+				phaseTimer.restart();
+				float iterationStart = renderTimer.elapsed();
+				Stats::Counters iterationCounters = Stats::collect();
+				startIteration(state, k);
+				SpectralSample weights;
+				SpectralSample wavelengths = wavelengthDistribution.sampleHero(wavelengthSequence[k], weights);
 
-			float maxRadius = settings.initialRadius;
-			for (int k = 0; k < settings.iterations; k++) {
-				float wavelength = Random::random(Config::get().spectrumMin(), Config::get().spectrumMax());
-
-				std::vector<VisibilityPoint> visibilityPoints = getVisibilityPoints(width, height, wavelength, pixelInfos.get());
+				std::vector<VisibilityPoint> visibilityPoints = getVisibilityPoints(width, height, wavelengths, weights, pixelInfos.data(), *sampler, k);
+				lastRenderStats.cameraTime += phaseTimer.elapsedAndRestart();
 //#define GRID
 #ifndef GRID
 				SearchAccel searchAccel(visibilityPoints.begin(), visibilityPoints.end(), params...);
@@ -222,109 +858,157 @@ namespace Spectral {
 					}
 				}
 #endif
-				Distribution1D lightPowerDistribution = scene->computeSpectralLightPowerDistribution(wavelength);
-				for (int i = 0; i < settings.photonsPerIteration; ++i) {
-					// choose light
-					float lightPdf = 0.0f;
-					int lightIndex = lightPowerDistribution.sampleDiscrete(Random::random(), lightPdf);
-					float pdfPos;
-					float pdfDir;
-					Ray ray;
-					vec3 lightNormal;
-					float le = scene->light(lightIndex)->sampleLe(ray, lightNormal, pdfPos, pdfDir, wavelength);
-					if (le == 0.0f || pdfPos == 0.0f || pdfDir == 0.0f)
-						continue;
-					float intensity = glm::abs(glm::dot(lightNormal, ray.rd)) * le / (lightPdf * pdfPos * pdfDir);
-					if (intensity == 0.0f)
-						continue;
-					for (int depth = 0; depth < settings.maxDepth; depth++)
-					{
-						HitInfo hitInfo;
-						if (!scene->intersect(ray, hitInfo))
-							break;
-						if (!hitInfo.primitive) {
-							break;
-						}
-						if (depth > 0) {
+				lastRenderStats.buildTime += phaseTimer.elapsedAndRestart();
+				// contributions of last traced path, chosen path adds them to pixels
+				std::vector<PhotonContribution> contributions;
+				auto splat = [&](const HitInfo& hitInfo, const Ray& ray, const SpectralSample& intensity, bool dispersed) {
+					size_t accepted = contributions.size();
 #ifndef GRID
-							std::vector<int> indices = searchAccel.intersectedIndicies(hitInfo.globalPosition);
-							for (auto index : indices) {
-								const VisibilityPoint& vp = visibilityPoints[index];
-								if (glm::length2(vp.center - hitInfo.globalPosition) > vp.pi->radius * vp.pi->radius || glm::dot(hitInfo.normal, vp.normal) < 0.0
-									|| hitInfo.primitive != vp.primitive) {
-									continue;
-								}
-								vp.pi->phi += vp.luminocity * intensity * vp.bsdf->f(vp.wo, -ray.rd, hitInfo.normal, BxDF::Type::All);
-								vp.pi->m++;
-							}
+					std::vector<int> indices = searchAccel.intersectedIndicies(hitInfo.globalPosition);
+					STATS_INC(PointQueries);
+					STATS_ADD(GatherCandidates, indices.size());
+					for (auto index : indices) {
+						const VisibilityPoint& vp = visibilityPoints[index];
+						if (glm::length2(vp.center - hitInfo.globalPosition) > vp.pi->radius * vp.pi->radius || glm::dot(hitInfo.normal, vp.normal) < 0.0
+							|| hitInfo.primitive != vp.primitive) {
+							continue;
+						}
+						contributions.push_back(PhotonContribution{ vp.pi,
+							heroWeighted(vp.luminocity * intensity * vp.bsdf->f(vp.wo, -ray.rd, hitInfo.normal, BxDF::Type::All), vp.dispersed || dispersed) });
+					}
 #else
-							glm::ivec3 index = toGrid(hitInfo.globalPosition, gridBounds, gridRes);
-							int node = -1;
-							if (index.x < 0 || index.y < 0 || index.z < 0 || index.x >= gridRes.x || index.y >= gridRes.y || index.z >= gridRes.z)
-								node = -1;
-							else
-								node = grid[toIndex(index.x, index.y, index.z)];
-							while (node != -1) {
-								auto& nodeRef = nodes[node];
-								VisibilityPoint& vp = *(nodeRef.vp);
-								if (glm::length2(vp.center - hitInfo.globalPosition) > vp.pi->radius * vp.pi->radius || glm::dot(hitInfo.normal, vp.normal) < 0.0
-									|| hitInfo.primitive != vp.primitive) {
-									node = nodeRef.next;
-									continue;
-								}
-								vp.pi->phi += vp.luminocity * intensity * vp.bsdf->f(vp.wo, -ray.rd, hitInfo.normal, BxDF::Type::All);
-								vp.pi->m++;
-								node = nodeRef.next;
-							}
+					glm::ivec3 index = toGrid(hitInfo.globalPosition, gridBounds, gridRes);
+					STATS_INC(PointQueries);
+					uint64_t candidates = 0;
+					int node = -1;
+					if (index.x < 0 || index.y < 0 || index.z < 0 || index.x >= gridRes.x || index.y >= gridRes.y || index.z >= gridRes.z)
+						node = -1;
+					else
+						node = grid[toIndex(index.x, index.y, index.z)];
+					while (node != -1) {
+						auto& nodeRef = nodes[node];
+						VisibilityPoint& vp = *(nodeRef.vp);
+						candidates++;
+						if (glm::length2(vp.center - hitInfo.globalPosition) > vp.pi->radius * vp.pi->radius || glm::dot(hitInfo.normal, vp.normal) < 0.0
+							|| hitInfo.primitive != vp.primitive) {
+							node = nodeRef.next;
+							continue;
+						}
+						contributions.push_back(PhotonContribution{ vp.pi,
+							heroWeighted(vp.luminocity * intensity * vp.bsdf->f(vp.wo, -ray.rd, hitInfo.normal, BxDF::Type::All), vp.dispersed || dispersed) });
+						node = nodeRef.next;
+					}
+					STATS_ADD(GatherCandidates, candidates);
 #endif
+					STATS_ADD(GatherAccepted, contributions.size() - accepted);
+				};
+				PhotonTracingStats iterationStats;
+				// scales flux of iteration to photonsPerIteration paths
+				float chainScale = 1.0f;
+				if (settings.photonTracing == PhotonTracing::Uniform) {
+					float lightOffset = Random::random();
+					for (int i = 0; i < settings.photonsPerIteration; ++i) {
+						// evenly spaced values give each light a nearly fixed share of photons
+						float lightPdf = 0.0f;
+						int lightIndex = scene->sampleLight(wavelengths, (i + lightOffset) / settings.photonsPerIteration, lightPdf);
+						// seeds of photon paths are complemented, so they differ from seeds of pixels
+						sampler->startSample(streamSampleIndex(lightSampleIndices[lightIndex]++), ~uint32_t(lightIndex));
+						contributions.clear();
+						tracePhoton(lightIndex, lightPdf, wavelengths, *sampler, splat);
+						iterationStats.traced++;
+						if (!contributions.empty())
+							iterationStats.useful++;
+						addContributions(contributions);
+					}
+				}
+				else {
+					// light is chosen by first value, so mutations may move path to another light
+					auto tracePath = [&](PrimarySampleSampler& path) {
+						contributions.clear();
+						float lightPdf = 0.0f;
+						int lightIndex = scene->sampleLight(wavelengths, path.get1D(), lightPdf);
+						tracePhoton(lightIndex, lightPdf, wavelengths, path, splat);
+						iterationStats.traced++;
+						if (contributions.empty())
+							return false;
+						iterationStats.useful++;
+						return true;
+					};
+					// visibility points are new, so current path may not reach any of them
+					if (chain.valid) {
+						chain.current.startSample(0, 0);
+						chain.valid = tracePath(chain.current);
+						std::swap(chain.currentContributions, contributions);
+					}
+					int chainSteps = 0;
+					for (int i = 0; i < settings.photonsPerIteration; ++i) {
+						// uniform proposal keeps chain ergodic and measures visible part of path space
+						chain.proposal.clear();
+						chain.uniformPaths++;
+						if (tracePath(chain.proposal)) {
+							chain.uniformUseful++;
+							std::swap(chain.current, chain.proposal);
+							std::swap(chain.currentContributions, contributions);
+							chain.valid = true;
+						}
+						else if (chain.valid) {
+							chain.proposal.mutate(chain.current, chain.mutationSize);
+							chain.mutations++;
+							// target is uniform over visible paths and mutation is symmetric, so visible proposal is always accepted
+							if (tracePath(chain.proposal)) {
+								chain.accepted++;
+								std::swap(chain.current, chain.proposal);
+								std::swap(chain.currentContributions, contributions);
+							}
+							float acceptance = float(chain.accepted) / chain.mutations;
+							chain.mutationSize = glm::clamp(chain.mutationSize + (acceptance - settings.targetAcceptance) / chain.mutations, 1e-4f, 1.0f);
+						}
+						if (chain.valid) {
+							addContributions(chain.currentContributions);
+							chainSteps++;
 						}
-						float pdf;
-						vec3 wo;
-						int sampledType;
-						std::shared_ptr<Spectral::BSDF> bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelength);
-						float lightOut = bsdf->sampleF(-ray.rd, wo, hitInfo.normal, pdf, BxDF::All, sampledType, false);
-						if (lightOut == 0.0f || pdf == 0.0f)
-							break;
-						float newIntensity = intensity * lightOut * glm::abs(glm::dot(wo, hitInfo.normal)) / pdf;
-						float q = glm::max(0.0f, 1.0f - newIntensity / intensity);
-						if (Random::random() < q)
-							break;
-						intensity = newIntensity / (1.0f - q);
-						ray.ro = hitInfo.globalPosition;
-						ray.rd = wo;
-						if (intensity == 0.0f)
-							break;
 					}
+					chainScale = chainSteps > 0 ? float(settings.photonsPerIteration) / chainSteps : 0.0f;
+					iterationStats.mutationSize = chain.mutationSize;
+					iterationStats.acceptance = chain.mutations > 0 ? float(chain.accepted) / chain.mutations : 0.0f;
 				}
+				stats.push_back(iterationStats);
+				lastRenderStats.photonTime += phaseTimer.elapsedAndRestart();
 				maxRadius = 0.0f;
+				int active = 0;
 				// change visibility points data
 				for (int i = 0; i < width * height; ++i) {
 					PixelInfo& pi = pixelInfos[i];
-					if (pi.m != 0) {
-						const float Gamma = 2.0f / 3.0f;
-						float newN = pi.n + Gamma * pi.m;
-						float newRadius = pi.radius * std::sqrt(newN / glm::max(pi.n + pi.m, 1.0f));
-						pi.indirectLight = (pi.indirectLight + wavelengthToRGB(wavelength, pi.phi)) * (newRadius * newRadius) / (pi.radius * pi.radius);
-						pi.radius = newRadius;
-						pi.n = newN;
+					if (pi.converged) {
+						maxRadius = std::max(maxRadius, pi.radius);
+						continue;
 					}
+					active++;
+					vec3 flux = wavelengthToRGB(wavelengths, pi.phi * chainScale);
+					float indirect = addIndirectFlux(pi, flux, settings.photonsPerIteration);
 					pi.m = 0;
 					pi.phi = 0.0f;
 					maxRadius = std::max(maxRadius, pi.radius);
+					finishPixelIteration(pi, indirect);
 				}
-				progress->emitProgress(float(k) / settings.iterations);
+				spent += active;
+				countIteration(iterationCounters, k);
+				if (active == 0)
+					break;
+				lastRenderStats.photonTime += phaseTimer.elapsed();
+				lastRenderStats.iterations++;
+				iterationEstimate = updateIterationEstimate(iterationEstimate, renderTimer.elapsed() - iterationStart, k);
+				state.iteration = k + 1;
+				lastRenderStats.totalTime = previousTime + renderTimer.elapsed();
+				checkpoint(state, true, false);
+				snapshot(snapshotWriter.get(), state, true, sinceSnapshot);
+				progress->emitProgress(budgetProgress(spent, budget, renderTimer));
 			}
+			lastRenderStats.totalTime = previousTime + renderTimer.elapsed();
+			checkpoint(state, true, true);
+			storeIterationCounts(pixelInfos.data(), width, height);
 			Image<rgb> image(width, height, rgb(0.0));
-			for (int j = 0; j < height; j++)
-			{
-				for (int i = 0; i < width; i++)
-				{
-					float N = std::max(settings.iterations * settings.photonsPerIteration, 1);
-					const PixelInfo& pixelInfo = pixelInfos[i + j * width];
-					image(i, j) = pixelInfo.directLight / settings.iterations +
-						pixelInfo.indirectLight / (N * pixelInfo.radius * pixelInfo.radius * glm::pi<float>());
-				}
-			}
+			resolve(state, true, image);
 			progress->emitProgress(1.0f);
 			return image;
 		}
@@ -332,52 +1016,94 @@ namespace Spectral {
 		template<class PointLocator>
 		Image<rgb> Tracer<RayTraceAccel>::renderBackward(int width, int height, const std::unique_ptr<Progress>& progress) {
 			Image<rgb> image(width, height, rgb(0.0));
-			std::unique_ptr<PixelInfo[]> pixelInfos(new PixelInfo[width * height]);
-			for (int i = 0; i < width*height; i++)
-				pixelInfos[i].radius = settings.initialRadius;
-
 			vec2 resolution(width, height);
-			for (int k = 0; k < settings.iterations; k++) {
-				//float wavelength = Random::random(400.f, 700.f);
-				// stratified sampling
-				float wavelength = glm::mix(Config::get().spectrumMin(), Config::get().spectrumMax(), Sampling::uniformStratified(60));
-				std::vector<SpectralPhoton> photons = emitPhotons(wavelength);
+			WavelengthDistribution wavelengthDistribution = createWavelengthDistribution();
+			RenderState state = startRender(width, height, false);
+			std::vector<PixelInfo>& pixelInfos = state.pixelInfos;
+			std::vector<PixelInfo>& causticPixelInfos = state.causticPixelInfos;
+			// iterations take strata in random order, so stopping early still covers spectrum evenly
+			const std::vector<float>& wavelengthSequence = state.wavelengthSequence;
+			std::unique_ptr<Sampler> sampler = Sampler::create(settings.sampler);
+			// pixel iterations left, adaptive rendering spends iterations of converged pixels on others
+			const long long budget = (long long)settings.iterations * width * height;
+			long long& spent = state.spent;
+			// resumed render adds time of this run to time of previous ones
+			const float previousTime = lastRenderStats.totalTime;
+			Timer<float> renderTimer;
+			Timer<float> phaseTimer;
+			float iterationEstimate = 0.0f;
+			std::unique_ptr<SnapshotWriter> snapshotWriter = createSnapshotWriter();
+			Timer<float> sinceSnapshot;
+			for (int k = state.iteration; k < iterationLimit() && withinBudget(spent, budget, renderTimer, iterationEstimate); k++) {
+				phaseTimer.restart();
+				float iterationStart = renderTimer.elapsed();
+				Stats::Counters iterationCounters = Stats::collect();
+				startIteration(state, k);
+				SpectralSample weights;
+				SpectralSample wavelengths = wavelengthDistribution.sampleHero(wavelengthSequence[k], weights);
+				std::vector<SpectralPhoton> photons = emitPhotons(wavelengths, *sampler, settings.photonsPerIteration,
+					settings.separateCaustics ? PhotonMap::Global : PhotonMap::All);
+				std::vector<SpectralPhoton> causticPhotons;
+				if (settings.separateCaustics)
+					causticPhotons = emitPhotons(wavelengths, *sampler, settings.causticPhotonsPerIteration, PhotonMap::Caustic);
+				lastRenderStats.photonTime += phaseTimer.elapsedAndRestart();
 				PointLocator pointLocator(photons.begin(), photons.end(), 1, 8);
+				std::unique_ptr<PointLocator> causticLocator;
+				if (settings.separateCaustics)
+					causticLocator = std::make_unique<PointLocator>(causticPhotons.begin(), causticPhotons.end(), 1, 8);
+				lastRenderStats.buildTime += phaseTimer.elapsedAndRestart();
+				int active = 0;
 				for (int j = 0; j < height; j++) {
 					for (int i = 0; i < width; i++) {
-						vec2 aaShift = Sampling::uniformDisk(1.0f);
+						if (pixelInfos[i + j * width].converged)
+							continue;
+						active++;
+						sampler->startSample(streamSampleIndex(k), uint32_t(i + j * width));
+						vec2 aaShift = Sampling::uniformDisk(1.0f, sampler->get2D());
 						vec2 ndc = (2.0f * vec2(i, j) + aaShift - resolution + vec2(1.0f)) / resolution;
-						gather<PointLocator>(ndc, wavelength, pointLocator, pixelInfos[i + j * width]);
+						gather<PointLocator>(ndc, wavelengths, weights, pointLocator, pixelInfos[i + j * width],
+							causticLocator.get(), settings.separateCaustics ? &causticPixelInfos[i + j * width] : nullptr, *sampler);
 					}
 				}
-				progress->emitProgress(k / float(settings.iterations));
-			}
-			for (int j = 0; j < height; j++) {
-				for (int i = 0; i < width; i++) {
-					float N = std::max(settings.iterations * settings.photonsPerIteration, 1);
-					const PixelInfo& pixelInfo = pixelInfos[i + j * width];
-					image(i, j) = pixelInfo.directLight / settings.iterations +
-						pixelInfo.indirectLight / (N * pixelInfo.radius * pixelInfo.radius * glm::pi<float>());
-				}
+				spent += active;
+				countIteration(iterationCounters, k);
+				if (active == 0)
+					break;
+				lastRenderStats.cameraTime += phaseTimer.elapsed();
+				lastRenderStats.iterations++;
+				iterationEstimate = updateIterationEstimate(iterationEstimate, renderTimer.elapsed() - iterationStart, k);
+				state.iteration = k + 1;
+				lastRenderStats.totalTime = previousTime + renderTimer.elapsed();
+				checkpoint(state, false, false);
+				snapshot(snapshotWriter.get(), state, false, sinceSnapshot);
+				progress->emitProgress(budgetProgress(spent, budget, renderTimer));
 			}
+			lastRenderStats.totalTime = previousTime + renderTimer.elapsed();
+			checkpoint(state, false, true);
+			storeIterationCounts(pixelInfos.data(), width, height);
+			resolve(state, false, image);
 			progress->emitProgress(1.0f);
 			return image;
 		}
 		template<class RayTraceAccel>
-		float Tracer<RayTraceAccel>::sampleLight(int index, const vec3& wo, const HitInfo& hitInfo, const std::shared_ptr<Spectral::BSDF>& bsdf, float wavelength) const {
+		SpectralSample Tracer<RayTraceAccel>::sampleLight(int index, const vec3& wo, const HitInfo& hitInfo, const Hero::spBSDF& bsdf, const SpectralSample& wavelengths, Sampler& sampler, bool& dispersed) const {
+			dispersed = false;
 			const spLight light = scene->light(index);
+			// both samples are drawn, so following dimensions do not depend on light type
+			vec2 uLight = sampler.get2D();
+			vec2 uScattering = sampler.get2D();
 			//sample light
 			float lightPdf;
 			vec3 lightPosition;
-			float li = light->sampleLi(hitInfo, wavelength, lightPosition, lightPdf);
-			float ld = 0.0f;
-			if (li > 0.0f && lightPdf > 0.0f) {
+			SpectralSample li = light->sampleLi(hitInfo, uLight, wavelengths, lightPosition, lightPdf);
+			SpectralSample ld = 0.0f;
+			if (!li.isBlack() && lightPdf > 0.0f) {
 				vec3 wi = lightPosition - hitInfo.globalPosition;
 				float distance = glm::max(glm::length(wi) - ShadowEps, OffsetEps);
 				wi = glm::normalize(wi);
-				float f = bsdf->f(wo, wi, hitInfo.normal, Spectral::BxDF::All) * std::abs(glm::dot(wi, hitInfo.normal));
+				SpectralSample f = bsdf->f(wo, wi, hitInfo.normal, Hero::BxDF::All) * std::abs(glm::dot(wi, hitInfo.normal));
 				float scatteringPdf = bsdf->pdf(wo, wi, hitInfo.normal, BxDF::All);
-				if (f > 0.0f && scatteringPdf > 0.0f) {
+				if (!f.isBlack() && scatteringPdf > 0.0f) {
 					// if sampled point is visible compute bsdf f()
 					if (scene->testVisibility(Ray(hitInfo.globalPosition, wi, OffsetEps, distance))) {
 						li = 0.0f;
@@ -397,9 +1123,13 @@ namespace Spectral {
 				vec3 wi;
 				float scatteringPdf;
 				int sampledType;
-				float f = bsdf->sampleF(wo, wi, hitInfo.normal, scatteringPdf, BxDF::All, sampledType);
+				SpectralSample f = bsdf->sampleF(wo, wi, hitInfo.normal, uScattering, scatteringPdf, BxDF::All, sampledType);
 				f *= glm::abs(glm::dot(wi, hitInfo.normal));
-				if (f > 0.0f && scatteringPdf > 0.0f) {
+				// companions are dropped, hero is weighted once by caller
+				bool sampleDispersed = isDispersiveEvent(hitInfo, sampledType, wavelengths);
+				if (sampleDispersed)
+					f = SpectralSample(f[0], 0.0f, 0.0f, 0.0f);
+				if (!f.isBlack() && scatteringPdf > 0.0f) {
 					float weight = 1.0f;
 					if ((sampledType & BxDF::Specular) == 0) {
 						lightPdf = light->pdfLi(hitInfo, wi);
@@ -409,56 +1139,130 @@ namespace Spectral {
 					}
 					HitInfo lightHitInfo;
 					Ray ray(hitInfo.globalPosition, wi);
-					float li = 0.0f;
+					SpectralSample li = 0.0f;
 					if (scene->intersect(ray, lightHitInfo)) {
 						if (lightHitInfo.light == light.get()) {
-							li = lightHitInfo.lightEmitted(-wi, wavelength);
+							li = lightHitInfo.lightEmitted(-wi, wavelengths);
 						}
 					}
 					else // area ambient light
-						li = light->lightEmitted(ray, wavelength);
-					if (li > 0.0f)
+						li = light->lightEmitted(ray, wavelengths);
+					if (!li.isBlack()) {
 						ld += f * li * weight / scatteringPdf;
+						dispersed = sampleDispersed;
+					}
 				}
 			}
 			return ld;
 		}
 		template<class RayTraceAccel>
-		float Tracer<RayTraceAccel>::sampleOneLight(const vec3& wo, const HitInfo& hitInfo, const std::shared_ptr<Spectral::BSDF>& bsdf, float wavelength) const {
+		SpectralSample Tracer<RayTraceAccel>::sampleOneLight(const vec3& wo, const HitInfo& hitInfo, const Hero::spBSDF& bsdf, const SpectralSample& wavelengths, Sampler& sampler, bool& dispersed) const {
+			dispersed = false;
 			if (scene->numLights() == 0)
 				return 0.0f;
-			// sample light
-			int lightIndex = Random::random(scene->numLights() - 1);
-			return sampleLight(lightIndex, wo, hitInfo, bsdf, wavelength) * scene->numLights();
+			// sample light, MIS inside sampleLight is over strategies for chosen light,
+			// so dividing by choice probability keeps estimate unbiased
+			float choicePdf;
+			int lightIndex = scene->chooseLight(hitInfo, sampler.get1D(), choicePdf);
+			if (lightIndex < 0 || choicePdf == 0.0f)
+				return 0.0f;
+			return sampleLight(lightIndex, wo, hitInfo, bsdf, wavelengths, sampler, dispersed) / choicePdf;
 		}
 		template<class RayTraceAccel>
-		float Tracer<RayTraceAccel>::sampleAllLights(const vec3& wo, const HitInfo& hitInfo, const std::shared_ptr<Spectral::BSDF>& bsdf, float wavelength) const {
+		SpectralSample Tracer<RayTraceAccel>::sampleAllLights(const vec3& wo, const HitInfo& hitInfo, const Hero::spBSDF& bsdf, const SpectralSample& wavelengths, Sampler& sampler, bool& dispersed) const {
+			dispersed = false;
 			if (scene->numLights() == 0)
 				return 0.0f;
-			float ld = 0.0f;
+			SpectralSample ld = 0.0f;
+			// hero of full spectrum estimate is unbiased too, so sum is hero weighted if any light was dispersed
 			for (int i = 0; i < scene->numLights(); ++i) {
-				ld += sampleLight(i, wo, hitInfo, bsdf, wavelength);
+				bool lightDispersed;
+				ld += sampleLight(i, wo, hitInfo, bsdf, wavelengths, sampler, lightDispersed);
+				dispersed = dispersed || lightDispersed;
 			}
 			return ld;
 		}
 		template<class RayTraceAccel>
-		std::vector<SpectralPhoton> Tracer<RayTraceAccel>::emitPhotons(float wavelength) {
-			Distribution1D lightPowerDistribution = scene->computeSpectralLightPowerDistribution(wavelength);
+		template<class Splat>
+		void Tracer<RayTraceAccel>::tracePhoton(int lightIndex, float lightPdf, const SpectralSample& wavelengths, Sampler& sampler, const Splat& splat) const {
+			float pdfPos;
+			float pdfDir;
+			Ray ray;
+			vec3 lightNormal;
+			vec2 uPos = sampler.get2D();
+			SpectralSample le = scene->light(lightIndex)->sampleLe(uPos, sampler.get2D(), ray, lightNormal, pdfPos, pdfDir, wavelengths);
+			if (le.isBlack() || pdfPos == 0.0f || pdfDir == 0.0f)
+				return;
+			SpectralSample intensity = glm::abs(glm::dot(lightNormal, ray.rd)) * le / (lightPdf * pdfPos * pdfDir);
+			if (intensity.isBlack())
+				return;
+			STATS_INC(PhotonsEmitted);
+			bool dispersed = false;
+			for (int depth = 0; depth < settings.maxDepth; depth++)
+			{
+				HitInfo hitInfo;
+				if (!scene->intersect(ray, hitInfo))
+					break;
+				if (!hitInfo.primitive) {
+					break;
+				}
+				if (depth > 0)
+					splat(hitInfo, ray, intensity, dispersed);
+				float pdf;
+				vec3 wo;
+				int sampledType;
+				Hero::spBSDF bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelengths);
+				STATS_INC(BSDFCalls);
+				SpectralSample lightOut = bsdf->sampleF(-ray.rd, wo, hitInfo.normal, sampler.get2D(), pdf, BxDF::All, sampledType, false);
+				if (lightOut.isBlack() || pdf == 0.0f)
+					break;
+				SpectralSample newIntensity = intensity * lightOut * glm::abs(glm::dot(wo, hitInfo.normal)) / pdf;
+				if (!dispersed && isDispersiveEvent(hitInfo, sampledType, wavelengths)) {
+					dispersed = true;
+					newIntensity = SpectralSample(newIntensity[0], 0.0f, 0.0f, 0.0f);
+				}
+				float q = glm::max(0.0f, 1.0f - newIntensity.maxComponent() / intensity.maxComponent());
+				if (sampler.get1D() < q) {
+					STATS_INC(PhotonsDiscarded);
+					break;
+				}
+				intensity = newIntensity / (1.0f - q);
+				ray.ro = hitInfo.globalPosition;
+				ray.rd = wo;
+				if (intensity.isBlack())
+					break;
+			}
+		}
+		template<class RayTraceAccel>
+		void Tracer<RayTraceAccel>::addContributions(const std::vector<PhotonContribution>& contributions) const {
+			for (const auto& contribution : contributions) {
+				contribution.pixel->phi += contribution.phi;
+				contribution.pixel->m++;
+			}
+		}
+		template<class RayTraceAccel>
+		std::vector<SpectralPhoton> Tracer<RayTraceAccel>::emitPhotons(const SpectralSample& wavelengths, Sampler& sampler, int count, PhotonMap map) {
 			std::vector<SpectralPhoton> photons;
-			for (int i = 0; i < settings.photonsPerIteration; i++) {
-				// choose light
+			float lightOffset = Random::random();
+			for (int i = 0; i < count; i++) {
 				float lightPdf = 0.0f;
-				int lightIndex = lightPowerDistribution.sampleDiscrete(Random::random(), lightPdf);
+				int lightIndex = scene->sampleLight(wavelengths, (i + lightOffset) / count, lightPdf);
+				sampler.startSample(streamSampleIndex(lightSampleIndices[lightIndex]++), ~uint32_t(lightIndex));
 				float pdfPos;
 				float pdfDir;
 				Ray ray;
 				vec3 lightNormal;
-				float le = scene->light(lightIndex)->sampleLe(ray, lightNormal, pdfPos, pdfDir, wavelength);
-				if (le == 0.0f || pdfPos == 0.0f || pdfDir == 0.0f)
+				vec2 uPos = sampler.get2D();
+				SpectralSample le = scene->light(lightIndex)->sampleLe(uPos, sampler.get2D(), ray, lightNormal, pdfPos, pdfDir, wavelengths);
+				if (le.isBlack() || pdfPos == 0.0f || pdfDir == 0.0f)
 					continue;
-				float intensity = glm::abs(glm::dot(lightNormal, ray.rd)) * le / (lightPdf * pdfPos * pdfDir);
-				if (intensity == 0.0f)
+				SpectralSample intensity = glm::abs(glm::dot(lightNormal, ray.rd)) * le / (lightPdf * pdfPos * pdfDir);
+				if (intensity.isBlack())
 					continue;
+				STATS_INC(PhotonsEmitted);
+				bool dispersed = false;
+				// all bounces so far were specular
+				bool specularPath = true;
 				for (int depth = 0; depth < settings.maxDepth; depth++)
 				{
 					HitInfo hitInfo;
@@ -467,69 +1271,86 @@ namespace Spectral {
 					if (!hitInfo.primitive) {
 						break;
 					}
-					std::shared_ptr<Spectral::BSDF> bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelength);
-					bool isDiffuse = bsdf->hasType(Spectral::BxDF::Diffuse);
-					bool isSpecular = bsdf->hasType(Spectral::BxDF::Specular);
-					bool isGlossy = bsdf->hasType(Spectral::BxDF::Glossy);
-					if ((isDiffuse || isGlossy) && depth > 0) {
+					Hero::spBSDF bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelengths);
+					STATS_INC(BSDFCalls);
+					bool isDiffuse = bsdf->hasType(Hero::BxDF::Diffuse);
+					bool isSpecular = bsdf->hasType(Hero::BxDF::Specular);
+					bool isGlossy = bsdf->hasType(Hero::BxDF::Glossy);
+					bool inMap = map == PhotonMap::All || (map == PhotonMap::Caustic) == specularPath;
+					if ((isDiffuse || isGlossy) && depth > 0 && inMap) {
 						// leave photon if diffuse
-						photons.push_back(SpectralPhoton{ hitInfo.globalPosition, -ray.rd, hitInfo.normal, intensity, hitInfo.primitive });
+						photons.push_back(SpectralPhoton{ hitInfo.globalPosition, -ray.rd, hitInfo.normal, intensity, hitInfo.primitive, dispersed });
 					}
 					float pdf;
 					vec3 wo;
 					int sampledType;
-					float lightOut = bsdf->sampleF(-ray.rd, wo, hitInfo.normal, pdf, Spectral::BxDF::All, sampledType, false);
-					if (lightOut == 0.0f || pdf == 0.0f)
+					SpectralSample lightOut = bsdf->sampleF(-ray.rd, wo, hitInfo.normal, sampler.get2D(), pdf, Hero::BxDF::All, sampledType, false);
+					if (lightOut.isBlack() || pdf == 0.0f)
 						break;
-					float newIntensity = intensity * lightOut * glm::abs(glm::dot(wo, hitInfo.normal)) / pdf;
-					float q = glm::max(0.0f, 1.0f - newIntensity / intensity);
-					if (Random::random() < q)
+					if ((sampledType & BxDF::Specular) == 0) {
+						specularPath = false;
+						// rest of path cannot leave caustic photons
+						if (map == PhotonMap::Caustic)
+							break;
+					}
+					SpectralSample newIntensity = intensity * lightOut * glm::abs(glm::dot(wo, hitInfo.normal)) / pdf;
+					if (!dispersed && isDispersiveEvent(hitInfo, sampledType, wavelengths)) {
+						dispersed = true;
+						newIntensity = SpectralSample(newIntensity[0], 0.0f, 0.0f, 0.0f);
+					}
+					float q = glm::max(0.0f, 1.0f - newIntensity.maxComponent() / intensity.maxComponent());
+					if (sampler.get1D() < q) {
+						STATS_INC(PhotonsDiscarded);
 						break;
+					}
 					intensity = newIntensity / (1.0f - q);
 					ray.ro = hitInfo.globalPosition;
 					ray.rd = wo;
-					if (intensity == 0.0f)
+					if (intensity.isBlack())
 						break;
 				}
 			}
+			STATS_ADD(PhotonsStored, photons.size());
 			return std::move(photons);
 		}
 		template<class RayTraceAccel>
 		template<class PointLocator>
-		void Tracer<RayTraceAccel>::gather(const vec2& ndc, float wavelength, const PointLocator& pointLocator, PixelInfo& pixel) {
-			float luminocity = 1.0f;
-			Ray ray = camera->generateRay(ndc);
-			pixel.m = 0;
+		void Tracer<RayTraceAccel>::gather(const vec2& ndc, const SpectralSample& wavelengths, const SpectralSample& weights, const PointLocator& pointLocator, PixelInfo& pixel,
+			const PointLocator* causticLocator, PixelInfo* causticPixel, Sampler& sampler) {
+			SpectralSample luminocity = weights;
+			SpectralSample directLight = 0.0f;
+			Ray ray = camera->generateRay(ndc, sampler.get2D());
 			bool specularBounce = false;
-			float phi = 0.0f;
+			bool dispersed = false;
+			float indirect = 0.0f;
 			for (int depth = 0; depth < settings.maxDepth; depth++) {
 				HitInfo hitInfo;
 				if (!scene->intersect(ray, hitInfo)) {
 					for (int i = 0; i < scene->numLights(); ++i)
-						pixel.directLight += wavelengthToRGB(wavelength, luminocity * scene->light(i)->lightEmitted(ray, wavelength));
+						directLight += heroWeighted(luminocity * scene->light(i)->lightEmitted(ray, wavelengths), dispersed);
 					break;
 				}
 				vec3 wo = -ray.rd;
 				if (depth == 0 || specularBounce)
-					pixel.directLight += wavelengthToRGB(wavelength, luminocity * hitInfo.lightEmitted(wo, wavelength));
+					directLight += heroWeighted(luminocity * hitInfo.lightEmitted(wo, wavelengths), dispersed);
 				if (!hitInfo.primitive) {
 					break;
 				}
-				std::shared_ptr<Spectral::BSDF> bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelength);
-				pixel.directLight += wavelengthToRGB(wavelength, luminocity * sampleOneLight(wo, hitInfo, bsdf, wavelength));
+				Hero::spBSDF bsdf = hitInfo.primitive->getMaterial()->bsdf(hitInfo, wavelengths);
+				STATS_INC(BSDFCalls);
+				bool lightDispersed;
+				SpectralSample ld = sampleOneLight(wo, hitInfo, bsdf, wavelengths, sampler, lightDispersed);
+				directLight += heroWeighted(luminocity * ld, dispersed || lightDispersed);
 
 				bool isDiffuse = bsdf->hasType(BxDF::Diffuse);
 				bool isGlossy = bsdf->hasType(BxDF::Glossy);
 				if (isDiffuse || (isGlossy && depth == settings.maxDepth - 1)) {
 					// accumulate indirect
-					std::vector<int> indices = pointLocator.indicesWithinRadius(hitInfo.globalPosition, pixel.radius);
-					for (const auto& index : indices) {
-						const auto& particle = pointLocator.pointAt(index);
-						if (glm::dot(particle.normal, hitInfo.normal) < 0.0 || hitInfo.primitive != particle.primitive)
-							continue;
-						phi += luminocity * particle.power * bsdf->f(wo, particle.wi, particle.normal, BxDF::Type::All);
-						pixel.m++;
-					}
+					indirect += gatherPhotons(pointLocator, hitInfo, wo, bsdf, luminocity, dispersed, wavelengths, pixel,
+						settings.photonsPerIteration);
+					if (causticLocator)
+						indirect += gatherPhotons(*causticLocator, hitInfo, wo, bsdf, luminocity, dispersed, wavelengths, *causticPixel,
+							settings.causticPhotonsPerIteration);
 					break;
 				}
 				// bounce ray
@@ -537,24 +1358,45 @@ namespace Spectral {
 					float pdf;
 					vec3 wi;
 					int type;
-					float f = bsdf->sampleF(wo, wi, hitInfo.normal, pdf, BxDF::All, type);
-					if (f == 0.0f || pdf == 0.0f)
+					SpectralSample f = bsdf->sampleF(wo, wi, hitInfo.normal, sampler.get2D(), pdf, BxDF::All, type);
+					if (f.isBlack() || pdf == 0.0f)
 						break;
 					specularBounce = (type & BxDF::Specular);
 					luminocity *= f * glm::abs(glm::dot(wi, hitInfo.normal)) / pdf;
-					if (luminocity == 0.0f)
+					if (!dispersed && isDispersiveEvent(hitInfo, type, wavelengths)) {
+						dispersed = true;
+						luminocity = SpectralSample(luminocity[0], 0.0f, 0.0f, 0.0f);
+					}
+					if (luminocity.isBlack())
 						break;
 					ray = Ray(hitInfo.globalPosition, wi);
 				}
 			}
+			vec3 direct = wavelengthToRGB(wavelengths, directLight);
+			pixel.directLight += direct;
+			pixel.direct.add(luminance(direct));
+			finishPixelIteration(pixel, indirect);
+		}
+		template<class RayTraceAccel>
+		template<class PointLocator>
+		float Tracer<RayTraceAccel>::gatherPhotons(const PointLocator& pointLocator, const HitInfo& hitInfo, const vec3& wo, const Hero::spBSDF& bsdf,
+			const SpectralSample& luminocity, bool dispersed, const SpectralSample& wavelengths, PixelInfo& pixel, int photons) const {
+			SpectralSample phi = 0.0f;
+			pixel.m = 0;
+			std::vector<int> indices = pointLocator.indicesWithinRadius(hitInfo.globalPosition, pixel.radius);
+			STATS_INC(PointQueries);
+			STATS_ADD(GatherCandidates, indices.size());
+			for (const auto& index : indices) {
+				const auto& particle = pointLocator.pointAt(index);
+				if (glm::dot(particle.normal, hitInfo.normal) < 0.0 || hitInfo.primitive != particle.primitive)
+					continue;
+				phi += heroWeighted(luminocity * particle.power * bsdf->f(wo, particle.wi, particle.normal, BxDF::Type::All), dispersed || particle.dispersed);
+				pixel.m++;
+			}
+			STATS_ADD(GatherAccepted, pixel.m);
 			if (pixel.m == 0)
-				return;
-			const float Gamma = 2.0f / 3.0f;
-			float newN = pixel.n + Gamma * pixel.m;
-			float newRadius = pixel.radius * std::sqrt(newN / glm::max(pixel.n + pixel.m, 1.0f));
-			pixel.indirectLight = (pixel.indirectLight + wavelengthToRGB(wavelength, phi)) * (newRadius * newRadius) / (pixel.radius * pixel.radius);
-			pixel.radius = newRadius;
-			pixel.n = newN;
+				return 0.0f;
+			return addIndirectFlux(pixel, wavelengthToRGB(wavelengths, phi), photons);
 		}
 	}
 
@@ -0,0 +1,183 @@
+#include "Sampler.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <vector>
+
+
+namespace {
+	const float OneMinusEpsilon = 0.99999994f;
+
+	uint32_t mixBits(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+	uint32_t hash(uint32_t a, uint32_t b) {
+		return mixBits(a ^ mixBits(b + 0x9e3779b9u));
+	}
+	uint32_t reverseBits(uint32_t x) {
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+		x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+		x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+		x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+		return x;
+	}
+	// Laine-Karras hash, every bit depends only on less significant bits
+	uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return x;
+	}
+	// every bit is flipped depending on more significant bits only
+	uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+		return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+	}
+	// first two Sobol dimensions, first one is van der Corput sequence
+	uint32_t sobol(uint32_t index, int dimension) {
+		uint32_t result = 0;
+		uint32_t direction = 1u << 31;
+		for (; index; index >>= 1) {
+			if (index & 1)
+				result ^= direction;
+			direction = dimension == 0 ? direction >> 1 : direction ^ (direction >> 1);
+		}
+		return result;
+	}
+	float toFloat(uint32_t x) {
+		return std::min(x * 2.3283064365386963e-10f, OneMinusEpsilon);
+	}
+
+	const std::vector<int>& primes() {
+		static const std::vector<int> table = [] {
+			std::vector<int> result;
+			for (int n = 2; result.size() < HaltonSampler::MaxDimension; ++n) {
+				bool isPrime = true;
+				for (int i = 0; i < result.size() && result[i] * result[i] <= n; ++i)
+					if (n % result[i] == 0) {
+						isPrime = false;
+						break;
+					}
+				if (isPrime)
+					result.push_back(n);
+			}
+			return result;
+		}();
+		return table;
+	}
+	float scrambledRadicalInverse(int base, uint64_t a, uint32_t seed) {
+		const double Precision = 1.0 / (1 << 24);
+		const double invBase = 1.0 / base;
+		double invBaseM = 1.0;
+		uint64_t reversedDigits = 0;
+		for (uint32_t digitIndex = 0; invBaseM > Precision; ++digitIndex) {
+			uint64_t next = a / base;
+			uint32_t digit = uint32_t(a - next * base);
+			// shift depends on all preceding digits, so each stratum is permuted independently
+			uint32_t shift = hash(hash(seed, digitIndex), uint32_t(reversedDigits));
+			digit = (digit + shift) % base;
+			reversedDigits = reversedDigits * base + digit;
+			invBaseM *= invBase;
+			a = next;
+		}
+		return std::min(float(reversedDigits * invBaseM), OneMinusEpsilon);
+	}
+}
+
+std::unique_ptr<Sampler> Sampler::create(SamplerType type) {
+	switch (type) {
+	case SamplerType::Random:
+		return std::make_unique<RandomSampler>();
+	case SamplerType::Halton:
+		return std::make_unique<HaltonSampler>();
+	case SamplerType::Sobol:
+		return std::make_unique<SobolSampler>();
+	}
+	throw std::runtime_error("Unknown sampler type");
+}
+
+void Sampler::startSample(uint64_t index, uint32_t seed) {
+	this->index = index;
+	this->seed = seed;
+	dimension = 0;
+}
+
+float RandomSampler::get1D() {
+	++dimension;
+	return Random::random();
+}
+
+vec2 RandomSampler::get2D() {
+	dimension += 2;
+	return vec2(Random::random(), Random::random());
+}
+
+float HaltonSampler::get1D() {
+	int d = dimension++;
+	return scrambledRadicalInverse(primes()[d % MaxDimension], index, hash(seed, d));
+}
+
+vec2 HaltonSampler::get2D() {
+	float x = get1D();
+	return vec2(x, get1D());
+}
+
+float SobolSampler::get1D() {
+	uint32_t dimensionSeed = hash(seed, dimension++);
+	uint32_t shuffled = nestedUniformScramble(uint32_t(index), dimensionSeed);
+	return toFloat(nestedUniformScramble(sobol(shuffled, 0), hash(dimensionSeed, 0)));
+}
+
+vec2 SobolSampler::get2D() {
+	uint32_t dimensionSeed = hash(seed, dimension);
+	dimension += 2;
+	uint32_t shuffled = nestedUniformScramble(uint32_t(index), dimensionSeed);
+	return vec2(
+		toFloat(nestedUniformScramble(sobol(shuffled, 0), hash(dimensionSeed, 0))),
+		toFloat(nestedUniformScramble(sobol(shuffled, 1), hash(dimensionSeed, 1))));
+}
+
+void PrimarySampleSampler::clear() {
+	values.clear();
+	dimension = 0;
+}
+
+void PrimarySampleSampler::mutate(const PrimarySampleSampler& from, float size) {
+	// smallest offset relative to size
+	const float MinScale = 1.0f / 1024.0f;
+	values.resize(from.values.size());
+	for (int i = 0; i < values.size(); ++i) {
+		float offset = size * std::exp(std::log(MinScale) * Random::random());
+		float value = Random::random() < 0.5f ? from.values[i] - offset : from.values[i] + offset;
+		value -= std::floor(value);
+		values[i] = std::min(value, OneMinusEpsilon);
+	}
+	dimension = 0;
+}
+
+const std::vector<float>& PrimarySampleSampler::primarySamples() const {
+	return values;
+}
+
+void PrimarySampleSampler::setPrimarySamples(const std::vector<float>& samples) {
+	values = samples;
+	dimension = 0;
+}
+
+float PrimarySampleSampler::get1D() {
+	if (dimension == values.size())
+		values.push_back(Random::random());
+	return values[dimension++];
+}
+
+vec2 PrimarySampleSampler::get2D() {
+	float x = get1D();
+	return vec2(x, get1D());
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+
+
+enum class SamplerType {
+	// independent values from Random, for reference
+	Random,
+	// scrambled Halton sequence
+	Halton,
+	// Owen-scrambled Sobol sequence
+	Sobol
+};
+
+// Generates sample values by dimension
+// Sample is a point of a sequence, get1D and get2D consume its dimensions one after another
+// Seed decorrelates sequences used by different pixels or lights
+class Sampler {
+protected:
+	uint64_t index = 0;
+	uint32_t seed = 0;
+	int dimension = 0;
+public:
+	static std::unique_ptr<Sampler> create(SamplerType type);
+	virtual ~Sampler() {}
+	void startSample(uint64_t index, uint32_t seed);
+	// values are in [0, 1)
+	virtual float get1D() = 0;
+	virtual vec2 get2D() = 0;
+};
+
+class RandomSampler : public Sampler {
+public:
+	virtual float get1D() override;
+	virtual vec2 get2D() override;
+};
+
+// Radical inverses in prime bases, digits are shifted by hash of preceding digits,
+// which is a nested (Owen) scrambling and keeps stratification of the sequence
+class HaltonSampler : public Sampler {
+public:
+	// dimensions above wrap around with different scrambling
+	static const int MaxDimension = 1024;
+	virtual float get1D() override;
+	virtual vec2 get2D() override;
+};
+
+// Owen-scrambled Sobol points, each 1D or 2D draw shuffles sample index with its own seed,
+// so any number of dimensions is available from the first two Sobol dimensions
+// Practical Hash-based Owen Scrambling, Burley 2020
+// Index is truncated to 32 bits
+class SobolSampler : public Sampler {
+public:
+	virtual float get1D() override;
+	virtual vec2 get2D() override;
+};
+
+// Replays stored vector of primary sample space, dimensions used for the first time are uniform
+// Markov chain photon tracing mutates the vector, so a path can be traced again with small changes
+// Index and seed of startSample are ignored
+class PrimarySampleSampler : public Sampler {
+	std::vector<float> values;
+public:
+	// forgets values, next path is uniform
+	void clear();
+	// values of other sampler, each one offset by up to size with wrap around
+	// offsets are exponentially distributed, so small steps are more likely
+	void mutate(const PrimarySampleSampler& from, float size);
+	const std::vector<float>& primarySamples() const;
+	void setPrimarySamples(const std::vector<float>& samples);
+	virtual float get1D() override;
+	virtual vec2 get2D() override;
+};
\ No newline at end of file
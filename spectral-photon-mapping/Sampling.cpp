@@ -7,11 +7,25 @@ float Sampling::uniformStratified(int count) {
 	return (float(bin) + Random::random()) / float(count);
 }
 
+std::vector<float> Sampling::stratifiedSequence(int count) {
+	std::vector<float> sequence(count);
+	for (int i = 0; i < count; ++i)
+		sequence[i] = (float(i) + Random::random()) / float(count);
+	// Fisher-Yates shuffle
+	for (int i = count - 1; i > 0; --i)
+		std::swap(sequence[i], sequence[Random::random(i)]);
+	return sequence;
+}
+
 vec3 Sampling::uniformHemisphere(vec3 dir) {
+	return uniformHemisphere(dir, vec2(Random::random(), Random::random()));
+}
+
+vec3 Sampling::uniformHemisphere(vec3 dir, const vec2& u) {
 	dir = normalize(dir);
 	vec3 o1 = normalize(ortho(dir));
 	vec3 o2 = normalize(cross(dir, o1));
-	vec2 r = vec2(Random::random(), Random::random());
+	vec2 r = u;
 	r.x = r.x * glm::two_pi<float>();
 	float p = sqrt(1.0f - r.y * r.y);
 	return dir * r.y + cos(r.x) * p * o1 + sin(r.x) * p * o2;
@@ -22,13 +36,21 @@ float Sampling::uniformHemispherePdf() {
 }
 
 vec2 Sampling::uniformDisk(float radius) {
-	float r = sqrt(Random::random()*radius);
-	float angle = Random::random()*glm::two_pi<float>();
+	return uniformDisk(radius, vec2(Random::random(), Random::random()));
+}
+
+vec2 Sampling::uniformDisk(float radius, const vec2& u) {
+	float r = radius * sqrt(u.x);
+	float angle = u.y * glm::two_pi<float>();
 	return vec2(r*cos(angle), r*sin(angle));
 }
 
 vec3 Sampling::uniformSphere() {
-	vec2 r = vec2(Random::random(), Random::random());
+	return uniformSphere(vec2(Random::random(), Random::random()));
+}
+
+vec3 Sampling::uniformSphere(const vec2& u) {
+	vec2 r = u;
 	r.x = r.x * glm::two_pi<float>();
 	r.y = 2.0f * r.y - 1.0f;
 	float p = sqrt(1.0f - r.y * r.y);
@@ -40,10 +62,14 @@ float Sampling::uniformSpherePdf() {
 }
 
 vec3 Sampling::cosWeightedHemisphere(vec3 dir) {
+	return cosWeightedHemisphere(dir, vec2(Random::random(), Random::random()));
+}
+
+vec3 Sampling::cosWeightedHemisphere(vec3 dir, const vec2& u) {
 	dir = normalize(dir);
 	vec3 o1 = normalize(ortho(dir));
 	vec3 o2 = normalize(cross(dir, o1));
-	vec2 r = vec2(Random::random(), Random::random());
+	vec2 r = u;
 	r.x = r.x * glm::two_pi<float>();
 	float p = sqrt(1.0f - r.y);
 	r.y = std::sqrt(r.y);
@@ -51,10 +77,14 @@ vec3 Sampling::cosWeightedHemisphere(vec3 dir) {
 }
 
 vec3 Sampling::cosWeightedHemisphere(vec3 dir, float& pdf) {
+	return cosWeightedHemisphere(dir, vec2(Random::random(), Random::random()), pdf);
+}
+
+vec3 Sampling::cosWeightedHemisphere(vec3 dir, const vec2& u, float& pdf) {
 	dir = normalize(dir);
 	vec3 o1 = normalize(ortho(dir));
 	vec3 o2 = normalize(cross(dir, o1));
-	vec2 r = vec2(Random::random(), Random::random());
+	vec2 r = u;
 	r.x = r.x * glm::two_pi<float>();
 	float p = sqrt(1.0f - r.y);
 	r.y = std::sqrt(r.y);
@@ -63,10 +93,14 @@ vec3 Sampling::cosWeightedHemisphere(vec3 dir, float& pdf) {
 }
 
 vec3 Sampling::uniformTriangle(const vec3& a, const vec3& b, const vec3& c) {
-	vec2 r = vec2(Random::random(), Random::random());
+	return uniformTriangle(a, b, c, vec2(Random::random(), Random::random()));
+}
+
+vec3 Sampling::uniformTriangle(const vec3& a, const vec3& b, const vec3& c, const vec2& u) {
+	const vec2& r = u;
 	float s = 1.0f - glm::sqrt(1.0f - r.x);
 	float t = (1.0f - s) * r.y;
-	return a + (b - a) * s + (c - a);
+	return a + (b - a) * s + (c - a) * t;
 }
 
 float Sampling::uniformTrianglePdf(const vec3& a, const vec3& b, const vec3& c) {
@@ -74,11 +108,12 @@ float Sampling::uniformTrianglePdf(const vec3& a, const vec3& b, const vec3& c)
 }
 
 vec3 Sampling::uniformTriangle(const vec3& a, const vec3& b, const vec3& c, float& pdf) {
-	vec2 r = vec2(Random::random(), Random::random());
-	float s = 1.0f - glm::sqrt(1.0f - r.x);
-	float t = (1.0f - s) * r.y;
+	return uniformTriangle(a, b, c, vec2(Random::random(), Random::random()), pdf);
+}
+
+vec3 Sampling::uniformTriangle(const vec3& a, const vec3& b, const vec3& c, const vec2& u, float& pdf) {
 	pdf = uniformTrianglePdf(a, b, c);
-	return a + (b - a) * s + (c - a);
+	return uniformTriangle(a, b, c, u);
 }
 
 vec2 Sampling::uniformExponential2D() {
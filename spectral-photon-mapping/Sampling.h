@@ -2,11 +2,15 @@
 #include "common.h"
 #include "Random.h"
 
+#include <vector>
+
 
 
 class Sampling {
 public:
 	static float uniformStratified(int count);
+	// one jittered sample per stratum of [0, 1), in random order
+	static std::vector<float> stratifiedSequence(int count);
 	static vec3 uniformHemisphere(vec3 dir);
 	static float uniformHemispherePdf();
 	static vec2 uniformDisk(float radius);
@@ -21,4 +25,12 @@ public:
 	static vec2 uniformExponential2D(float m, float sigma);
 	// http://vcg.isti.cnr.it/jgt/tetra.htm
 	static vec3 uniformTetrahedron(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3);
+	// same mappings of given point u in [0, 1)^2, e.g. drawn from Sampler
+	static vec3 uniformHemisphere(vec3 dir, const vec2& u);
+	static vec2 uniformDisk(float radius, const vec2& u);
+	static vec3 uniformSphere(const vec2& u);
+	static vec3 cosWeightedHemisphere(vec3 dir, const vec2& u);
+	static vec3 cosWeightedHemisphere(vec3 dir, const vec2& u, float& pdf);
+	static vec3 uniformTriangle(const vec3& p0, const vec3& p1, const vec3& p2, const vec2& u);
+	static vec3 uniformTriangle(const vec3& p0, const vec3& p1, const vec3& p2, const vec2& u, float& pdf);
 };
\ No newline at end of file
@@ -1,34 +1,77 @@
 #pragma once
 #include "Primitive.h"
 #include "Light.h"
+#include "LightSampler.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_set>
 
 template<class RayTraceAccel>
 class Scene {
 	std::vector<spPrimitive> primitives;
 	std::vector<spLight> lights;
 	std::unique_ptr<RayTraceAccel> accel;
+	// light power distributions of wavelength cells, see buildLightDistributions
+	std::vector<Distribution1D> lightDistributions;
+	float lightDistributionMin = 0.0f;
+	float lightDistributionStep = 1.0f;
+	// chooses lights for direct lighting, built with light distributions
+	LightSamplerType lightSamplerType = LightSamplerType::Uniform;
+	std::unique_ptr<LightSampler> lightSampler;
 public:
 	void clearPrimitives();
 	void clearLights();
 	void addPrimitive(const spPrimitive& primitive);
+	// add copies of one shape, shape and its accelerator are shared between all instances
+	void addInstances(const spShape& shape, const Spectral::spMaterial& material, const std::vector<Affine>& transforms);
 	void addLight(const spLight& light);
 	const spPrimitive& primitive(int index) const;
 	const spLight& light(int index) const;
 	int numLights() const;
 	int numObjects() const;
 	Distribution1D computeSpectralLightPowerDistribution(float wavelength) const;
+	// power summed over lanes, so light is chosen if it emits at any of wavelengths
+	Distribution1D computeSpectralLightPowerDistribution(const SpectralSample& wavelengths) const;
 	Distribution1D computeLightPowerDistribution() const;
+	// caches light power distributions on cells of Config spectrum range, call it after lights are added
+	// cell takes maximum of power over it, so every light emitting inside cell can be chosen
+	// cells without emission fall back to distribution of total power
+	// also builds light sampler for direct lighting
+	void buildLightDistributions(float step = 5.0f);
+	// BVH pays off for many small lights, it is rebuilt if already built
+	void setLightSampler(LightSamplerType type);
+	const Distribution1D& lightPowerDistribution(float wavelength) const;
+	// first quarter of value range chooses light for hero wavelength, others for companions
+	// pdf is average over lanes, so it does not depend on lane which chose light
+	int sampleLight(const SpectralSample& wavelengths, float value, float& pdf) const;
+	float lightPdf(const SpectralSample& wavelengths, int index) const;
+	// light for direct lighting at hit point, -1 if no light may contribute
+	int chooseLight(const HitInfo& hitInfo, float value, float& pdf) const;
+	float chooseLightPdf(const HitInfo& hitInfo, int index) const;
 	bool testVisibility(const Ray& ray) const;
 	//todo: add aabb tree or something like that
 	bool intersect(Ray ray, HitInfo& hitInfo) const;
+	// builds top level accelerator over primitive bounds, shape accelerators are not rebuilt
+	// args are passed to accelerator constructor, e.g. cache filename and max depth for AABBTree
 	template<class...Args>
 	void buildAccelerator(Args...args);
+	// resamples spectra of all materials and lights on uniform grid over Config spectrum range
+	// and returns max interpolation error of each baked one, call it after scene is complete
+	std::vector<float> bakeSpectra(float step = 1.0f);
 	void print() const;
 };
 
 template<class RayTraceAccel>
 using spScene = std::shared_ptr<Scene<RayTraceAccel>>;
 
+// one line summary of errors returned by bakeSpectra
+inline void printBakeErrors(const std::vector<float>& errors) {
+	float maxError = errors.empty() ? 0.0f : *std::max_element(errors.begin(), errors.end());
+	printf("Baked %d spectra, max error %g\n", int(errors.size()), maxError);
+}
+
 template<class RayTraceAccel>
 void Scene<RayTraceAccel>::clearPrimitives() {
 	primitives.clear();
@@ -37,6 +80,8 @@ void Scene<RayTraceAccel>::clearPrimitives() {
 template<class RayTraceAccel>
 void Scene<RayTraceAccel>::clearLights() {
 	lights.clear();
+	lightDistributions.clear();
+	lightSampler.reset();
 }
 
 template<class RayTraceAccel>
@@ -44,9 +89,18 @@ void Scene<RayTraceAccel>::addPrimitive(const spPrimitive& primitive) {
 	primitives.push_back(primitive);
 }
 
+template<class RayTraceAccel>
+void Scene<RayTraceAccel>::addInstances(const spShape& shape, const Spectral::spMaterial& material, const std::vector<Affine>& transforms) {
+	primitives.reserve(primitives.size() + transforms.size());
+	for (const auto& transform : transforms)
+		primitives.push_back(std::make_shared<Primitive>(shape, material, transform));
+}
+
 template<class RayTraceAccel>
 void Scene<RayTraceAccel>::addLight(const spLight& light) {
 	lights.push_back(light);
+	lightDistributions.clear();
+	lightSampler.reset();
 }
 
 template<class RayTraceAccel>
@@ -79,6 +133,18 @@ Distribution1D Scene<RayTraceAccel>::computeSpectralLightPowerDistribution(float
 	return Distribution1D(lightPower.begin(), lightPower.end());
 }
 
+template<class RayTraceAccel>
+Distribution1D Scene<RayTraceAccel>::computeSpectralLightPowerDistribution(const SpectralSample& wavelengths) const {
+	std::vector<float> lightPower;
+	for (const auto& light : lights) {
+		float power = 0.0f;
+		for (int i = 0; i < SpectralSample::Size; ++i)
+			power += light->power(wavelengths[i]);
+		lightPower.push_back(power);
+	}
+	return Distribution1D(lightPower.begin(), lightPower.end());
+}
+
 template<class RayTraceAccel>
 Distribution1D Scene<RayTraceAccel>::computeLightPowerDistribution() const {
 	std::vector<float> lightPower;
@@ -87,9 +153,87 @@ Distribution1D Scene<RayTraceAccel>::computeLightPowerDistribution() const {
 	return Distribution1D(lightPower.begin(), lightPower.end());
 }
 
+template<class RayTraceAccel>
+void Scene<RayTraceAccel>::buildLightDistributions(float step) {
+	float min = Config::get().spectrumMin();
+	float max = Config::get().spectrumMax();
+	int cells = std::max(int(std::ceil((max - min) / step)), 1);
+	// spectra are baked with 1 nm resolution, finer subsamples would not find more peaks
+	int subsamples = std::max(int(std::ceil(step)), 1);
+	std::vector<float> totalPower;
+	for (const auto& light : lights)
+		totalPower.push_back(light->power());
+	lightDistributions.clear();
+	lightDistributions.reserve(cells);
+	std::vector<float> lightPower(lights.size());
+	for (int i = 0; i < cells; ++i) {
+		float sum = 0.0f;
+		for (int j = 0; j < lights.size(); ++j) {
+			lightPower[j] = 0.0f;
+			for (int k = 0; k <= subsamples; ++k)
+				lightPower[j] = std::max(lightPower[j], lights[j]->power(std::min(min + step * (i + float(k) / subsamples), max)));
+			sum += lightPower[j];
+		}
+		if (sum > 0.0f)
+			lightDistributions.push_back(Distribution1D(lightPower.begin(), lightPower.end()));
+		else
+			lightDistributions.push_back(Distribution1D(totalPower.begin(), totalPower.end()));
+	}
+	lightDistributionMin = min;
+	lightDistributionStep = step;
+	lightSampler = LightSampler::create(lightSamplerType, lights);
+}
+
+template<class RayTraceAccel>
+void Scene<RayTraceAccel>::setLightSampler(LightSamplerType type) {
+	lightSamplerType = type;
+	if (lightSampler)
+		lightSampler = LightSampler::create(lightSamplerType, lights);
+}
+
+template<class RayTraceAccel>
+const Distribution1D& Scene<RayTraceAccel>::lightPowerDistribution(float wavelength) const {
+	if (lightDistributions.empty())
+		throw std::runtime_error("Light distributions are not built");
+	int cell = int((wavelength - lightDistributionMin) / lightDistributionStep);
+	return lightDistributions[glm::clamp(cell, 0, int(lightDistributions.size()) - 1)];
+}
+
+template<class RayTraceAccel>
+int Scene<RayTraceAccel>::sampleLight(const SpectralSample& wavelengths, float value, float& pdf) const {
+	int lane = std::min(int(value * SpectralSample::Size), SpectralSample::Size - 1);
+	float lanePdf;
+	int index = lightPowerDistribution(wavelengths[lane]).sampleAlias(value * SpectralSample::Size - lane, lanePdf);
+	pdf = lightPdf(wavelengths, index);
+	return index;
+}
+
+template<class RayTraceAccel>
+float Scene<RayTraceAccel>::lightPdf(const SpectralSample& wavelengths, int index) const {
+	float pdf = 0.0f;
+	for (int i = 0; i < SpectralSample::Size; ++i)
+		pdf += lightPowerDistribution(wavelengths[i]).discretePDF(index);
+	return pdf / SpectralSample::Size;
+}
+
+template<class RayTraceAccel>
+int Scene<RayTraceAccel>::chooseLight(const HitInfo& hitInfo, float value, float& pdf) const {
+	if (!lightSampler)
+		throw std::runtime_error("Light sampler is not built");
+	return lightSampler->sample(hitInfo.globalPosition, hitInfo.normal, value, pdf);
+}
+
+template<class RayTraceAccel>
+float Scene<RayTraceAccel>::chooseLightPdf(const HitInfo& hitInfo, int index) const {
+	if (!lightSampler)
+		throw std::runtime_error("Light sampler is not built");
+	return lightSampler->pdf(hitInfo.globalPosition, hitInfo.normal, index);
+}
+
 template<class RayTraceAccel>
 bool Scene<RayTraceAccel>::testVisibility(const Ray& ray) const {
 	assert(accel != nullptr);
+	STATS_INC(AnyHitRays);
 	if (accel)
 		return accel->intersect(ray);
 	// fallback to brute force
@@ -106,6 +250,7 @@ bool Scene<RayTraceAccel>::testVisibility(const Ray& ray) const {
 
 template<class RayTraceAccel>
 bool Scene<RayTraceAccel>::intersect(Ray ray, HitInfo& hitInfo) const {
+	STATS_INC(ClosestRays);
 	// fallback to brute force
 	hitInfo.t = -1.0;
 	hitInfo.primitive = nullptr;
@@ -133,10 +278,32 @@ void Scene<RayTraceAccel>::buildAccelerator(Args...args) {
 			objects.push_back(light.get());
 	}
 	std::function<Intersectable*(typename std::vector<Intersectable*>::iterator&)> get = [](typename std::vector<Intersectable*>::iterator& it)->Intersectable* {return *it; };
-	accel = std::make_unique<RayTraceAccel, Args...>(objects.begin(), objects.end(), get, args...);
+	accel = std::make_unique<RayTraceAccel>(objects.begin(), objects.end(), get, args...);
 }
 
 template<class RayTraceAccel>
 void Scene<RayTraceAccel>::print() const {
 	accel->print();
+}
+
+template<class RayTraceAccel>
+std::vector<float> Scene<RayTraceAccel>::bakeSpectra(float step) {
+	float min = Config::get().spectrumMin();
+	float max = Config::get().spectrumMax();
+	// samplers are usually shared between materials, each one is baked once
+	std::unordered_set<const ColorSampler*> baked;
+	std::vector<float> errors;
+	auto bake = [&](const spColorSampler& sampler) {
+		if (!sampler->isWorthBaking() || !baked.insert(sampler.get()).second)
+			return;
+		errors.push_back(sampler->bake(min, max, step));
+	};
+	std::unordered_set<const Spectral::Material*> materials;
+	for (const auto& primitive : primitives) {
+		if (materials.insert(primitive->getMaterial().get()).second)
+			primitive->getMaterial()->forEachSampler(bake);
+	}
+	for (const auto& light : lights)
+		light->forEachSampler(bake);
+	return errors;
 }
\ No newline at end of file
@@ -1,39 +1,25 @@
 #include "Scenes.h"
 
 
-std::shared_ptr<Mesh<PrimitiveLocators::BruteForce<Triangle>>> createPrism(float scale = 0.5f){
-	float x = scale;
-	float y = scale;
+spTriangleMesh createPrism(float scale) {
 	float z = scale * std::sqrt(3.0f) / 4.0f;
-	return std::make_shared<Mesh<PrimitiveLocators::BruteForce<Triangle>>>(std::initializer_list<Triangle>{
-		Triangle(vec3(-0.5f, 0.5f, -z),
-			vec3(0.0f, 0.5f, z),
-			vec3(0.5f, 0.5f, -z)), //top
-
-			Triangle(vec3(-0.5f, -0.5f, -z),
-				vec3(0.5f, -0.5f, -z),
-				vec3(0.0f, -0.5f, z)), // bottom
-
-			Triangle(vec3(-0.5f, -0.5f, -z),
-				vec3(0.5f, 0.5f, -z),
-				vec3(0.5f, -0.5f, -z)),
-			Triangle(vec3(-0.5f, -0.5f, -z),
-				vec3(-0.5f, 0.5f, -z),
-				vec3(0.5f, 0.5f, -z)),  // 1st side
-
-			Triangle(vec3(0.0f, -0.5f, z),
-				vec3(-0.5f, 0.5f, -z),
-				vec3(-0.5f, -0.5f, -z)),
-			Triangle(vec3(0.0f, -0.5f, z),
-				vec3(0.0f, 0.5f, z),
-				vec3(-0.5f, 0.5f, -z)),  // 2nd side
-
-			Triangle(vec3(0.5f, -0.5f, -z),
-				vec3(0.0f, 0.5f, z),
-				vec3(0.0f, -0.5f, z)),
-			Triangle(vec3(0.5f, -0.5f, -z),
-				vec3(0.5f, 0.5f, -z),
-				vec3(0.0f, 0.5f, z)) // 3rd side
-	});
+	std::vector<vec3> positions = {
+		vec3(-0.5f, 0.5f, -z), // a
+		vec3(0.0f, 0.5f, z), // b
+		vec3(0.5f, 0.5f, -z), // c
+		vec3(-0.5f, -0.5f, -z), // d
+		vec3(0.5f, -0.5f, -z), // e
+		vec3(0.0f, -0.5f, z) // f
+	};
+	std::vector<int> indices = {
+		0, 1, 2, // top
+		3, 4, 5, // bottom
+		3, 2, 4,
+		3, 0, 2, // 1st side
+		5, 0, 3,
+		5, 1, 0, // 2nd side
+		4, 1, 5,
+		4, 2, 1 // 3rd side
+	};
+	return std::make_shared<TriangleMesh>(positions, indices);
 }
-
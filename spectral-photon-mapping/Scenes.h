@@ -1,7 +1,10 @@
 #pragma once
 #include <memory>
+#include <random>
 #include "Scene.h"
 #include "Mesh.h"
+#include "TriangleMesh.h"
+#include "MeshLoader.h"
 #include "Box.h"
 #include "Sphere.h"
 #include "Disk.h"
@@ -28,6 +31,19 @@ std::shared_ptr<Scene<RayTracerAccel>> furnaceTestScene();
 template<class RayTracerAccel>
 std::shared_ptr<Scene<RayTracerAccel>> createCornwellBox();
 
+template<class RayTracerAccel>
+std::shared_ptr<Scene<RayTracerAccel>> createInstancedPrismScene(int countX = 32, int countZ = 32);
+
+// mesh from OBJ or PLY file fitted into box of given size on the floor
+template<class RayTracerAccel>
+std::shared_ptr<Scene<RayTracerAccel>> createMeshScene(const std::string& filename, float size = 20.0f);
+
+// grid of small area lights of different power above glass prisms, benchmark for light sampling
+template<class RayTracerAccel>
+std::shared_ptr<Scene<RayTracerAccel>> createManyLightsScene(int countX = 32, int countZ = 32);
+
+spTriangleMesh createPrism(float scale = 0.5f);
+
 
 template<class RayTracerAccel>
 std::shared_ptr<Scene<RayTracerAccel>> createPrismScene() {
@@ -365,4 +381,143 @@ std::shared_ptr<Scene<RayTracerAccel>> createCornwellBox() {
 	/*scene->addLight(rectLight3);
 	scene->addLight(rectLight4);*/
 	return scene;
+}
+
+// single prism mesh shared by countX * countZ instances
+template<class RayTracerAccel>
+std::shared_ptr<Scene<RayTracerAccel>> createInstancedPrismScene(int countX, int countZ) {
+	std::shared_ptr<Scene<RayTracerAccel>> scene = std::make_shared<Scene<RayTracerAccel>>();
+	spShape prismShape = createPrism();
+	spShape floorShape = std::make_shared<Rect>();
+	spColorSampler white(new ConstantSampler(0.9f));
+	spTex<spColorSampler> whiteTexture = makeConstTex<spColorSampler>(white);
+	spColorSampler refraction = std::make_shared<AnalyticalSampler<CauchyEquation>>(BK7);
+	spTex<spColorSampler> refractionTexture = makeConstTex<spColorSampler>(refraction);
+	Spectral::spMaterial whiteDiffuse = Spectral::makeDiffuseMat(whiteTexture);
+	Spectral::spMaterial glass = std::make_shared<Spectral::IdealGlassMaterial>(whiteTexture, whiteTexture, refractionTexture);
+	const float spacing = 3.0f;
+	// own generator with fixed seed, so benchmarks get the same scene in every run
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+	std::vector<Affine> transforms;
+	transforms.reserve(countX * countZ);
+	for (int j = 0; j < countZ; ++j) {
+		for (int i = 0; i < countX; ++i) {
+			vec3 position((i - 0.5f * (countX - 1)) * spacing, 1.0f, (j - 0.5f * (countZ - 1)) * spacing);
+			transforms.push_back(Affine(Transform(position,
+				glm::angleAxis(angle(generator), vec3(0.0f, 1.0f, 0.0f)),
+				vec3(2.0f))));
+		}
+	}
+	scene->addInstances(prismShape, glass, transforms);
+	scene->addPrimitive(std::make_shared<Primitive>(
+		floorShape,
+		whiteDiffuse,
+		Affine(Transform(vec3(0.0f),
+			quat(),
+			vec3(1000.0f)))
+		));
+	spColorSampler lightColorSpectrum = std::make_shared<ConstantSampler>(5.0f);
+	std::shared_ptr<Rect> lightRect = std::make_shared<Rect>(vec2(countX * spacing, countZ * spacing));
+	scene->addLight(std::make_shared<DiffuseAreaLight>(
+		Affine(Transform(vec3(0.0f, 50.0f, 0.0f),
+			glm::angleAxis(glm::radians(180.0f), vec3(0.0f, 0.0f, 1.0f)),
+			vec3(1.0f, 1.0f, 1.0f))),
+		lightColorSpectrum,
+		lightRect
+		));
+	return scene;
+}
+
+template<class RayTracerAccel>
+std::shared_ptr<Scene<RayTracerAccel>> createMeshScene(const std::string& filename, float size) {
+	std::shared_ptr<Scene<RayTracerAccel>> scene = std::make_shared<Scene<RayTracerAccel>>();
+	MeshLoader::Stats stats;
+	spTriangleMesh mesh = MeshLoader::load(filename, &stats);
+	MeshLoader::printStats(stats);
+	BBox3D bounds = mesh->bbox();
+	vec3 extent = bounds.size();
+	float scale = size / std::max(extent.x, std::max(extent.y, extent.z));
+	vec3 offset = -vec3(bounds.center().x, bounds.min().y, bounds.center().z) * scale;
+	spShape floorShape = std::make_shared<Rect>();
+	spColorSampler white(new ConstantSampler(0.9f));
+	spTex<spColorSampler> whiteTexture = makeConstTex<spColorSampler>(white);
+	Spectral::spMaterial whiteDiffuse = Spectral::makeDiffuseMat(whiteTexture);
+	scene->addPrimitive(std::make_shared<Primitive>(
+		mesh,
+		whiteDiffuse,
+		Affine(Transform(offset,
+			quat(),
+			vec3(scale)))
+		));
+	scene->addPrimitive(std::make_shared<Primitive>(
+		floorShape,
+		whiteDiffuse,
+		Affine(Transform(vec3(0.0f),
+			quat(),
+			vec3(1000.0f)))
+		));
+	spColorSampler lightColorSpectrum = std::make_shared<ConstantSampler>(5.0f);
+	std::shared_ptr<Rect> lightRect = std::make_shared<Rect>(vec2(size, size));
+	scene->addLight(std::make_shared<DiffuseAreaLight>(
+		Affine(Transform(vec3(0.0f, 3.0f * size, 0.0f),
+			glm::angleAxis(glm::radians(180.0f), vec3(0.0f, 0.0f, 1.0f)),
+			vec3(1.0f, 1.0f, 1.0f))),
+		lightColorSpectrum,
+		lightRect
+		));
+	return scene;
+}
+
+template<class RayTracerAccel>
+std::shared_ptr<Scene<RayTracerAccel>> createManyLightsScene(int countX, int countZ) {
+	std::shared_ptr<Scene<RayTracerAccel>> scene = std::make_shared<Scene<RayTracerAccel>>();
+	spShape prismShape = createPrism();
+	spShape floorShape = std::make_shared<Rect>();
+	spColorSampler white(new ConstantSampler(0.9f));
+	spTex<spColorSampler> whiteTexture = makeConstTex<spColorSampler>(white);
+	spColorSampler refraction = std::make_shared<AnalyticalSampler<CauchyEquation>>(BK7);
+	spTex<spColorSampler> refractionTexture = makeConstTex<spColorSampler>(refraction);
+	Spectral::spMaterial whiteDiffuse = Spectral::makeDiffuseMat(whiteTexture);
+	Spectral::spMaterial glass = std::make_shared<Spectral::IdealGlassMaterial>(whiteTexture, whiteTexture, refractionTexture);
+	const float spacing = 3.0f;
+	// own generator with fixed seed, so benchmarks get the same scene in every run
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+	std::uniform_real_distribution<float> height(6.0f, 10.0f);
+	std::uniform_real_distribution<float> powerExponent(0.0f, 2.0f);
+	std::vector<Affine> transforms;
+	for (int j = 0; j < countZ; j += 4) {
+		for (int i = 0; i < countX; i += 4) {
+			vec3 position((i - 0.5f * (countX - 1)) * spacing, 1.0f, (j - 0.5f * (countZ - 1)) * spacing);
+			transforms.push_back(Affine(Transform(position,
+				glm::angleAxis(angle(generator), vec3(0.0f, 1.0f, 0.0f)),
+				vec3(2.0f))));
+		}
+	}
+	scene->addInstances(prismShape, glass, transforms);
+	scene->addPrimitive(std::make_shared<Primitive>(
+		floorShape,
+		whiteDiffuse,
+		Affine(Transform(vec3(0.0f),
+			quat(),
+			vec3(1000.0f)))
+		));
+	// lights face down, power differs by two orders of magnitude
+	std::shared_ptr<Rect> lightRect = std::make_shared<Rect>(vec2(0.5f, 0.5f));
+	for (int j = 0; j < countZ; ++j) {
+		for (int i = 0; i < countX; ++i) {
+			vec3 position((i - 0.5f * (countX - 1)) * spacing, height(generator), (j - 0.5f * (countZ - 1)) * spacing);
+			spColorSampler lightColorSpectrum = std::make_shared<ConstantSampler>(std::pow(10.0f, powerExponent(generator)));
+			scene->addLight(std::make_shared<DiffuseAreaLight>(
+				Affine(Transform(position,
+					glm::angleAxis(glm::radians(180.0f), vec3(0.0f, 0.0f, 1.0f)),
+					vec3(1.0f, 1.0f, 1.0f))),
+				lightColorSpectrum,
+				lightRect
+				));
+		}
+	}
+	scene->setLightSampler(LightSamplerType::BVH);
+	return scene;
 }
\ No newline at end of file
@@ -2,6 +2,13 @@
 #include "Scene.h"
 
 
+BBox3D Shape::clippedBBox(const BBox3D& box, const Affine& transform) const {
+	BBox3D local = clippedBBox(transform.inverse().transform(box));
+	if (local.isEmpty())
+		return local;
+	return intersectionOp(transform.transform(local), box);
+}
+
 float Shape::pdf(const vec3& pos, const vec3& wi, const Affine& transform) const {
 	HitInfo tHit;
 	Ray localRay = transform.transformInverse(Ray(pos, wi));
@@ -40,6 +40,13 @@ struct Interval {
 class Shape {
 public:
 	virtual BBox3D bbox() const = 0;
+	// bounds of part of shape inside box, used by spatial split builders
+	virtual BBox3D clippedBBox(const BBox3D& box) const {
+		return intersectionOp(bbox(), box);
+	}
+	// bounds of part of transformed shape inside world box, used for instances
+	// box is mapped to local space conservatively by default, shapes with known geometry should clip in world space
+	virtual BBox3D clippedBBox(const BBox3D& box, const Affine& transform) const;
 	virtual bool intersect(const Ray& ray) const = 0;
 	virtual bool intersect(const Ray& ray, HitInfo& hitInfo) const = 0;
 	virtual std::vector<Interval> intersectionList(const Ray& ray) const {
@@ -47,8 +54,14 @@ public:
 	}
 	virtual float area() const = 0;
 	virtual float pdf() const { return 1.0f / area(); }
-	virtual HitInfo sample() const = 0;
+	// uniform point on surface for u in [0, 1)^2
+	virtual HitInfo sample(const vec2& u) const = 0;
 	virtual float pdf(const vec3& pos, const vec3& wi, const Affine& transform) const;
+	// cone containing all surface normals, by default any direction
+	virtual void normalBounds(vec3& axis, float& cosTheta) const {
+		axis = vec3(0.0f, 0.0f, 1.0f);
+		cosTheta = -1.0f;
+	}
 };
 
 using spShape = std::shared_ptr<Shape>;
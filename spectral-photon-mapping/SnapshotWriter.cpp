@@ -0,0 +1,81 @@
+#include "SnapshotWriter.h"
+
+#include <algorithm>
+
+#include "ImageIO.h"
+
+
+SnapshotWriter::SnapshotWriter(const std::string& filename)
+	: filename(filename)
+{
+	thread = std::thread(&SnapshotWriter::run, this);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeUp.notify_one();
+	thread.join();
+}
+
+void SnapshotWriter::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wakeUp.wait(lock, [this] { return pending || stopping; });
+		if (!pending)
+			return;
+		// front film is not touched by render while pending, so it is written without lock
+		lock.unlock();
+		bool success = ImageIO::writePPM(filename, *front);
+		lock.lock();
+		pending = false;
+		if (success)
+			written++;
+		else
+			failed++;
+	}
+}
+
+bool SnapshotWriter::idle() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return !pending;
+}
+
+Image<rgb>& SnapshotWriter::film(int width, int height) {
+	if (!back || back->width() != width || back->height() != height)
+		back = std::make_unique<Image<rgb>>(width, height, rgb(0.0f));
+	return *back;
+}
+
+bool SnapshotWriter::submit() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!back)
+			return false;
+		if (pending) {
+			skipped++;
+			return false;
+		}
+		std::swap(front, back);
+		pending = true;
+	}
+	wakeUp.notify_one();
+	return true;
+}
+
+int SnapshotWriter::writtenCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return written;
+}
+
+int SnapshotWriter::skippedCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return skipped;
+}
+
+int SnapshotWriter::failedCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed;
+}
\ No newline at end of file
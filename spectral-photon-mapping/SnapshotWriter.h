@@ -0,0 +1,45 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Color.h"
+#include "Image.h"
+
+
+// Writes snapshots of render in progress on background thread, so render never waits for disk
+// Film is double buffered: render resolves estimate into back film while writer thread writes front one,
+// snapshot submitted while previous one is still written is skipped
+// Snapshots are written by ImageIO::writePPM, which replaces file atomically, so viewers never see partial image
+class SnapshotWriter {
+	std::string filename;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::unique_ptr<Image<rgb>> front;
+	std::unique_ptr<Image<rgb>> back;
+	// front film waits for writer thread or is being written
+	bool pending = false;
+	bool stopping = false;
+	int written = 0;
+	int skipped = 0;
+	int failed = 0;
+	std::thread thread;
+	void run();
+public:
+	explicit SnapshotWriter(const std::string& filename);
+	// writes pending snapshot before returning
+	~SnapshotWriter();
+	SnapshotWriter(const SnapshotWriter&) = delete;
+	SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+	// false while previous snapshot is still written, render should skip resolving new one
+	bool idle();
+	// back film of given size, owned by render until submit
+	Image<rgb>& film(int width, int height);
+	// swaps films and wakes writer thread, returns false and drops film if writer is busy
+	bool submit();
+	int writtenCount();
+	int skippedCount();
+	int failedCount();
+};
\ No newline at end of file
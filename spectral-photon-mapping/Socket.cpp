@@ -0,0 +1,114 @@
+#include "Socket.h"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#undef min
+#undef max
+#pragma comment(lib, "ws2_32.lib")
+
+
+namespace {
+	void initializeWinsock() {
+		struct Winsock {
+			Winsock() {
+				WSADATA data;
+				if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+					throw std::runtime_error("Cannot initialize Winsock");
+			}
+			~Winsock() {
+				WSACleanup();
+			}
+		};
+		static Winsock winsock;
+	}
+}
+
+Socket::Socket(uintptr_t handle) : handle(handle)
+{}
+
+Socket Socket::listen(uint16_t port, int backlog) {
+	initializeWinsock();
+	SOCKET listening = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listening == INVALID_SOCKET)
+		throw std::runtime_error("Cannot create socket");
+	Socket result(listening);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (::bind(listening, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+		::listen(listening, backlog) == SOCKET_ERROR)
+		throw std::runtime_error("Cannot listen on port " + std::to_string(port));
+	return result;
+}
+
+Socket Socket::connect(const std::string& host, uint16_t port) {
+	initializeWinsock();
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+		throw std::runtime_error("Cannot resolve " + host);
+	for (addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+		SOCKET connection = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (connection == INVALID_SOCKET)
+			continue;
+		if (::connect(connection, address->ai_addr, int(address->ai_addrlen)) == 0) {
+			freeaddrinfo(addresses);
+			return Socket(connection);
+		}
+		closesocket(connection);
+	}
+	freeaddrinfo(addresses);
+	throw std::runtime_error("Cannot connect to " + host + ":" + std::to_string(port));
+}
+
+Socket::Socket(Socket&& other) : handle(other.handle) {
+	other.handle = INVALID_SOCKET;
+}
+
+Socket& Socket::operator=(Socket&& other) {
+	std::swap(handle, other.handle);
+	return *this;
+}
+
+Socket::~Socket() {
+	if (handle != INVALID_SOCKET)
+		closesocket(handle);
+}
+
+Socket Socket::accept() {
+	SOCKET connection = ::accept(handle, nullptr, nullptr);
+	if (connection == INVALID_SOCKET)
+		throw std::runtime_error("Cannot accept connection");
+	return Socket(connection);
+}
+
+void Socket::send(const void* data, size_t size) {
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0) {
+		int sent = ::send(handle, bytes, int(std::min<size_t>(size, INT_MAX)), 0);
+		if (sent == SOCKET_ERROR)
+			throw std::runtime_error("Cannot send data");
+		bytes += sent;
+		size -= sent;
+	}
+}
+
+void Socket::receive(void* data, size_t size) {
+	char* bytes = static_cast<char*>(data);
+	while (size > 0) {
+		int received = ::recv(handle, bytes, int(std::min<size_t>(size, INT_MAX)), 0);
+		if (received == SOCKET_ERROR)
+			throw std::runtime_error("Cannot receive data");
+		if (received == 0)
+			throw std::runtime_error("Connection closed");
+		bytes += received;
+		size -= received;
+	}
+}
\ No newline at end of file
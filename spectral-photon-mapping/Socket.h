@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+
+// Blocking TCP connection or listening socket, throws std::runtime_error if anything fails
+class Socket {
+	// SOCKET handle, kept as integer so users do not need Winsock headers
+	uintptr_t handle;
+	explicit Socket(uintptr_t handle);
+public:
+	// listens on all interfaces
+	static Socket listen(uint16_t port, int backlog);
+	static Socket connect(const std::string& host, uint16_t port);
+	Socket(Socket&& other);
+	Socket& operator=(Socket&& other);
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+	~Socket();
+	// waits for next connection to listening socket
+	Socket accept();
+	void send(const void* data, size_t size);
+	// waits until whole buffer is received
+	void receive(void* data, size_t size);
+	template<class T>
+	void send(const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are sent as bytes");
+		send(&value, sizeof(T));
+	}
+	template<class T>
+	T receive() {
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are received as bytes");
+		T value;
+		receive(&value, sizeof(T));
+		return value;
+	}
+};
\ No newline at end of file
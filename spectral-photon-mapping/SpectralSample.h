@@ -0,0 +1,83 @@
+#pragma once
+#include <emmintrin.h>
+
+#include "common.h"
+
+// Four spectral values processed together with SSE
+// Lane 0 belongs to hero wavelength, lanes 1-3 to its rotated companions
+// Lanes are kept unaligned, so samples may live inside heap allocated BxDFs and photons
+class SpectralSample {
+	float lanes[4];
+	__m128 load() const {
+		return _mm_loadu_ps(lanes);
+	}
+	void store(const __m128& v) {
+		_mm_storeu_ps(lanes, v);
+	}
+public:
+	static const int Size = 4;
+	SpectralSample() {
+		store(_mm_setzero_ps());
+	}
+	SpectralSample(float value) {
+		store(_mm_set1_ps(value));
+	}
+	SpectralSample(float a, float b, float c, float d) {
+		store(_mm_setr_ps(a, b, c, d));
+	}
+	explicit SpectralSample(const __m128& v) {
+		store(v);
+	}
+	float operator[](int i) const {
+		return lanes[i];
+	}
+	float& operator[](int i) {
+		return lanes[i];
+	}
+	SpectralSample& operator+=(const SpectralSample& b) {
+		store(_mm_add_ps(load(), b.load()));
+		return *this;
+	}
+	SpectralSample& operator-=(const SpectralSample& b) {
+		store(_mm_sub_ps(load(), b.load()));
+		return *this;
+	}
+	SpectralSample& operator*=(const SpectralSample& b) {
+		store(_mm_mul_ps(load(), b.load()));
+		return *this;
+	}
+	SpectralSample& operator/=(const SpectralSample& b) {
+		store(_mm_div_ps(load(), b.load()));
+		return *this;
+	}
+	friend SpectralSample operator+(const SpectralSample& a, const SpectralSample& b) {
+		return SpectralSample(_mm_add_ps(a.load(), b.load()));
+	}
+	friend SpectralSample operator-(const SpectralSample& a, const SpectralSample& b) {
+		return SpectralSample(_mm_sub_ps(a.load(), b.load()));
+	}
+	friend SpectralSample operator*(const SpectralSample& a, const SpectralSample& b) {
+		return SpectralSample(_mm_mul_ps(a.load(), b.load()));
+	}
+	friend SpectralSample operator/(const SpectralSample& a, const SpectralSample& b) {
+		return SpectralSample(_mm_div_ps(a.load(), b.load()));
+	}
+	float maxComponent() const {
+		__m128 v = load();
+		__m128 m = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(m);
+	}
+	bool isBlack() const {
+		return _mm_movemask_ps(_mm_cmpneq_ps(load(), _mm_setzero_ps())) == 0;
+	}
+	// true if all lanes hold the same value
+	bool isUniform() const {
+		__m128 v = load();
+		return _mm_movemask_ps(_mm_cmpneq_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)))) == 0;
+	}
+	// drops companions, hero value is scaled so that average over lanes stays unbiased
+	SpectralSample heroOnly() const {
+		return SpectralSample(lanes[0] * Size, 0.0f, 0.0f, 0.0f);
+	}
+};
\ No newline at end of file
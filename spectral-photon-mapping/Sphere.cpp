@@ -61,9 +61,9 @@ std::vector<Interval> Sphere::intersectionList(const Ray& ray) const {
 		t1, glm::normalize(ray.ro + ray.rd * t1 - center)} };
 }
 
-HitInfo Sphere::sample() const {
+HitInfo Sphere::sample(const vec2& u) const {
 	HitInfo result;
-	result.localPosition = radius * Sampling::uniformSphere() + center;
+	result.localPosition = radius * Sampling::uniformSphere(u) + center;
 	result.normal = glm::normalize(result.localPosition - center);
 	return result;
 }
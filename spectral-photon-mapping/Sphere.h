@@ -10,6 +10,6 @@ public:
 	virtual bool intersect(const Ray& ray) const override;
 	virtual bool intersect(const Ray& ray, HitInfo& hitInfo) const override;
 	virtual std::vector<Interval> intersectionList(const Ray& ray) const override;
-	virtual HitInfo sample() const override;
+	virtual HitInfo sample(const vec2& u) const override;
 	virtual float area() const override;
 };
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+
+namespace Stats {
+	namespace {
+		struct Registry {
+			std::mutex mutex;
+			std::vector<Detail::ThreadCounters*> threads;
+			// counts of finished threads
+			Counters finished;
+		};
+		Registry& registry() {
+			static Registry registry;
+			return registry;
+		}
+	}
+
+	uint64_t Counters::operator[](Counter counter) const {
+		return values[int(counter)];
+	}
+
+	Counters& Counters::operator+=(const Counters& other) {
+		for (int i = 0; i < int(Counter::Count); ++i)
+			values[i] += other.values[i];
+		return *this;
+	}
+
+	Counters operator-(const Counters& a, const Counters& b) {
+		Counters result;
+		for (int i = 0; i < int(Counter::Count); ++i)
+			result.values[i] = a.values[i] - b.values[i];
+		return result;
+	}
+
+	Counters collect() {
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		Counters result = r.finished;
+		for (const auto* thread : r.threads) {
+			for (int i = 0; i < int(Counter::Count); ++i)
+				result.values[i] += thread->values[i].load(std::memory_order_relaxed);
+		}
+		return result;
+	}
+
+	void print(const Counters& counters, const char* title) {
+#if RENDER_STATS
+		auto ratio = [](uint64_t a, uint64_t b) {
+			return b > 0 ? double(a) / b : 0.0;
+		};
+		uint64_t rays = counters[Counter::ClosestRays] + counters[Counter::AnyHitRays];
+		printf("%s statistics:\n", title);
+		printf("  Rays: %llu closest hit, %llu any hit\n", counters[Counter::ClosestRays], counters[Counter::AnyHitRays]);
+		printf("  Traversal: %llu nodes (%.2f per ray), %llu primitive tests (%.2f per ray)\n",
+			counters[Counter::NodesVisited], ratio(counters[Counter::NodesVisited], rays),
+			counters[Counter::PrimitiveTests], ratio(counters[Counter::PrimitiveTests], rays));
+		printf("  Photons: %llu emitted, %llu stored, %llu discarded by roulette\n",
+			counters[Counter::PhotonsEmitted], counters[Counter::PhotonsStored], counters[Counter::PhotonsDiscarded]);
+		printf("  Lookups: %llu queries, %llu candidates (%.2f per query), %llu accepted (%.1f %%)\n",
+			counters[Counter::PointQueries], counters[Counter::GatherCandidates], ratio(counters[Counter::GatherCandidates], counters[Counter::PointQueries]),
+			counters[Counter::GatherAccepted], 100.0 * ratio(counters[Counter::GatherAccepted], counters[Counter::GatherCandidates]));
+		printf("  BSDF: %llu calls\n", counters[Counter::BSDFCalls]);
+#else
+		(void)counters;
+		printf("%s statistics: disabled by RENDER_STATS\n", title);
+#endif
+	}
+
+	namespace Detail {
+		ThreadCounters::ThreadCounters() {
+			for (auto& value : values)
+				value.store(0, std::memory_order_relaxed);
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			r.threads.push_back(this);
+		}
+
+		ThreadCounters::~ThreadCounters() {
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			for (int i = 0; i < int(Counter::Count); ++i)
+				r.finished.values[i] += values[i].load(std::memory_order_relaxed);
+			r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+		}
+	}
+}
\ No newline at end of file
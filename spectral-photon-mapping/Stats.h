@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// RENDER_STATS 0 compiles counting out, counters then stay zero
+#ifndef RENDER_STATS
+#define RENDER_STATS 1
+#endif
+
+
+// Counters of rendering work for profiling
+// Each thread counts into block of its own, blocks are summed only when counters are collected,
+// so counting never contends between threads. Hot loops should count locally and add once per query.
+namespace Stats {
+	enum class Counter {
+		// closest hit queries of scene
+		ClosestRays,
+		// any hit queries, e.g. shadow rays
+		AnyHitRays,
+		// bounding boxes tested by primitive locators and mesh hierarchies
+		NodesVisited,
+		// tests of scene primitives and of triangle packs inside meshes
+		PrimitiveTests,
+		// photon paths started from lights
+		PhotonsEmitted,
+		// photons left in photon maps, backward rendering only
+		PhotonsStored,
+		// photon paths ended by russian roulette
+		PhotonsDiscarded,
+		// searches of photons or visibility points around point
+		PointQueries,
+		// points found by searches and those passing normal and primitive test
+		GatherCandidates,
+		GatherAccepted,
+		// calls of Material::bsdf
+		BSDFCalls,
+		Count
+	};
+	struct Counters {
+		uint64_t values[int(Counter::Count)] = {};
+		uint64_t operator[](Counter counter) const;
+		Counters& operator+=(const Counters& other);
+	};
+	Counters operator-(const Counters& a, const Counters& b);
+	// counts of all threads, including finished ones, threads keep counting
+	Counters collect();
+	void print(const Counters& counters, const char* title);
+
+	namespace Detail {
+		// registers itself for collect and adds its counts to totals of finished threads on thread exit
+		struct ThreadCounters {
+			std::atomic<uint64_t> values[int(Counter::Count)];
+			ThreadCounters();
+			~ThreadCounters();
+			ThreadCounters(const ThreadCounters&) = delete;
+			ThreadCounters& operator=(const ThreadCounters&) = delete;
+		};
+		inline ThreadCounters& threadCounters() {
+			thread_local ThreadCounters counters;
+			return counters;
+		}
+	}
+	// thread is the only writer of its counters, so relaxed load and store need no locked instruction
+	inline void add(Counter counter, uint64_t value) {
+		std::atomic<uint64_t>& count = Detail::threadCounters().values[int(counter)];
+		count.store(count.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+}
+
+#if RENDER_STATS
+#define STATS_ADD(counter, value) ::Stats::add(::Stats::Counter::counter, value)
+#else
+#define STATS_ADD(counter, value) ((void)sizeof(value))
+#endif
+#define STATS_INC(counter) STATS_ADD(counter, 1)
\ No newline at end of file
@@ -5,6 +5,8 @@ template<class T>
 class Texture {
 public:
 	virtual const T sample(const HitInfo& hitInfo) const = 0;
+	// visits every value texture may return
+	virtual void forEachValue(const std::function<void(const T&)>& visitor) const = 0;
 	virtual ~Texture() {}
 };
 
@@ -18,6 +20,9 @@ public:
 	virtual const T sample(const HitInfo& hitInfo) const override {
 		return value;
 	}
+	virtual void forEachValue(const std::function<void(const T&)>& visitor) const override {
+		visitor(value);
+	}
 };
 
 template<class T>
@@ -35,6 +40,10 @@ public:
 		}
 		return white;
 	}
+	virtual void forEachValue(const std::function<void(const T&)>& visitor) const override {
+		visitor(black);
+		visitor(white);
+	}
 };
 
 template<class T>
@@ -52,6 +61,10 @@ public:
 		}
 		return white;
 	}
+	virtual void forEachValue(const std::function<void(const T&)>& visitor) const override {
+		visitor(black);
+		visitor(white);
+	}
 };
 
 template<class T>
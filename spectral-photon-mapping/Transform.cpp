@@ -92,7 +92,7 @@ BBox3D Affine::transform(const BBox3D& bbox) const {
 	points[1] = vec3(_direct * vec4(bbox._min.x, bbox._min.y, bbox._max.z, 1.0));
 	points[2] = vec3(_direct * vec4(bbox._min.x, bbox._max.y, bbox._min.z, 1.0));
 	points[3] = vec3(_direct * vec4(bbox._min.x, bbox._max.y, bbox._max.z, 1.0));
-	points[4] = vec3(_direct * vec4(bbox._min.x, bbox._max.y, bbox._min.z, 1.0));
+	points[4] = vec3(_direct * vec4(bbox._max.x, bbox._min.y, bbox._max.z, 1.0));
 	points[5] = vec3(_direct * vec4(bbox._max.x, bbox._min.y, bbox._min.z, 1.0));
 	points[6] = vec3(_direct * vec4(bbox._max.x, bbox._max.y, bbox._min.z, 1.0));
 	points[7] = vec3(_direct * vec4(bbox._max, 1.0));
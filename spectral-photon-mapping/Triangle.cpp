@@ -1,13 +1,12 @@
 ﻿#include "Triangle.h"
 
 
-Triangle::Triangle(const vec3& p0, const vec3& p1, const vec3& p2) : _v0(p0), _v1(p1), _v2(p2)
+Triangle::Triangle(const vec3& p0, const vec3& p1, const vec3& p2) : _v0(p0), _v1(p1), _v2(p2), _e1(p1 - p0), _e2(p2 - p0)
 {
-	vec3 v20 = p2 - p0;
-	vec3 v10 = p1 - p0;
-	_normal = glm::cross(v10, v20);
-	_area = glm::length(_normal);
-	_normal = _normal / _area;
+	_normal = glm::cross(_e1, _e2);
+	float length = glm::length(_normal);
+	_area = 0.5f * length;
+	_normal = _normal / length;
 }
 const vec3& Triangle::v0() const {
 	return _v0;
@@ -24,10 +23,54 @@ BBox3D Triangle::bbox() const {
 	return BBox3D(min, max);
 }
 
+BBox3D Triangle::clippedBBox(const BBox3D& box) const {
+	return clip(_v0, _v1, _v2, box);
+}
+
+BBox3D Triangle::clippedBBox(const BBox3D& box, const Affine& transform) const {
+	return clip(transform.transformPoint(_v0), transform.transformPoint(_v1), transform.transformPoint(_v2), box);
+}
+
+BBox3D Triangle::clip(const vec3& v0, const vec3& v1, const vec3& v2, const BBox3D& box) {
+	// triangle clipped by 6 planes has at most 9 vertices
+	vec3 polygon[2][9] = { { v0, v1, v2 } };
+	int count = 3;
+	int current = 0;
+	for (int dim = 0; dim < 3 && count > 0; ++dim) {
+		for (int side = 0; side < 2 && count > 0; ++side) {
+			float plane = side == 0 ? box.min()[dim] : box.max()[dim];
+			float sign = side == 0 ? 1.0f : -1.0f;
+			const vec3* in = polygon[current];
+			vec3* out = polygon[1 - current];
+			int outCount = 0;
+			for (int i = 0; i < count; ++i) {
+				const vec3& a = in[i];
+				const vec3& b = in[(i + 1) % count];
+				float da = sign * (a[dim] - plane);
+				float db = sign * (b[dim] - plane);
+				if (da >= 0.0f)
+					out[outCount++] = a;
+				if ((da < 0.0f) != (db < 0.0f)) {
+					vec3 p = glm::mix(a, b, da / (da - db));
+					// keep intersection exactly on plane despite rounding
+					p[dim] = plane;
+					out[outCount++] = p;
+				}
+			}
+			count = outCount;
+			current = 1 - current;
+		}
+	}
+	BBox3D result;
+	for (int i = 0; i < count; ++i)
+		result.append(polygon[current][i]);
+	return intersectionOp(result, box);
+}
+
 bool Triangle::intersect(const Ray& ray) const {
 	const float Epsilon = 0.0000001f;
-	vec3 v10 = _v1 - _v0;
-	vec3 v20 = _v2 - _v0;
+	const vec3& v10 = _e1;
+	const vec3& v20 = _e2;
 	vec3 h = glm::cross(ray.rd, v20);
 	float a = glm::dot(v10, h);
 	if (a > -Epsilon && a < Epsilon)
@@ -49,8 +92,8 @@ bool Triangle::intersect(const Ray& ray) const {
 }
 bool Triangle::intersect(const Ray& ray, HitInfo& hitInfo) const {
 	const float Epsilon = 0.0000001f;
-	vec3 v10 = _v1 - _v0;
-	vec3 v20 = _v2 - _v0;
+	const vec3& v10 = _e1;
+	const vec3& v20 = _e2;
 	vec3 h = glm::cross(ray.rd, v20);
 	float a = glm::dot(v10, h);
 	if (a > -Epsilon && a < Epsilon)
@@ -76,9 +119,14 @@ bool Triangle::intersect(const Ray& ray, HitInfo& hitInfo) const {
 float Triangle::area() const {
 	return _area;
 }
-HitInfo Triangle::sample() const {
+HitInfo Triangle::sample(const vec2& u) const {
 	HitInfo result;
-	result.localPosition = Sampling::uniformTriangle(_v0, _v1, _v2);
+	result.localPosition = Sampling::uniformTriangle(_v0, _v1, _v2, u);
 	result.normal = _normal;
 	return result;
+}
+
+void Triangle::normalBounds(vec3& axis, float& cosTheta) const {
+	axis = _normal;
+	cosTheta = 1.0f;
 }
\ No newline at end of file
@@ -6,6 +6,9 @@ class Triangle : public Shape {
 	vec3 _v0;
 	vec3 _v1;
 	vec3 _v2;
+	// edges are precomputed for intersection tests
+	vec3 _e1;
+	vec3 _e2;
 	vec3 _normal;
 	float _area;
 public:
@@ -14,9 +17,15 @@ public:
 	const vec3& v1() const;
 	const vec3& v2() const;
 	virtual BBox3D bbox() const override;
+	// Sutherland-Hodgman clipping of triangle against box planes
+	static BBox3D clip(const vec3& v0, const vec3& v1, const vec3& v2, const BBox3D& box);
+	virtual BBox3D clippedBBox(const BBox3D& box) const override;
+	// vertices are transformed, so clipping stays exact
+	virtual BBox3D clippedBBox(const BBox3D& box, const Affine& transform) const override;
 	//Moller–Trumbore intersection algorithm
 	virtual bool intersect(const Ray& ray) const override;
 	virtual bool intersect(const Ray& ray, HitInfo& hitInfo) const override;
 	virtual float area() const override;
-	virtual HitInfo sample() const override;
+	virtual HitInfo sample(const vec2& u) const override;
+	virtual void normalBounds(vec3& axis, float& cosTheta) const override;
 };
\ No newline at end of file
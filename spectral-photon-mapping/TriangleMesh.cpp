@@ -0,0 +1,539 @@
+#include "TriangleMesh.h"
+
+#include <cstring>
+
+#include "Stats.h"
+
+
+TriangleMesh::TriangleMesh(std::vector<vec3> positions, std::vector<int> indices,
+	std::vector<vec3> normals, std::vector<vec2> uvs, IntersectionMode mode)
+	: positions(std::move(positions))
+	, normals(std::move(normals))
+	, uvs(std::move(uvs))
+	, indices(std::move(indices))
+	, mode(mode)
+{
+	assert(this->indices.size() % 3 == 0);
+	assert(this->normals.empty() || this->normals.size() == this->positions.size());
+	assert(this->uvs.empty() || this->uvs.size() == this->positions.size());
+	buildAccelerator();
+}
+
+TriangleMesh::IntersectionMode TriangleMesh::intersectionMode() const {
+	return mode;
+}
+
+void TriangleMesh::setIntersectionMode(IntersectionMode mode) {
+	if (this->mode == mode)
+		return;
+	this->mode = mode;
+	// tree stays the same, only records are rebuilt
+	for (auto& pack : packs) {
+		for (int lane = 0; lane < PackSize; ++lane) {
+			if (pack.triangleId[lane] != -1)
+				fillPackLane(pack, lane, pack.triangleId[lane]);
+		}
+	}
+}
+
+int TriangleMesh::numTriangles() const {
+	return indices.size() / 3;
+}
+
+int TriangleMesh::numVertices() const {
+	return positions.size();
+}
+
+Triangle TriangleMesh::triangle(int triangleId) const {
+	return Triangle(positions[indices[3 * triangleId]], positions[indices[3 * triangleId + 1]], positions[indices[3 * triangleId + 2]]);
+}
+
+size_t TriangleMesh::memoryUsage() const {
+	return positions.capacity() * sizeof(vec3) +
+		normals.capacity() * sizeof(vec3) +
+		uvs.capacity() * sizeof(vec2) +
+		indices.capacity() * sizeof(int) +
+		nodes.capacity() * sizeof(Node) +
+		packs.capacity() * sizeof(TrianglePack) +
+		// cdf and values
+		2 * (numTriangles() + 1) * sizeof(float);
+}
+
+vec3 TriangleMesh::geometricNormal(int triangleId) const {
+	const vec3& p0 = positions[indices[3 * triangleId]];
+	const vec3& p1 = positions[indices[3 * triangleId + 1]];
+	const vec3& p2 = positions[indices[3 * triangleId + 2]];
+	return glm::normalize(glm::cross(p1 - p0, p2 - p0));
+}
+
+void TriangleMesh::buildAccelerator() {
+	int count = numTriangles();
+	std::vector<int> triangleIds(count);
+	std::vector<AABB> bounds(count);
+	std::vector<vec3> centroids(count);
+	std::vector<float> areas(count);
+	_area = 0.0f;
+	for (int i = 0; i < count; ++i) {
+		const vec3& p0 = positions[indices[3 * i]];
+		const vec3& p1 = positions[indices[3 * i + 1]];
+		const vec3& p2 = positions[indices[3 * i + 2]];
+		triangleIds[i] = i;
+		bounds[i] = BBox3D(glm::min(p0, glm::min(p1, p2)), glm::max(p0, glm::max(p1, p2)));
+		centroids[i] = bounds[i].center();
+		areas[i] = 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0));
+		_area += areas[i];
+	}
+	nodes.clear();
+	packs.clear();
+	if (count == 0)
+		return;
+	nodes.reserve(2 * (count / PackSize + 1));
+	packs.reserve(count / PackSize + 1);
+	// heuristic from pbrt book
+	int maxDepth = std::round(8 + 1.3f * glm::log2(float(count)));
+	build(triangleIds, bounds, centroids, 0, count, maxDepth);
+	areaDistribution = std::make_unique<Distribution1D>(areas.begin(), areas.end());
+}
+
+void TriangleMesh::addLeaf(const std::vector<int>& triangleIds, int begin, int end, int nodeId) {
+	int firstPack = packs.size();
+	for (int i = begin; i < end; i += PackSize) {
+		TrianglePack pack;
+		memset(&pack, 0, sizeof(TrianglePack));
+		for (int lane = 0; lane < PackSize; ++lane) {
+			if (i + lane >= end) {
+				pack.triangleId[lane] = -1;
+				continue;
+			}
+			fillPackLane(pack, lane, triangleIds[i + lane]);
+		}
+		packs.push_back(pack);
+	}
+	nodes[nodeId].firstChild = firstPack;
+	nodes[nodeId].secondChild = packs.size();
+}
+
+void TriangleMesh::fillPackLane(TrianglePack& pack, int lane, int triangleId) const {
+	vec3 p0 = positions[indices[3 * triangleId]];
+	vec3 p1 = positions[indices[3 * triangleId + 1]];
+	vec3 p2 = positions[indices[3 * triangleId + 2]];
+	if (mode == IntersectionMode::Fast) {
+		// edges are shared by all rays
+		p1 -= p0;
+		p2 -= p0;
+	}
+	for (int dim = 0; dim < 3; ++dim) {
+		pack.p[0][dim][lane] = p0[dim];
+		pack.p[1][dim][lane] = p1[dim];
+		pack.p[2][dim][lane] = p2[dim];
+	}
+	pack.triangleId[lane] = triangleId;
+}
+
+int TriangleMesh::build(std::vector<int>& triangleIds, const std::vector<AABB>& bounds, const std::vector<vec3>& centroids, int begin, int end, int depth) {
+	int nodeId = nodes.size();
+	AABB nodeBounds;
+	AABB centroidBounds;
+	for (int i = begin; i < end; ++i) {
+		nodeBounds.append(bounds[triangleIds[i]]);
+		centroidBounds.append(centroids[triangleIds[i]]);
+	}
+	nodes.emplace_back(Node::Type::Leaf, 0, 0, nodeBounds);
+	int count = end - begin;
+	if (count <= PackSize || depth <= 0) {
+		addLeaf(triangleIds, begin, end, nodeId);
+		return nodeId;
+	}
+	// binned SAH over centroids
+	const int BucketCount = 12;
+	const float TTraverse = 0.125f;
+	const float TInters = 1.0f / PackSize;
+	struct Bucket {
+		AABB bbox;
+		int count = 0;
+	};
+	float minCost = std::numeric_limits<float>::max();
+	int minCostPlane = -1;
+	int minDim = -1;
+	for (int dim = 0; dim < 3; ++dim) {
+		float extent = centroidBounds.size()[dim];
+		if (extent <= 0.0f)
+			continue;
+		Bucket buckets[BucketCount];
+		for (int i = begin; i < end; ++i) {
+			int triangleId = triangleIds[i];
+			int bucketId = std::min(BucketCount - 1, int(BucketCount * (centroids[triangleId][dim] - centroidBounds.min()[dim]) / extent));
+			buckets[bucketId].count++;
+			buckets[bucketId].bbox.append(bounds[triangleId]);
+		}
+		// sweep from the right to get areas of right sides
+		float rightAreas[BucketCount];
+		int rightCounts[BucketCount];
+		AABB rightBBox;
+		int rightCount = 0;
+		for (int planeId = BucketCount - 1; planeId > 0; --planeId) {
+			rightBBox.append(buckets[planeId].bbox);
+			rightCount += buckets[planeId].count;
+			rightAreas[planeId] = rightBBox.area();
+			rightCounts[planeId] = rightCount;
+		}
+		AABB leftBBox;
+		int leftCount = 0;
+		for (int planeId = 1; planeId < BucketCount; ++planeId) {
+			leftBBox.append(buckets[planeId - 1].bbox);
+			leftCount += buckets[planeId - 1].count;
+			if (leftCount == 0 || rightCounts[planeId] == 0)
+				continue;
+			float cost = TTraverse + TInters * (leftCount * leftBBox.area() + rightCounts[planeId] * rightAreas[planeId]) / nodeBounds.area();
+			if (cost < minCost) {
+				minCost = cost;
+				minCostPlane = planeId;
+				minDim = dim;
+			}
+		}
+	}
+	int middle = begin;
+	if (minDim == -1) {
+		// all centroids are in one point
+		addLeaf(triangleIds, begin, end, nodeId);
+		return nodeId;
+	}
+	if (minCost < TInters * count) {
+		float extent = centroidBounds.size()[minDim];
+		float minValue = centroidBounds.min()[minDim];
+		int* midPtr = std::partition(&triangleIds[begin], &triangleIds[end - 1] + 1,
+			[&](int triangleId) {
+			int bucketId = std::min(BucketCount - 1, int(BucketCount * (centroids[triangleId][minDim] - minValue) / extent));
+			return bucketId < minCostPlane;
+		});
+		middle = midPtr - &triangleIds[0];
+	}
+	else if (count <= 4 * PackSize) {
+		addLeaf(triangleIds, begin, end, nodeId);
+		return nodeId;
+	}
+	if (middle == begin || middle == end) {
+		middle = (begin + end) / 2;
+		int dim = centroidBounds.maxExtentDirection();
+		std::nth_element(&triangleIds[begin], &triangleIds[middle], &triangleIds[end - 1] + 1,
+			[&](int a, int b) {
+			return centroids[a][dim] < centroids[b][dim];
+		});
+	}
+	int firstChild = build(triangleIds, bounds, centroids, begin, middle, depth - 1);
+	int secondChild = build(triangleIds, bounds, centroids, middle, end, depth - 1);
+	nodes[nodeId].type = Node::Type::Inter;
+	nodes[nodeId].firstChild = firstChild;
+	nodes[nodeId].secondChild = secondChild;
+	return nodeId;
+}
+
+int TriangleMesh::intersectPack(const TrianglePack& pack, const Ray& ray, const WatertightRay& wRay, float& t, float& u, float& v) const {
+	if (mode == IntersectionMode::Watertight)
+		return intersectPackWatertight(pack, ray, wRay, t, u, v);
+	return intersectPackFast(pack, ray, t, u, v);
+}
+
+// selects closest of hit lanes
+static int closestLane(int hits, const __m128& tt, const __m128& uu, const __m128& vv, float& t, float& u, float& v) {
+	alignas(16) float ts[TriangleMesh::PackSize];
+	alignas(16) float us[TriangleMesh::PackSize];
+	alignas(16) float vs[TriangleMesh::PackSize];
+	_mm_store_ps(ts, tt);
+	_mm_store_ps(us, uu);
+	_mm_store_ps(vs, vv);
+	int closest = -1;
+	for (int lane = 0; lane < TriangleMesh::PackSize; ++lane) {
+		if ((hits & (1 << lane)) && (closest == -1 || ts[lane] < ts[closest]))
+			closest = lane;
+	}
+	t = ts[closest];
+	u = us[closest];
+	v = vs[closest];
+	return closest;
+}
+
+int TriangleMesh::intersectPackFast(const TrianglePack& pack, const Ray& ray, float& t, float& u, float& v) {
+	const __m128 Epsilon = _mm_set1_ps(0.0000001f);
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 One = _mm_set1_ps(1.0f);
+	const __m128 AbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 dx = _mm_set1_ps(ray.rd.x);
+	const __m128 dy = _mm_set1_ps(ray.rd.y);
+	const __m128 dz = _mm_set1_ps(ray.rd.z);
+	const __m128 e1x = _mm_load_ps(pack.p[1][0]);
+	const __m128 e1y = _mm_load_ps(pack.p[1][1]);
+	const __m128 e1z = _mm_load_ps(pack.p[1][2]);
+	const __m128 e2x = _mm_load_ps(pack.p[2][0]);
+	const __m128 e2y = _mm_load_ps(pack.p[2][1]);
+	const __m128 e2z = _mm_load_ps(pack.p[2][2]);
+	// h = cross(rd, e2)
+	__m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+	__m128 mask = _mm_cmpgt_ps(_mm_and_ps(a, AbsMask), Epsilon);
+	__m128 f = _mm_div_ps(One, a);
+	// s = ro - v0
+	__m128 sx = _mm_sub_ps(_mm_set1_ps(ray.ro.x), _mm_load_ps(pack.p[0][0]));
+	__m128 sy = _mm_sub_ps(_mm_set1_ps(ray.ro.y), _mm_load_ps(pack.p[0][1]));
+	__m128 sz = _mm_sub_ps(_mm_set1_ps(ray.ro.z), _mm_load_ps(pack.p[0][2]));
+	__m128 uu = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(uu, Zero), _mm_cmple_ps(uu, One)));
+	// q = cross(s, e1)
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	__m128 vv = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(vv, Zero), _mm_cmple_ps(_mm_add_ps(uu, vv), One)));
+	__m128 tt = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(tt, _mm_set1_ps(ray.tMin)), _mm_cmple_ps(tt, _mm_set1_ps(ray.tMax))));
+	int hits = _mm_movemask_ps(mask);
+	if (hits == 0)
+		return -1;
+	return closestLane(hits, tt, uu, vv, t, u, v);
+}
+
+TriangleMesh::WatertightRay::WatertightRay(const Ray& ray) {
+	vec3 absDir = glm::abs(ray.rd);
+	kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+	kx = (kz + 1) % 3;
+	ky = (kx + 1) % 3;
+	// keep winding of triangles
+	if (ray.rd[kz] < 0.0f)
+		std::swap(kx, ky);
+	sx = ray.rd[kx] / ray.rd[kz];
+	sy = ray.rd[ky] / ray.rd[kz];
+	sz = 1.0f / ray.rd[kz];
+}
+
+int TriangleMesh::intersectPackWatertight(const TrianglePack& pack, const Ray& ray, const WatertightRay& wRay, float& t, float& u, float& v) {
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 sx = _mm_set1_ps(wRay.sx);
+	const __m128 sy = _mm_set1_ps(wRay.sy);
+	const __m128 sz = _mm_set1_ps(wRay.sz);
+	const __m128 ox = _mm_set1_ps(ray.ro[wRay.kx]);
+	const __m128 oy = _mm_set1_ps(ray.ro[wRay.ky]);
+	const __m128 oz = _mm_set1_ps(ray.ro[wRay.kz]);
+	// vertices relative to ray origin in permuted and sheared space
+	__m128 x[3], y[3], z[3];
+	for (int i = 0; i < 3; ++i) {
+		__m128 pz = _mm_sub_ps(_mm_load_ps(pack.p[i][wRay.kz]), oz);
+		x[i] = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(pack.p[i][wRay.kx]), ox), _mm_mul_ps(sx, pz));
+		y[i] = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(pack.p[i][wRay.ky]), oy), _mm_mul_ps(sy, pz));
+		z[i] = _mm_mul_ps(sz, pz);
+	}
+	// scaled barycentrics
+	__m128 U = _mm_sub_ps(_mm_mul_ps(x[2], y[1]), _mm_mul_ps(y[2], x[1]));
+	__m128 V = _mm_sub_ps(_mm_mul_ps(x[0], y[2]), _mm_mul_ps(y[0], x[2]));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(x[1], y[0]), _mm_mul_ps(y[1], x[0]));
+	__m128 valid = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(pack.triangleId)), _mm_set1_epi32(-1)));
+	__m128 onEdge = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(U, Zero), _mm_cmpeq_ps(V, Zero)), _mm_cmpeq_ps(W, Zero));
+	int edgeLanes = _mm_movemask_ps(_mm_and_ps(onEdge, valid));
+	if (edgeLanes != 0) {
+		// recompute in double precision when ray passes exactly through an edge
+		alignas(16) float xs[3][PackSize], ys[3][PackSize];
+		alignas(16) float us[PackSize], vs[PackSize], ws[PackSize];
+		for (int i = 0; i < 3; ++i) {
+			_mm_store_ps(xs[i], x[i]);
+			_mm_store_ps(ys[i], y[i]);
+		}
+		_mm_store_ps(us, U);
+		_mm_store_ps(vs, V);
+		_mm_store_ps(ws, W);
+		for (int lane = 0; lane < PackSize; ++lane) {
+			if (!(edgeLanes & (1 << lane)))
+				continue;
+			us[lane] = float(double(xs[2][lane]) * ys[1][lane] - double(ys[2][lane]) * xs[1][lane]);
+			vs[lane] = float(double(xs[0][lane]) * ys[2][lane] - double(ys[0][lane]) * xs[2][lane]);
+			ws[lane] = float(double(xs[1][lane]) * ys[0][lane] - double(ys[1][lane]) * xs[0][lane]);
+		}
+		U = _mm_load_ps(us);
+		V = _mm_load_ps(vs);
+		W = _mm_load_ps(ws);
+	}
+	// barycentrics must have same sign, no backface culling
+	__m128 anyNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(U, Zero), _mm_cmplt_ps(V, Zero)), _mm_cmplt_ps(W, Zero));
+	__m128 anyPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(U, Zero), _mm_cmpgt_ps(V, Zero)), _mm_cmpgt_ps(W, Zero));
+	__m128 mask = _mm_andnot_ps(_mm_and_ps(anyNegative, anyPositive), valid);
+	__m128 det = _mm_add_ps(_mm_add_ps(U, V), W);
+	mask = _mm_and_ps(mask, _mm_cmpneq_ps(det, Zero));
+	if (_mm_movemask_ps(mask) == 0)
+		return -1;
+	__m128 T = _mm_add_ps(_mm_add_ps(_mm_mul_ps(U, z[0]), _mm_mul_ps(V, z[1])), _mm_mul_ps(W, z[2]));
+	__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	__m128 tt = _mm_mul_ps(T, invDet);
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(tt, _mm_set1_ps(ray.tMin)), _mm_cmple_ps(tt, _mm_set1_ps(ray.tMax))));
+	int hits = _mm_movemask_ps(mask);
+	if (hits == 0)
+		return -1;
+	// U weights v0, V weights v1 and W weights v2
+	return closestLane(hits, tt, _mm_mul_ps(V, invDet), _mm_mul_ps(W, invDet), t, u, v);
+}
+
+BBox3D TriangleMesh::bbox() const {
+	if (nodes.empty())
+		return BBox3D();
+	return nodes[0].bbox;
+}
+
+BBox3D TriangleMesh::clippedBBox(const BBox3D& box) const {
+	return clip(box, nullptr);
+}
+
+BBox3D TriangleMesh::clippedBBox(const BBox3D& box, const Affine& transform) const {
+	return clip(box, &transform);
+}
+
+BBox3D TriangleMesh::clip(const BBox3D& box, const Affine* transform) const {
+	BBox3D result;
+	if (nodes.empty())
+		return result;
+	std::vector<int> nodeStack(1, 0);
+	while (!nodeStack.empty()) {
+		const Node& current = nodes[nodeStack.back()];
+		nodeStack.pop_back();
+		// bounds of transformed node are conservative, so they are taken whole only if they stay inside box
+		BBox3D nodeBounds = transform ? transform->transform(current.bbox) : current.bbox;
+		if (intersectionOp(nodeBounds, box).isEmpty())
+			continue;
+		if (box.contains(nodeBounds)) {
+			result = unionOp(result, nodeBounds);
+			continue;
+		}
+		if (current.type != Node::Leaf) {
+			nodeStack.push_back(current.secondChild);
+			nodeStack.push_back(current.firstChild);
+			continue;
+		}
+		for (unsigned int i = current.firstChild; i < current.secondChild; ++i) {
+			for (int lane = 0; lane < PackSize; ++lane) {
+				int triangleId = packs[i].triangleId[lane];
+				if (triangleId == -1)
+					continue;
+				vec3 p0 = positions[indices[3 * triangleId]];
+				vec3 p1 = positions[indices[3 * triangleId + 1]];
+				vec3 p2 = positions[indices[3 * triangleId + 2]];
+				if (transform) {
+					p0 = transform->transformPoint(p0);
+					p1 = transform->transformPoint(p1);
+					p2 = transform->transformPoint(p2);
+				}
+				result = unionOp(result, Triangle::clip(p0, p1, p2, box));
+			}
+		}
+	}
+	return result;
+}
+
+bool TriangleMesh::intersect(const Ray& ray) const {
+	if (nodes.empty())
+		return false;
+	WatertightRay wRay(ray);
+	// counted locally, so traversal touches thread counters once
+	uint64_t visited = 0;
+	uint64_t tests = 0;
+	const int MaxStackSize = 64;
+	int nodeStack[MaxStackSize];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize != 0) {
+		const Node& current = nodes[nodeStack[--stackSize]];
+		visited++;
+		if (!current.bbox.intersect(ray))
+			continue;
+		if (current.type != Node::Leaf) {
+			assert(stackSize + 2 <= MaxStackSize);
+			nodeStack[stackSize++] = current.secondChild;
+			nodeStack[stackSize++] = current.firstChild;
+			continue;
+		}
+		for (unsigned int i = current.firstChild; i < current.secondChild; ++i) {
+			float t, u, v;
+			tests++;
+			if (intersectPack(packs[i], ray, wRay, t, u, v) != -1) {
+				STATS_ADD(NodesVisited, visited);
+				STATS_ADD(PrimitiveTests, tests);
+				return true;
+			}
+		}
+	}
+	STATS_ADD(NodesVisited, visited);
+	STATS_ADD(PrimitiveTests, tests);
+	return false;
+}
+
+bool TriangleMesh::intersect(const Ray& ray, HitInfo& hitInfo) const {
+	if (nodes.empty())
+		return false;
+	Ray tRay = ray;
+	WatertightRay wRay(ray);
+	int hitTriangle = -1;
+	float hitU = 0.0f;
+	float hitV = 0.0f;
+	uint64_t visited = 0;
+	uint64_t tests = 0;
+	const int MaxStackSize = 64;
+	int nodeStack[MaxStackSize];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+	while (stackSize != 0) {
+		const Node& current = nodes[nodeStack[--stackSize]];
+		visited++;
+		if (!current.bbox.intersect(tRay))
+			continue;
+		if (current.type != Node::Leaf) {
+			assert(stackSize + 2 <= MaxStackSize);
+			nodeStack[stackSize++] = current.secondChild;
+			nodeStack[stackSize++] = current.firstChild;
+			continue;
+		}
+		tests += current.secondChild - current.firstChild;
+		for (unsigned int i = current.firstChild; i < current.secondChild; ++i) {
+			float t, u, v;
+			int lane = intersectPack(packs[i], tRay, wRay, t, u, v);
+			if (lane == -1)
+				continue;
+			tRay.tMax = t;
+			hitTriangle = packs[i].triangleId[lane];
+			hitU = u;
+			hitV = v;
+		}
+	}
+	STATS_ADD(NodesVisited, visited);
+	STATS_ADD(PrimitiveTests, tests);
+	if (hitTriangle == -1)
+		return false;
+	int i0 = indices[3 * hitTriangle];
+	int i1 = indices[3 * hitTriangle + 1];
+	int i2 = indices[3 * hitTriangle + 2];
+	float w = 1.0f - hitU - hitV;
+	hitInfo.t = tRay.tMax;
+	hitInfo.localPosition = tRay(tRay.tMax);
+	if (normals.empty())
+		hitInfo.normal = geometricNormal(hitTriangle);
+	else
+		hitInfo.normal = glm::normalize(normals[i0] * w + normals[i1] * hitU + normals[i2] * hitV);
+	if (uvs.empty())
+		hitInfo.uv = vec2(hitU, hitV);
+	else
+		hitInfo.uv = uvs[i0] * w + uvs[i1] * hitU + uvs[i2] * hitV;
+	return true;
+}
+
+float TriangleMesh::area() const {
+	return _area;
+}
+
+HitInfo TriangleMesh::sample(const vec2& u) const {
+	HitInfo result;
+	float pdf;
+	vec2 r = u;
+	int triangleId = areaDistribution->sampleDiscrete(u.x, pdf, r.x);
+	const vec3& p0 = positions[indices[3 * triangleId]];
+	const vec3& p1 = positions[indices[3 * triangleId + 1]];
+	const vec3& p2 = positions[indices[3 * triangleId + 2]];
+	result.localPosition = Sampling::uniformTriangle(p0, p1, p2, r);
+	result.normal = geometricNormal(triangleId);
+	return result;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "Shape.h"
+#include "Triangle.h"
+
+#include <emmintrin.h>
+
+
+// Indexed triangle mesh with shared vertex buffers and own BVH
+// BVH leaves hold packs of 4 triangles in SoA layout, tested with one SSE kernel
+class TriangleMesh : public Shape {
+public:
+	static const int PackSize = 4;
+	enum class IntersectionMode {
+		// Moller-Trumbore over precomputed edges, may miss rays through shared edges
+		Fast,
+		// Woop, Benthin, Wald "Watertight Ray/Triangle Intersection", no gaps between adjacent triangles
+		Watertight
+	};
+	// intersection record of 4 triangles, built once in buildAccelerator
+	struct alignas(16) TrianglePack {
+		// p[vertex][dim][lane]
+		// Fast: v0, v1 - v0, v2 - v0
+		// Watertight: v0, v1, v2
+		float p[3][3][PackSize];
+		// index of triangle in index buffer, -1 for empty lanes
+		int triangleId[PackSize];
+	};
+private:
+	// per ray constants of watertight test: axis permutation and shear
+	struct WatertightRay {
+		int kx, ky, kz;
+		float sx, sy, sz;
+		WatertightRay(const Ray& ray);
+	};
+	struct Node {
+		enum Type : unsigned int {
+			Leaf = 0,
+			Inter = 1
+		};
+		// for leaf [firstChild, secondChild) is range of packs
+		unsigned int type : 1, firstChild : 31;
+		unsigned int secondChild;
+		AABB bbox;
+		Node(unsigned int type, unsigned int firstChild, unsigned int secondChild, const BBox3D& bbox)
+			:type(type), firstChild(firstChild), secondChild(secondChild), bbox(bbox)
+		{}
+	};
+	std::vector<vec3> positions;
+	std::vector<vec3> normals;
+	std::vector<vec2> uvs;
+	std::vector<int> indices;
+	std::vector<Node> nodes;
+	std::vector<TrianglePack> packs;
+	std::unique_ptr<Distribution1D> areaDistribution;
+	float _area;
+	IntersectionMode mode;
+	void buildAccelerator();
+	int build(std::vector<int>& triangleIds, const std::vector<AABB>& bounds, const std::vector<vec3>& centroids, int begin, int end, int depth);
+	void addLeaf(const std::vector<int>& triangleIds, int begin, int end, int nodeId);
+	void fillPackLane(TrianglePack& pack, int lane, int triangleId) const;
+	// returns lane of closest hit or -1
+	int intersectPack(const TrianglePack& pack, const Ray& ray, const WatertightRay& wRay, float& t, float& u, float& v) const;
+	static int intersectPackFast(const TrianglePack& pack, const Ray& ray, float& t, float& u, float& v);
+	static int intersectPackWatertight(const TrianglePack& pack, const Ray& ray, const WatertightRay& wRay, float& t, float& u, float& v);
+	vec3 geometricNormal(int triangleId) const;
+	// clips triangles of nodes partially inside box, nodes completely inside it are taken whole
+	// transform may be null
+	BBox3D clip(const BBox3D& box, const Affine* transform) const;
+public:
+	// normals and uvs are optional and should be empty or have same size as positions
+	TriangleMesh(std::vector<vec3> positions, std::vector<int> indices,
+		std::vector<vec3> normals = std::vector<vec3>(), std::vector<vec2> uvs = std::vector<vec2>(),
+		IntersectionMode mode = IntersectionMode::Watertight);
+	IntersectionMode intersectionMode() const;
+	// rebuilds intersection records if mode differs
+	void setIntersectionMode(IntersectionMode mode);
+	int numTriangles() const;
+	int numVertices() const;
+	// standalone copy of triangle, for building external accelerators over mesh
+	Triangle triangle(int triangleId) const;
+	// memory used by buffers and accelerator in bytes
+	size_t memoryUsage() const;
+	virtual BBox3D bbox() const override;
+	virtual BBox3D clippedBBox(const BBox3D& box) const override;
+	virtual BBox3D clippedBBox(const BBox3D& box, const Affine& transform) const override;
+	virtual bool intersect(const Ray& ray) const override;
+	virtual bool intersect(const Ray& ray, HitInfo& hitInfo) const override;
+	virtual float area() const override;
+	virtual HitInfo sample(const vec2& u) const override;
+};
+
+using spTriangleMesh = std::shared_ptr<TriangleMesh>;
@@ -4,14 +4,17 @@
 #undef max
 #include <spectral-photon-mapping\common.h>
 #include <spectral-photon-mapping\Image.h>
+#include <spectral-photon-mapping\ImageIO.h>
 #include <spectral-photon-mapping\Color.h>
 #include <spectral-photon-mapping\Timer.h>
 #include <spectral-photon-mapping\Progress.h>
 #include <spectral-photon-mapping\SPPM.h>
+#include <spectral-photon-mapping\Distributed.h>
 #include <spectral-photon-mapping\Debug.h>
 #include <spectral-photon-mapping\Camera.h>
 #include <spectral-photon-mapping\Accelerators\Primitive Locators\KdTree.h>
 #include <spectral-photon-mapping\Accelerators\Primitive Locators\AABBTree.h>
+#include <spectral-photon-mapping\Accelerators\Primitive Locators\QuantizedAABBTree.h>
 #include <spectral-photon-mapping\Accelerators\Primitive Locators\Grid.h>
 #include <spectral-photon-mapping\Accelerators\Primitive Locators\BruteForce.h>
 #include <spectral-photon-mapping\Accelerators\Point Locators\KdTree.h>
@@ -21,30 +24,40 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include <fstream>
 #include <algorithm>
 #include <time.h>
 #pragma comment(lib, "winmm.lib")
 
 void saveImagePPM(const char* filename, const Image<rgb>& image) {
-	std::ofstream file;
-	file.open(filename, std::ofstream::out | std::ofstream::trunc);
-	if (!file.is_open()) {
-		printf("Error. Cannot open file \"%s\"", filename);
-	}
-	file << "P3\n" << image.width() << " " << image.height() << "\n255\n";
-	for (int j = 0; j < image.height(); j++) {
-		for (int i = 0; i < image.width(); i++) {
-			// flip y direction
-			vec3 color = image(i, image.height() - j - 1);
-			color = glm::pow(color, vec3(1.0f / 2.2f));
-			int r = glm::clamp<int>(int(255.0f * color.r + 0.5f), 0, 255);
-			int g = glm::clamp<int>(int(255.0f * color.g + 0.5f), 0, 255);
-			int b = glm::clamp<int>(int(255.0f * color.b + 0.5f), 0, 255);
-			file << r << " " << g << " " << b << "\n";
-		}
-	}
-	file.close();
+	if (!ImageIO::writePPM(filename, image))
+		printf("Error. Cannot write file \"%s\"", filename);
+}
+
+// linear HDR values for compositing
+void saveImageEXR(const char* filename, const Image<rgb>& image) {
+	if (!ImageIO::writeEXR(filename, image))
+		printf("Error. Cannot write file \"%s\"", filename);
+}
+
+// grey levels relative to largest count
+Image<rgb> iterationCountsImage(const Image<float>& counts) {
+	float maxCount = 1.0f;
+	for (int j = 0; j < counts.height(); j++)
+		for (int i = 0; i < counts.width(); i++)
+			maxCount = std::max(maxCount, counts(i, j));
+	Image<rgb> image(counts.width(), counts.height(), rgb(0.0));
+	for (int j = 0; j < counts.height(); j++)
+		for (int i = 0; i < counts.width(); i++)
+			image(i, j) = rgb(counts(i, j) / maxCount);
+	return image;
+}
+
+void printRenderStats(const Spectral::SPPM::RenderStats& stats, const Stats::Counters& counters) {
+	printf("Iterations: %i, total: %f, photons: %f, camera paths: %f, search structures: %f, per iteration: %f\n",
+		stats.iterations, stats.totalTime, stats.photonTime, stats.cameraTime, stats.buildTime, stats.iterationTime());
+	Stats::print(counters, "Render");
 }
 
 std::string formatFilename() {
@@ -69,11 +82,21 @@ std::string formatFilename() {
 #define USE_GRID 1
 #define USE_KDTREE 2
 #define USE_BRUTEFORCE 3
+#define USE_SBVH 4
+#define USE_QUANTIZED_BVH 5
 #define USE_SCENE_ACCEL USE_BRUTEFORCE
 #if USE_SCENE_ACCEL == USE_AABBTREE
 #define SCENE_ACCEL_TYPE "AABBTree"
 #define PARAMETERS -1
-using PrimitiveAccelerator = PrimitiveLocators::AABBTree<Intersectable>;
+using PrimitiveAccelerator = PrimitiveLocators::AABBTree<Intersectable, PrimitiveLocators::BucketSAHTreeBuilder<Intersectable>>;
+#elif USE_SCENE_ACCEL == USE_SBVH
+#define SCENE_ACCEL_TYPE "SBVH"
+#define PARAMETERS -1
+using PrimitiveAccelerator = PrimitiveLocators::AABBTree<Intersectable, PrimitiveLocators::SpatialSplitTreeBuilder<Intersectable>>;
+#elif USE_SCENE_ACCEL == USE_QUANTIZED_BVH
+#define SCENE_ACCEL_TYPE "QuantizedBVH"
+#define PARAMETERS -1
+using PrimitiveAccelerator = PrimitiveLocators::QuantizedAABBTree<Intersectable, PrimitiveLocators::BucketSAHTreeBuilder<Intersectable>>;
 #elif USE_SCENE_ACCEL == USE_GRID
 #define SCENE_ACCEL_TYPE "Grid"
 using PrimitiveAccelerator = PrimitiveLocators::Grid<Intersectable>;
@@ -113,28 +136,34 @@ static_assert("Unknown macro", false);
 
 
 
-void renderCornellBox();
+void renderCornellBox(bool resume);
+void renderDistributedCornellBox(int workers);
+void compareRadiusReduction(float seconds);
+void runCornellBoxWorker(const char* host, uint16_t port, int workers);
 void renderPrismScene();
+void renderManyLightsScene();
 
 
 
-int main()
+int main(int argc, char* argv[])
 {
-	renderCornellBox();
+	// distributed render starts copies of this program as workers
+	if (argc == 5 && strcmp(argv[1], "worker") == 0) {
+		runCornellBoxWorker(argv[2], uint16_t(atoi(argv[3])), atoi(argv[4]));
+		return 0;
+	}
+	// "resume" continues render from its checkpoint, e.g. after it was killed
+	renderCornellBox(argc == 2 && strcmp(argv[1], "resume") == 0);
+	//renderDistributedCornellBox(4);
+	//compareRadiusReduction(60.0f);
 	//renderPrismScene();
+	//renderManyLightsScene();
 	PlaySound(TEXT("SystemStart"), NULL, SND_ALIAS);
 	getchar();
 	return 0;
 }
 
-void renderCornellBox() {
-	auto scene = createCornwellBox<PrimitiveAccelerator>();
-	scene->buildAccelerator(PARAMETERS);
-
-	Spectral::SPPM::Tracer<PrimitiveAccelerator> sppmTracer;
-	Debug::Tracer<PrimitiveAccelerator> debugTracer;
-
-	// setup settings
+Spectral::SPPM::Settings cornellBoxSettings() {
 	Spectral::SPPM::Settings settings;
 	settings.threads = 8;
 	settings.tileSize = 16;
@@ -142,17 +171,42 @@ void renderCornellBox() {
 	settings.iterations = 300;
 	settings.maxDepth = 8;
 	settings.initialRadius = 10.5f;
+	// resumed render continues where its last checkpoint ended, finished one is extended by raising iterations,
+	// checkpoint does not know scene and camera, so it is resumed only on request
+	settings.checkpointFilename = "cornell_box.checkpoint";
+	settings.checkpointInterval = 20;
+	// progress of long render can be watched in image viewer
+	settings.snapshotFilename = "cornell_box_progress.ppm";
+	settings.snapshotSeconds = 10.0f;
+	return settings;
+}
+
+std::shared_ptr<Camera> cornellBoxCamera(int width, int height) {
+	// Focal length  0.035
+	// Width, height 0.025x0.025
+	//2.0*atan(sensor_width / (2.0*focal_length))
+	return std::make_unique<Pinhole>(glm::radians(39.3076f) / 2.0f, 1.0f, 0.0f,
+		Affine::lookAt(vec3(278.0f, 273.0f, -800.0f), vec3(278.0f, 273.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)).inverse(),
+		height / float(width)
+		);
+}
+
+void renderCornellBox(bool resume) {
+	auto scene = createCornwellBox<PrimitiveAccelerator>();
+	scene->buildAccelerator(PARAMETERS);
+	printBakeErrors(scene->bakeSpectra());
+	scene->buildLightDistributions();
+
+	Spectral::SPPM::Tracer<PrimitiveAccelerator> sppmTracer;
+	Debug::Tracer<PrimitiveAccelerator> debugTracer;
+
+	Spectral::SPPM::Settings settings = cornellBoxSettings();
+	settings.resume = resume;
 	sppmTracer.setSettings(settings);
 	const int width = 256;
 	const int height = 256;
 	std::unique_ptr<Progress> progress = std::make_unique<ConsoleProgress>();
-	std::shared_ptr<Camera> camera = std::make_unique<Pinhole>(glm::radians(39.3076f) / 2.0f, 1.0f, 0.0f,
-		Affine::lookAt(vec3(278.0f, 273.0f, -800.0f), vec3(278.0f, 273.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)).inverse(),
-		height / float(width)
-		);
-	// Focal length  0.035
-	// Width, height 0.025x0.025
-	//2.0*atan(sensor_width / (2.0*focal_length))
+	std::shared_ptr<Camera> camera = cornellBoxCamera(width, height);
 	sppmTracer.setScene(scene);
 	sppmTracer.setCamera(camera);
 	debugTracer.setScene(scene);
@@ -169,15 +223,95 @@ void renderCornellBox() {
 	Image<rgb> image = sppmTracer.renderBackward<PointLocators::KdTree<Spectral::SPPM::SpectralPhoton>>(width, height, progress);
 	printf("\nTime for backward SPPM tracing (scene accel: %s): %f\n", SCENE_ACCEL_TYPE, timer.elapsed());
 #endif
-	std::string filename = formatFilename() + ".ppm";
-	saveImagePPM(filename.c_str(), image);
+	printRenderStats(sppmTracer.renderStats(), sppmTracer.renderCounters());
+	std::string filename = formatFilename();
+	saveImagePPM((filename + ".ppm").c_str(), image);
+	saveImageEXR((filename + ".exr").c_str(), image);
 
 }
 
 
+// SPPM and PPPM renders of Cornell box at equal time
+void compareRadiusReduction(float seconds) {
+	auto scene = createCornwellBox<PrimitiveAccelerator>();
+	scene->buildAccelerator(PARAMETERS);
+	printBakeErrors(scene->bakeSpectra());
+	scene->buildLightDistributions();
+	const int width = 256;
+	const int height = 256;
+	Spectral::SPPM::Tracer<PrimitiveAccelerator> sppmTracer;
+	sppmTracer.setScene(scene);
+	sppmTracer.setCamera(cornellBoxCamera(width, height));
+	const std::pair<Spectral::SPPM::RadiusReduction, const char*> reductions[] = {
+		{ Spectral::SPPM::RadiusReduction::PerPixel, "sppm" },
+		{ Spectral::SPPM::RadiusReduction::Probabilistic, "pppm" }
+	};
+	for (const auto& reduction : reductions) {
+		Spectral::SPPM::Settings settings = cornellBoxSettings();
+		settings.checkpointFilename.clear();
+		settings.timeBudget = seconds;
+		settings.radiusReduction = reduction.first;
+		sppmTracer.setSettings(settings);
+		std::unique_ptr<Progress> progress = std::make_unique<ConsoleProgress>();
+		Image<rgb> image = sppmTracer.renderBackward<PointLocators::KdTree<Spectral::SPPM::SpectralPhoton>>(width, height, progress);
+		printf("\n%s:\n", reduction.second);
+		printRenderStats(sppmTracer.renderStats(), sppmTracer.renderCounters());
+		std::string filename = formatFilename() + "_" + reduction.second + ".ppm";
+		saveImagePPM(filename.c_str(), image);
+	}
+}
+
+// workers split iterations of single render, radii of probabilistic reduction depend only on global iteration index,
+// so merged image averages the same kind of iteration estimates as PPPM render of all iterations in one process
+void renderDistributedCornellBox(int workers) {
+	const uint16_t port = 27015;
+	Spectral::SPPM::Distributed::Coordinator coordinator(port, workers);
+	char executable[MAX_PATH];
+	GetModuleFileNameA(NULL, executable, MAX_PATH);
+	for (int i = 0; i < workers; i++) {
+		std::string commandLine = std::string("\"") + executable + "\" worker localhost " + std::to_string(port) + " " + std::to_string(workers);
+		STARTUPINFOA startupInfo = { sizeof(startupInfo) };
+		PROCESS_INFORMATION processInfo;
+		if (!CreateProcessA(NULL, &commandLine[0], NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &startupInfo, &processInfo)) {
+			printf("Error. Cannot start worker %i", i);
+			return;
+		}
+		CloseHandle(processInfo.hProcess);
+		CloseHandle(processInfo.hThread);
+	}
+	std::unique_ptr<Progress> progress = std::make_unique<ConsoleProgress>();
+	Timer<float> timer;
+	Image<rgb> image = coordinator.run(progress);
+	printf("\nTime for distributed backward SPPM tracing (%i workers): %f\n", workers, timer.elapsed());
+	std::string filename = formatFilename() + "_distributed.ppm";
+	saveImagePPM(filename.c_str(), image);
+}
+
+void runCornellBoxWorker(const char* host, uint16_t port, int workers) {
+	auto scene = createCornwellBox<PrimitiveAccelerator>();
+	scene->buildAccelerator(PARAMETERS);
+	printBakeErrors(scene->bakeSpectra());
+	scene->buildLightDistributions();
+	const int width = 256;
+	const int height = 256;
+	Spectral::SPPM::Tracer<PrimitiveAccelerator> sppmTracer;
+	sppmTracer.setScene(scene);
+	sppmTracer.setCamera(cornellBoxCamera(width, height));
+	Spectral::SPPM::Settings settings = cornellBoxSettings();
+	settings.iterations = std::max(settings.iterations / workers, 1);
+	// per pixel reduction would shrink radii over iterations of one worker only, leaving more bias than single render
+	settings.radiusReduction = Spectral::SPPM::RadiusReduction::Probabilistic;
+	std::unique_ptr<Progress> progress = std::make_unique<ConsoleProgress>();
+	Spectral::SPPM::Distributed::work(host, port, sppmTracer, settings, [&](Spectral::SPPM::Tracer<PrimitiveAccelerator>& tracer) {
+		return tracer.renderBackward<PointLocators::KdTree<Spectral::SPPM::SpectralPhoton>>(width, height, progress);
+	});
+}
+
 void renderPrismScene() {
 	std::shared_ptr<Scene<PrimitiveAccelerator>> scene = createPrismScene<PrimitiveAccelerator>();
 	scene->buildAccelerator(PARAMETERS);
+	printBakeErrors(scene->bakeSpectra());
+	scene->buildLightDistributions();
 	Spectral::SPPM::Tracer<PrimitiveAccelerator> sppmTracer;
 	Debug::Tracer<PrimitiveAccelerator> debugTracer;
 	// setup settings
@@ -188,6 +322,14 @@ void renderPrismScene() {
 	settings.iterations = 400;
 	settings.maxDepth = 8;
 	settings.initialRadius = 2.5f;
+	// most uniform photons miss visibility points of caustics
+	settings.photonTracing = Spectral::SPPM::PhotonTracing::AdaptiveMarkovChain;
+	// sharp caustics of prism do not force small radius on smooth indirect light
+	settings.separateCaustics = true;
+	settings.causticPhotonsPerIteration = 40000;
+	settings.causticInitialRadius = 0.5f;
+	// flat floor converges early, its iterations go to caustics
+	settings.adaptive = true;
 	sppmTracer.setSettings(settings);
 	const int width = 256;
 	const int height = 256;
@@ -221,6 +363,8 @@ void renderPrismScene() {
 #ifdef RENDER_FORWARD
 	Image<rgb> image = sppmTracer.renderForward<VisPointSearch>(width, height, progress VISIBILITY_PARAMS);
 	printf("\nTime for forward SPPM tracing: %f\n", timer.elapsed());
+	for (const auto& stats : sppmTracer.photonTracingStats())
+		printf("Useful photons: %f, mutation size: %f, acceptance: %f\n", stats.usefulRatio(), stats.mutationSize, stats.acceptance);
 #else
 	Image<rgb> image = sppmTracer.renderBackward<PointLocators::KdTree<Spectral::SPPM::SpectralPhoton>>(width, height, progress);
 	//Image<rgb> image = debugTracer.renderAmbientOcclusion(width, height, 60, 0.1);
@@ -234,6 +378,52 @@ void renderPrismScene() {
 	});*/
 	std::string filename = formatFilename() + ".ppm";
 	saveImagePPM(filename.c_str(), image);
+	std::string iterationsFilename = formatFilename() + "_iterations.ppm";
+	saveImagePPM(iterationsFilename.c_str(), iterationCountsImage(sppmTracer.iterationCounts()));
+}
+
+// same time budget with uniform and BVH light choice, noise of direct lighting is compared on saved images
+void renderManyLightsScene() {
+	std::shared_ptr<Scene<PrimitiveAccelerator>> scene = createManyLightsScene<PrimitiveAccelerator>();
+	scene->buildAccelerator(PARAMETERS);
+	printBakeErrors(scene->bakeSpectra());
+	scene->buildLightDistributions();
+	printf("Lights: %i\n", scene->numLights());
+	Spectral::SPPM::Tracer<PrimitiveAccelerator> sppmTracer;
+	Spectral::SPPM::Settings settings;
+	settings.threads = 8;
+	settings.tileSize = 16;
+	settings.photonsPerIteration = 100000;
+	settings.iterations = 16;
+	settings.maxDepth = 8;
+	settings.initialRadius = 2.5f;
+	// light choice costs differ, so samplers are compared at equal time rather than equal iterations
+	settings.timeBudget = 30.0f;
+	// shadow rays and traversal work per iteration show cost of light sampler
+	settings.printStatistics = true;
+	sppmTracer.setSettings(settings);
+	const int width = 256;
+	const int height = 256;
+	std::shared_ptr<Camera> camera = std::make_unique<Pinhole>(glm::radians(55.0f) / 2.0f, 1.0f, 0.0f,
+		Affine::lookAt(vec3(0.0f, 43.0f, 80.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)).inverse(),
+		height / float(width)
+		);
+	sppmTracer.setScene(scene);
+	sppmTracer.setCamera(camera);
+	const std::pair<LightSamplerType, const char*> lightSamplers[] = {
+		{ LightSamplerType::Uniform, "uniform" },
+		{ LightSamplerType::BVH, "bvh" }
+	};
+	for (const auto& lightSampler : lightSamplers) {
+		scene->setLightSampler(lightSampler.first);
+		std::unique_ptr<Progress> progress = std::make_unique<ConsoleProgress>();
+		Timer<float> timer;
+		Image<rgb> image = sppmTracer.renderBackward<PointLocators::KdTree<Spectral::SPPM::SpectralPhoton>>(width, height, progress);
+		printf("\nTime for backward SPPM tracing (%s light sampler): %f\n", lightSampler.second, timer.elapsed());
+		printRenderStats(sppmTracer.renderStats(), sppmTracer.renderCounters());
+		std::string filename = formatFilename() + "_" + lightSampler.second + ".ppm";
+		saveImagePPM(filename.c_str(), image);
+	}
 }
 
 
@@ -4,10 +4,14 @@
 #include <spectral-photon-mapping/Timer.h>
 #include <spectral-photon-mapping/Random.h>
 #include <spectral-photon-mapping/Sampling.h>
+#include <spectral-photon-mapping/Stats.h>
 #include <spectral-photon-mapping/Accelerators/Primitive Locators/KdTree.h>
 #include <spectral-photon-mapping/Accelerators/Primitive Locators/AABBTree.h>
+#include <spectral-photon-mapping/Accelerators/Primitive Locators/QuantizedAABBTree.h>
 #include <spectral-photon-mapping/Accelerators/Primitive Locators/Grid.h>
 #include <spectral-photon-mapping/Accelerators/Primitive Locators/BruteForce.h>
+#include <spectral-photon-mapping/MeshLoader.h>
+#include <spectral-photon-mapping/Scenes.h>
 
 struct StatCounter {
 	double min;
@@ -151,7 +155,7 @@ void testPrimitiveAcceleratorPerformance(int numBoxes, int numCreations, int num
 	for (int i = 0; i < numPoints; ++i) {
 		Point point = { (vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5)) * sceneSize };
 		timer.restart();
-		std::vector<int> result = accel.intersectedIndicies<Point>(point);
+		std::vector<int> result = accel.template intersectedIndicies<Point>(point);
 		statCounter.advance(timer.elapsedAndRestart());
 	}
 	printf("Point primitive intersection time:\n");
@@ -210,7 +214,7 @@ void testPrimitiveAcceleratorResults(int numBoxes, int numRays, int numPoints, v
 	for (int i = 0; i < numPoints; ++i) {
 		Point point = { (vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5)) * sceneSize };
 		timer.restart();
-		std::vector<int> result = accel.intersectedIndicies<Point>(point);
+		std::vector<int> result = accel.template intersectedIndicies<Point>(point);
 		std::vector<int> result2;
 		for (int j = 0; j < boxes.size(); ++j) {
 			if (boxes[j].intersect(point)) {
@@ -233,8 +237,9 @@ void testPrimitiveAcceleratorResults(int numBoxes, int numRays, int numPoints, v
 	printf("Primitive-primitive intersection: %d\n", errors);
 }
 
-using SAHTree = PrimitiveLocators::AABBTree < BoxWrapper, PrimitiveLocators::SAHTreeBuilder<BoxWrapper>>;
-using EqualCounts = PrimitiveLocators::AABBTree <BoxWrapper, PrimitiveLocators::SplitEqualCountsTreeBuilder<BoxWrapper>>;
+using SAHTree = PrimitiveLocators::AABBTree < BoxWrapper, PrimitiveLocators::BucketSAHTreeBuilder<BoxWrapper>>;
+using EqualCounts = PrimitiveLocators::AABBTree <BoxWrapper, PrimitiveLocators::EqualCountsTreeBuilder<BoxWrapper>>;
+using SpatialSplitTree = PrimitiveLocators::AABBTree <BoxWrapper, PrimitiveLocators::SpatialSplitTreeBuilder<BoxWrapper>>;
 using BruteForce = PrimitiveLocators::BruteForce<BoxWrapper>;
 
 void runTestPrimitiveAccelerators() {
@@ -246,6 +251,9 @@ void runTestPrimitiveAccelerators() {
 	printf("\n");
 	printf("AABBTree Equal counts\n");
 	testPrimitiveAcceleratorPerformance<EqualCounts>(1000, 100, 100, 50, vec3(1.0), vec3(0.01), vec3(0.03), -1);
+	printf("\n");
+	printf("AABBTree spatial splits\n");
+	testPrimitiveAcceleratorPerformance<SpatialSplitTree>(1000, 100, 100, 50, vec3(1.0), vec3(0.01), vec3(0.03), -1);
 }
 
 void runTestPrimitiveResults() {
@@ -257,4 +265,232 @@ void runTestPrimitiveResults() {
 	printf("\n");
 	printf("AABBTree Equal counts\n");
 	testPrimitiveAcceleratorResults<EqualCounts>(1000, 1500, 1500, vec3(1.0), vec3(0.01), vec3(0.03), -1);
+	printf("\n");
+	printf("AABBTree spatial splits\n");
+	testPrimitiveAcceleratorResults<SpatialSplitTree>(1000, 1500, 1500, vec3(1.0), vec3(0.01), vec3(0.03), -1);
+}
+
+// builds tree over primitives and traces random rays inside its bounds
+// sah cost is expected number of visited nodes and primitive tests per ray, measured ones are counted by Stats,
+// for instances they include nodes and triangle packs of mesh hierarchies
+template<class Accel, class Iterator, class...Params>
+void benchmarkTreeBuilder(const char* name, int numRays, Iterator begin, Iterator end, Params...params) {
+	Timer<double> timer;
+	Accel accel(begin, end, params...);
+	double buildTime = timer.elapsedAndRestart();
+	BBox3D bounds = accel.bbox();
+	std::vector<Ray> rays(numRays);
+	for (auto& ray : rays) {
+		ray.ro = glm::mix(bounds.min(), bounds.max(), vec3(Random::random(), Random::random(), Random::random()));
+		ray.rd = Sampling::uniformSphere();
+	}
+	int hits = 0;
+	Stats::Counters before = Stats::collect();
+	timer.restart();
+	for (auto ray : rays) {
+		HitInfo hitInfo;
+		hits += accel.intersect(ray, hitInfo);
+	}
+	double traceTime = timer.elapsedAndRestart();
+	Stats::Counters counters = Stats::collect() - before;
+	printf("%s: build %f s, references %d, sah cost %f, %f Mrays/s, hits %d\n", name, buildTime,
+		accel.referenceCount(), accel.sahCost(), numRays / traceTime * 1e-6, hits);
+	printf("  per ray: %f nodes visited, %f primitive tests\n",
+		double(counters[Stats::Counter::NodesVisited]) / numRays, double(counters[Stats::Counter::PrimitiveTests]) / numRays);
+}
+
+template<class Primitive, class Iterator, class...Params>
+void compareTreeBuilders(int numRays, Iterator begin, Iterator end, Params...params) {
+	using namespace PrimitiveLocators;
+	benchmarkTreeBuilder<AABBTree<Primitive, EqualCountsTreeBuilder<Primitive>>>("Equal counts", numRays, begin, end, params...);
+	benchmarkTreeBuilder<AABBTree<Primitive, BucketSAHTreeBuilder<Primitive>>>("Bucket SAH", numRays, begin, end, params...);
+	benchmarkTreeBuilder<AABBTree<Primitive, SpatialSplitTreeBuilder<Primitive, 1, 10>>>("Spatial splits 10%", numRays, begin, end, params...);
+	benchmarkTreeBuilder<AABBTree<Primitive, SpatialSplitTreeBuilder<Primitive, 1, 30>>>("Spatial splits 30%", numRays, begin, end, params...);
+	benchmarkTreeBuilder<AABBTree<Primitive, SpatialSplitTreeBuilder<Primitive, 1, 100>>>("Spatial splits 100%", numRays, begin, end, params...);
+}
+
+// long diagonal boxes overlap a lot, worst case for object splits
+void runBenchmarkSpatialSplits(const std::string& meshFilename = "") {
+	const int NumRays = 100000;
+	std::vector<BoxWrapper> boxes;
+	for (int i = 0; i < 10000; i++) {
+		vec3 center = vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5);
+		vec3 size = glm::mix(vec3(0.2f, 0.002f, 0.002f), vec3(0.5f, 0.01f, 0.01f), Random::random());
+		boxes.emplace_back(center - size * 0.5f, center + size * 0.5f);
+	}
+	printf("Thin boxes\n");
+	compareTreeBuilders<BoxWrapper>(NumRays, boxes.begin(), boxes.end(), -1);
+
+	std::vector<Triangle> triangles;
+	for (int i = 0; i < 10000; i++) {
+		vec3 a = vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5);
+		vec3 b = vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5);
+		vec3 offset = vec3(Random::random(), Random::random(), Random::random()) * 0.01f;
+		triangles.emplace_back(a, b, b + offset);
+	}
+	printf("Long triangles\n");
+	compareTreeBuilders<Triangle>(NumRays, triangles.begin(), triangles.end(), -1);
+
+	auto scene = createInstancedPrismScene<PrimitiveLocators::BruteForce<Intersectable>>(128, 128);
+	std::vector<Intersectable*> objects;
+	for (int i = 0; i < scene->numObjects(); ++i)
+		objects.push_back(scene->primitive(i).get());
+	std::function<Intersectable*(std::vector<Intersectable*>::iterator&)> get = [](std::vector<Intersectable*>::iterator& it)->Intersectable* {
+		return *it;
+	};
+	printf("Instanced prisms\n");
+	compareTreeBuilders<Intersectable>(NumRays, objects.begin(), objects.end(), get, -1);
+
+	if (meshFilename.empty())
+		return;
+	spTriangleMesh mesh = MeshLoader::load(meshFilename);
+	triangles.clear();
+	triangles.reserve(mesh->numTriangles());
+	for (int i = 0; i < mesh->numTriangles(); ++i)
+		triangles.push_back(mesh->triangle(i));
+	printf("Mesh %s, %d triangles\n", meshFilename.c_str(), mesh->numTriangles());
+	compareTreeBuilders<Triangle>(NumRays, triangles.begin(), triangles.end(), -1);
+}
+
+// set associative LRU cache fed with memory reads of traversal, counts cache line misses
+// hardware counters are not portable, so misses are simulated
+class CacheSimulator {
+	int lineSize;
+	int ways;
+	int sets;
+	std::vector<uintptr_t> tags;
+	std::vector<unsigned int> lastUse;
+	unsigned int time = 0;
+public:
+	long long accesses = 0;
+	long long misses = 0;
+	CacheSimulator(int sizeBytes = 32 * 1024, int ways = 8, int lineSize = 64)
+		:lineSize(lineSize), ways(ways), sets(sizeBytes / (ways * lineSize)),
+		tags(sizeBytes / lineSize, 0), lastUse(sizeBytes / lineSize, 0) {}
+	void operator()(const void* address, size_t size) {
+		uintptr_t first = reinterpret_cast<uintptr_t>(address) / lineSize;
+		uintptr_t last = (reinterpret_cast<uintptr_t>(address) + std::max<size_t>(size, 1) - 1) / lineSize;
+		for (uintptr_t line = first; line <= last; ++line)
+			access(line);
+	}
+	void access(uintptr_t line) {
+		accesses++;
+		time++;
+		int set = line % sets;
+		int oldest = set * ways;
+		for (int i = set * ways; i < (set + 1) * ways; ++i) {
+			// tag 0 marks empty way, line + 1 is stored
+			if (tags[i] == line + 1) {
+				lastUse[i] = time;
+				return;
+			}
+			if (lastUse[i] < lastUse[oldest])
+				oldest = i;
+		}
+		misses++;
+		tags[oldest] = line + 1;
+		lastUse[oldest] = time;
+	}
+};
+
+template<class Accel>
+void benchmarkLayout(const char* name, Accel& accel, const std::vector<Ray>& rays) {
+	CacheSimulator cache;
+	for (auto ray : rays) {
+		HitInfo hitInfo;
+		accel.intersect(ray, hitInfo, cache);
+	}
+	Timer<double> timer;
+	for (auto ray : rays) {
+		HitInfo hitInfo;
+		accel.intersect(ray, hitInfo);
+	}
+	double traceTime = timer.elapsedAndRestart();
+	printf("%s: %f cache line reads per ray, %f misses per ray, %f Mrays/s\n", name, cache.accesses / double(rays.size()),
+		cache.misses / double(rays.size()), rays.size() / traceTime * 1e-6);
+}
+
+// same tree in build order and after both layout passes
+template<class Accel, class Iterator, class...Params>
+void compareNodeLayouts(int numRays, Iterator begin, Iterator end, Params...params) {
+	Accel accel(begin, end, params...);
+	BBox3D bounds = accel.bbox();
+	std::vector<Ray> rays(numRays);
+	for (auto& ray : rays) {
+		ray.ro = glm::mix(bounds.min(), bounds.max(), vec3(Random::random(), Random::random(), Random::random()));
+		ray.rd = Sampling::uniformSphere();
+	}
+	benchmarkLayout("Build order", accel, rays);
+	accel.optimizeLayout(PrimitiveLocators::NodeLayout::DepthFirst);
+	benchmarkLayout("Depth first", accel, rays);
+	accel.optimizeLayout(PrimitiveLocators::NodeLayout::Treelets);
+	benchmarkLayout("Treelets", accel, rays);
+}
+
+void runBenchmarkNodeLayouts(const std::string& meshFilename = "") {
+	const int NumRays = 100000;
+	std::vector<BoxWrapper> boxes;
+	for (int i = 0; i < 100000; i++) {
+		vec3 center = vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5);
+		vec3 size = glm::mix(vec3(0.001f), vec3(0.01f), vec3(Random::random(), Random::random(), Random::random()));
+		boxes.emplace_back(center - size * 0.5f, center + size * 0.5f);
+	}
+	printf("Boxes, bucket SAH\n");
+	compareNodeLayouts<SAHTree>(NumRays, boxes.begin(), boxes.end(), -1);
+	printf("Boxes, spatial splits\n");
+	compareNodeLayouts<SpatialSplitTree>(NumRays, boxes.begin(), boxes.end(), -1);
+	if (meshFilename.empty())
+		return;
+	spTriangleMesh mesh = MeshLoader::load(meshFilename);
+	std::vector<Triangle> triangles;
+	triangles.reserve(mesh->numTriangles());
+	for (int i = 0; i < mesh->numTriangles(); ++i)
+		triangles.push_back(mesh->triangle(i));
+	printf("Mesh %s, %d triangles, bucket SAH\n", meshFilename.c_str(), mesh->numTriangles());
+	compareNodeLayouts<PrimitiveLocators::AABBTree<Triangle, PrimitiveLocators::BucketSAHTreeBuilder<Triangle>>>(NumRays, triangles.begin(), triangles.end(), -1);
+}
+
+template<class Accel, class Iterator, class...Params>
+void benchmarkMemory(const char* name, const std::vector<Ray>& rays, Iterator begin, Iterator end, Params...params) {
+	Timer<double> timer;
+	Accel accel(begin, end, params...);
+	double buildTime = timer.elapsedAndRestart();
+	int hits = 0;
+	for (auto ray : rays) {
+		HitInfo hitInfo;
+		hits += accel.intersect(ray, hitInfo);
+	}
+	double traceTime = timer.elapsedAndRestart();
+	printf("%s: build %f s, memory %f MB, %f Mrays/s, hits %d, test %d\n", name, buildTime, accel.memoryUsage() / double(1 << 20),
+		rays.size() / traceTime * 1e-6, hits, accel.test());
+}
+
+// full precision and quantized nodes over same primitives, hit counts should match
+void runBenchmarkQuantizedNodes(const std::string& meshFilename = "") {
+	using namespace PrimitiveLocators;
+	const int NumRays = 100000;
+	std::vector<Triangle> triangles;
+	if (meshFilename.empty()) {
+		for (int i = 0; i < 1000000; i++) {
+			vec3 a = vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5);
+			triangles.emplace_back(a, a + vec3(Random::random(), 0.0f, Random::random()) * 0.005f, a + vec3(0.0f, Random::random(), Random::random()) * 0.005f);
+		}
+	}
+	else {
+		spTriangleMesh mesh = MeshLoader::load(meshFilename);
+		triangles.reserve(mesh->numTriangles());
+		for (int i = 0; i < mesh->numTriangles(); ++i)
+			triangles.push_back(mesh->triangle(i));
+	}
+	BBox3D bounds(triangles.front().bbox());
+	for (const auto& triangle : triangles)
+		bounds.append(triangle.bbox());
+	std::vector<Ray> rays(NumRays);
+	for (auto& ray : rays) {
+		ray.ro = glm::mix(bounds.min(), bounds.max(), vec3(Random::random(), Random::random(), Random::random()));
+		ray.rd = Sampling::uniformSphere();
+	}
+	printf("%d triangles, %f MB\n", int(triangles.size()), triangles.size() * sizeof(Triangle) / double(1 << 20));
+	benchmarkMemory<AABBTree<Triangle, BucketSAHTreeBuilder<Triangle>>>("Full precision", rays, triangles.begin(), triangles.end(), -1);
+	benchmarkMemory<QuantizedAABBTree<Triangle, BucketSAHTreeBuilder<Triangle>>>("Quantized", rays, triangles.begin(), triangles.end(), -1);
 }
\ No newline at end of file
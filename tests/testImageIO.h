@@ -0,0 +1,141 @@
+#pragma once
+#include <spectral-photon-mapping/ImageIO.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+// compares conversion of exactly representable floats with known half encodings
+void testHalfConversion() {
+	struct Case {
+		float value;
+		uint16_t half;
+	};
+	const Case cases[] = {
+		{ 0.0f, 0x0000 },
+		{ -0.0f, 0x8000 },
+		{ 1.0f, 0x3c00 },
+		{ -2.0f, 0xc000 },
+		// largest half, everything from 65520 on rounds to infinity
+		{ 65504.0f, 0x7bff },
+		{ 65519.0f, 0x7bff },
+		{ 65520.0f, 0x7c00 },
+		{ -65520.0f, 0xfc00 },
+		// smallest normal and subnormal halves, half of smallest subnormal is tie rounded to even zero
+		{ std::ldexp(1.0f, -14), 0x0400 },
+		{ std::ldexp(1.0f, -24), 0x0001 },
+		{ std::ldexp(1.0f, -25), 0x0000 },
+		{ -std::ldexp(1.0f, -25), 0x8000 },
+		{ std::ldexp(1.0f, -25) + std::ldexp(1.0f, -35), 0x0001 },
+		// ties round to even mantissa for normal and subnormal halves
+		{ 1.0f + std::ldexp(1.0f, -11), 0x3c00 },
+		{ 1.0f + 3.0f * std::ldexp(1.0f, -11), 0x3c02 },
+		{ 1.0f + std::ldexp(1.0f, -11) + std::ldexp(1.0f, -23), 0x3c01 },
+		{ 1.5f * std::ldexp(1.0f, -24), 0x0002 },
+		{ 2.5f * std::ldexp(1.0f, -24), 0x0002 },
+		{ std::numeric_limits<float>::infinity(), 0x7c00 },
+		{ -std::numeric_limits<float>::infinity(), 0xfc00 }
+	};
+	int errors = 0;
+	for (const auto& test : cases) {
+		uint16_t half = ImageIO::toHalf(test.value);
+		if (half != test.half) {
+			printf("toHalf(%g) = 0x%04x, expected 0x%04x\n", test.value, half, test.half);
+			errors++;
+		}
+	}
+	// NaN keeps all exponent bits and nonzero mantissa
+	for (float nan : { std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN() }) {
+		uint16_t half = ImageIO::toHalf(nan);
+		if ((half & 0x7c00) != 0x7c00 || (half & 0x03ff) == 0) {
+			printf("toHalf(NaN) = 0x%04x is not NaN\n", half);
+			errors++;
+		}
+	}
+	printf("Half conversion errors: %d\n", errors);
+}
+
+// writes small EXR and follows its offset table back to scanlines, which have to hold encoded pixels
+void testEXROffsets() {
+	const char* filename = "testImageIO.exr";
+	const int width = 7, height = 5;
+	Image<rgb> image(width, height, rgb(0.0f));
+	for (int j = 0; j < height; j++)
+		for (int i = 0; i < width; i++)
+			image(i, j) = rgb(float(i) + 0.25f * j, -float(j), 70000.0f * i);
+	int errors = 0;
+	if (!ImageIO::writeEXR(filename, image)) {
+		printf("EXR offsets errors: file %s was not written\n", filename);
+		return;
+	}
+	std::ifstream file(filename, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	std::remove(filename);
+	size_t position = 0;
+	auto read = [&](void* data, size_t size) {
+		if (position + size > bytes.size())
+			throw std::runtime_error("Unexpected end of EXR file");
+		memcpy(data, bytes.data() + position, size);
+		position += size;
+	};
+	auto readString = [&]() {
+		std::string value;
+		char c;
+		for (read(&c, 1); c != '\0'; read(&c, 1))
+			value.push_back(c);
+		return value;
+	};
+	int32_t magic, version;
+	read(&magic, sizeof(magic));
+	read(&version, sizeof(version));
+	if (magic != 20000630 || version != 2)
+		errors++;
+	// header ends with empty attribute name
+	for (std::string name = readString(); !name.empty(); name = readString()) {
+		readString();
+		int32_t size;
+		read(&size, sizeof(size));
+		position += size;
+	}
+	std::vector<uint64_t> offsets(height);
+	read(offsets.data(), offsets.size() * sizeof(uint64_t));
+	// channels are stored sorted by name
+	const int channelOrder[] = { 2, 1, 0 };
+	for (int y = 0; y < height; y++) {
+		// chunks follow table and each other in order of scanlines
+		if (offsets[y] != position) {
+			printf("offset of scanline %d is %llu, chunk starts at %llu\n", y, (unsigned long long)offsets[y], (unsigned long long)position);
+			errors++;
+		}
+		position = size_t(offsets[y]);
+		int32_t chunkY, chunkSize;
+		read(&chunkY, sizeof(chunkY));
+		read(&chunkSize, sizeof(chunkSize));
+		if (chunkY != y || chunkSize != int32_t(3 * width * sizeof(uint16_t))) {
+			errors++;
+			continue;
+		}
+		// first scanline is top row of image
+		for (int c : channelOrder) {
+			for (int i = 0; i < width; i++) {
+				uint16_t half;
+				read(&half, sizeof(half));
+				if (half != ImageIO::toHalf(image(i, height - y - 1)[c]))
+					errors++;
+			}
+		}
+	}
+	if (position != bytes.size())
+		errors++;
+	printf("EXR offsets errors: %d\n", errors);
+}
+
+void runTestImageIO() {
+	testHalfConversion();
+	testEXROffsets();
+}
\ No newline at end of file
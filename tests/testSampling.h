@@ -0,0 +1,180 @@
+#pragma once
+#include <spectral-photon-mapping/common.h>
+#include <spectral-photon-mapping/Random.h>
+#include <spectral-photon-mapping/Sampling.h>
+#include <spectral-photon-mapping/Distribution1D.h>
+#include <spectral-photon-mapping/Color.h>
+#include <spectral-photon-mapping/Light.h>
+#include <spectral-photon-mapping/LightSampler.h>
+#include <spectral-photon-mapping/Rect.h>
+#include <spectral-photon-mapping/Sphere.h>
+#include <spectral-photon-mapping/Transform.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// stratified values are sampled through alias table, frequencies have to match discrete pdf
+// and bins of zero weight must never be chosen
+void testAliasSampling(const std::vector<float>& weights, int numSamples) {
+	Distribution1D distribution(weights.begin(), weights.end());
+	std::vector<int> counts(weights.size(), 0);
+	int errors = 0;
+	for (int i = 0; i < numSamples; i++) {
+		float pdf, remapped;
+		int index = distribution.sampleAlias((i + 0.5f) / numSamples, pdf, remapped);
+		if (index < 0 || index >= int(weights.size()) || weights[index] == 0.0f) {
+			errors++;
+			continue;
+		}
+		if (pdf != distribution.discretePDF(index) || remapped < 0.0f || remapped >= 1.0f)
+			errors++;
+		counts[index]++;
+	}
+	// values at both ends of every bin of alias table
+	int n = int(weights.size());
+	for (int bin = 0; bin < n; bin++) {
+		for (float value : { float(bin) / n, std::nextafter(float(bin + 1) / n, 0.0f) }) {
+			float pdf;
+			int index = distribution.sampleAlias(value, pdf);
+			if (index < 0 || index >= n || weights[index] == 0.0f)
+				errors++;
+		}
+	}
+	// stratification leaves error of a few samples per bin
+	float maxDifference = 0.0f;
+	for (int i = 0; i < n; i++) {
+		float difference = std::abs(float(counts[i]) / numSamples - distribution.discretePDF(i));
+		maxDifference = std::max(maxDifference, difference);
+		if (difference > 4.0f / numSamples)
+			errors++;
+	}
+	printf("Alias sampling of %d bins: max frequency difference %g, errors %d\n", n, maxDifference, errors);
+}
+
+// stratified values are turned into hero wavelengths and companions, histogram of each lane
+// has to match pdf over whole range, since hero alone stands for spectrum after dispersion
+void testHeroWavelengths(float min, float max, const std::function<float(float)>& importance, int numSamples) {
+	const int Bins = 300;
+	const int HistogramBins = 30;
+	WavelengthDistribution distribution(min, max, importance, Bins);
+	std::vector<float> expected(HistogramBins, 0.0f);
+	float step = (max - min) / Bins;
+	for (int i = 0; i < Bins; i++)
+		expected[i * HistogramBins / Bins] += distribution.pdf(min + (i + 0.5f) * step) * step;
+	std::vector<std::vector<int>> counts(SpectralSample::Size, std::vector<int>(HistogramBins, 0));
+	int errors = 0;
+	for (int i = 0; i < numSamples; i++) {
+		SpectralSample weights;
+		SpectralSample wavelengths = distribution.sampleHero((i + 0.5f) / numSamples, weights);
+		for (int lane = 0; lane < SpectralSample::Size; lane++) {
+			if (wavelengths[lane] < min || wavelengths[lane] > max || !(weights[lane] > 0.0f)) {
+				errors++;
+				continue;
+			}
+			int bin = std::min(int((wavelengths[lane] - min) / (max - min) * HistogramBins), HistogramBins - 1);
+			counts[lane][bin]++;
+		}
+	}
+	float maxDifference = 0.0f;
+	for (int lane = 0; lane < SpectralSample::Size; lane++) {
+		for (int bin = 0; bin < HistogramBins; bin++) {
+			float difference = std::abs(float(counts[lane][bin]) / numSamples - expected[bin]);
+			maxDifference = std::max(maxDifference, difference);
+			if (difference > 4.0f / numSamples)
+				errors++;
+		}
+	}
+	printf("Hero wavelengths in [%g, %g]: max frequency difference %g, errors %d\n", min, max, maxDifference, errors);
+}
+
+// at random shading points pdf returned with sampled light has to equal pdf of that light
+// and lights are chosen with frequencies given by their pdfs
+void testLightSamplerPdf(const LightSampler& sampler, int numLights, int numPoints, int numSamples, vec3 sceneSize) {
+	int errors = 0;
+	int unlit = 0;
+	double maxDifference = 0.0;
+	const float Epsilon = 1e-4f;
+	for (int p = 0; p < numPoints; p++) {
+		vec3 position = (vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5f)) * sceneSize;
+		// zero normal stands for points in media
+		vec3 normal = p % 4 == 0 ? vec3(0.0f) : Sampling::uniformSphere();
+		std::vector<float> pdfs(numLights);
+		double sum = 0.0;
+		for (int i = 0; i < numLights; i++)
+			sum += pdfs[i] = sampler.pdf(position, normal, i);
+		std::vector<int> counts(numLights, 0);
+		int sampled = 0;
+		for (int s = 0; s < numSamples; s++) {
+			float pdf;
+			int index = sampler.sample(position, normal, (s + 0.5f) / numSamples, pdf);
+			if (index < 0)
+				continue;
+			sampled++;
+			counts[index]++;
+			if (index >= numLights || pdf <= 0.0f || std::abs(pdf - pdfs[index]) > Epsilon * pdfs[index])
+				errors++;
+		}
+		if (sampled == 0)
+			unlit++;
+		// sampling fails where all lights below node have zero importance, pdfs of lights then sum to less than one
+		if (sum > 1.0 + Epsilon || (sampled == numSamples && std::abs(sum - 1.0) > Epsilon))
+			errors++;
+		for (int i = 0; i < numLights; i++) {
+			double difference = std::abs(double(counts[i]) / numSamples - pdfs[i]);
+			maxDifference = std::max(maxDifference, difference);
+			if (difference > 4.0 / numSamples)
+				errors++;
+		}
+	}
+	printf("Light sampler pdf at %d points (%d unlit): max frequency difference %g, errors %d\n",
+		numPoints, unlit, maxDifference, errors);
+}
+
+// spherical lights emitting to all directions and one sided rect lights of random orientation,
+// some of them with zero power
+std::vector<spLight> randomLights(int numLights, vec3 sceneSize) {
+	std::vector<spLight> lights;
+	for (int i = 0; i < numLights; i++) {
+		vec3 position = (vec3(Random::random(), Random::random(), Random::random()) - vec3(0.5f)) * sceneSize;
+		float power = i % 7 == 3 ? 0.0f : Random::random() * 10.0f;
+		spColorSampler intensity = std::make_shared<ConstantSampler>(power);
+		if (i % 2 == 0) {
+			lights.push_back(std::make_shared<DiffuseAreaLight>(Affine(Transform(position)), intensity,
+				std::make_shared<Sphere>(vec3(0.0f), 0.05f + Random::random())));
+		}
+		else {
+			vec3 axis = Sampling::uniformSphere();
+			quat rotation = glm::angleAxis(Random::random() * glm::pi<float>(), axis);
+			lights.push_back(std::make_shared<DiffuseAreaLight>(Affine(Transform(position, rotation)), intensity,
+				std::make_shared<Rect>(vec2(Random::random(), Random::random()) + vec2(0.1f))));
+		}
+	}
+	return lights;
+}
+
+void runTestSampling() {
+	printf("Alias table\n");
+	testAliasSampling({ 1.0f, 2.0f, 3.0f, 4.0f }, 100000);
+	testAliasSampling({ 0.0f, 5.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.01f, 0.0f }, 100000);
+	testAliasSampling({ 0.0f, 0.0f, 7.0f }, 100000);
+	std::vector<float> weights(1000);
+	for (size_t i = 0; i < weights.size(); i++)
+		weights[i] = i % 5 == 0 ? 0.0f : Random::random();
+	testAliasSampling(weights, 1000000);
+	printf("\n");
+	printf("Hero wavelengths\n");
+	testHeroWavelengths(380.0f, 780.0f, [](float wavelength) { return 1.0f; }, 100000);
+	testHeroWavelengths(380.0f, 780.0f, [](float wavelength) { return wavelength - 380.0f; }, 100000);
+	testHeroWavelengths(400.0f, 700.0f, [](float wavelength) { return wavelength < 550.0f ? 0.1f : 2.0f; }, 100000);
+	printf("\n");
+	printf("BVH light sampler\n");
+	vec3 sceneSize(10.0f);
+	for (int numLights : { 1, 2, 17, 200 }) {
+		std::vector<spLight> lights = randomLights(numLights, sceneSize);
+		BVHLightSampler sampler(lights);
+		testLightSamplerPdf(sampler, numLights, 200, 20000, sceneSize);
+	}
+}
\ No newline at end of file
@@ -1,9 +1,35 @@
-﻿#include <iostream>
+﻿#include <cstdio>
+#include <string>
 
+#include "testAccelerators.h"
+#include "testImageIO.h"
+#include "testSampling.h"
 
-// todo: move tests and benchmarks here
 
-int main()
+// test or benchmark is chosen by first argument, benchmarks take optional PLY mesh as second one
+int main(int argc, char* argv[])
 {
-    std::cout << "Hello World!\n";
+	std::string name = argc > 1 ? argv[1] : "";
+	std::string mesh = argc > 2 ? argv[2] : "";
+	if (name == "accelerators")
+		runTestPrimitiveResults();
+	else if (name == "image-io")
+		runTestImageIO();
+	else if (name == "sampling")
+		runTestSampling();
+	else if (name == "accelerators-performance")
+		runTestPrimitiveAccelerators();
+	else if (name == "spatial-splits")
+		runBenchmarkSpatialSplits(mesh);
+	else if (name == "node-layouts")
+		runBenchmarkNodeLayouts(mesh);
+	else if (name == "quantized-nodes")
+		runBenchmarkQuantizedNodes(mesh);
+	else {
+		printf("Usage: tests <name> [mesh.ply]\n");
+		printf("Tests: accelerators, image-io, sampling\n");
+		printf("Benchmarks: accelerators-performance, spatial-splits, node-layouts, quantized-nodes\n");
+		return 1;
+	}
+	return 0;
 }
\ No newline at end of file